@@ -1,4 +1,5 @@
 
+#include <string>
 #include <vector>
 
 #include <imgui.h>
@@ -14,6 +15,19 @@
 
 const int LIGHT_BLOCK_BINDING_POINT = 0;
 
+// Baseline layout, embedded by value in the prebuilt pg demos (see the note in demo_base.h)
+struct demo_base_layout
+{
+    void* VTable;
+    GL::debug* GLDebug;
+    camera Camera;
+    GLuint Program;
+    GLuint VAO;
+    tavern_scene TavernScene;
+    bool Wireframe;
+};
+static_assert(sizeof(demo_base) == sizeof(demo_base_layout) && alignof(demo_base) == alignof(demo_base_layout), "demo_base layout is frozen");
+
 static const char* gVertexShaderStr = R"GLSL(
 // Attributes
 layout(location = 0) in vec3 aPosition;
@@ -50,8 +64,8 @@ in vec3 vNormal;
 uniform mat4 uProjection;
 uniform vec3 uViewPosition;
 
-uniform sampler2D uDiffuseTexture;
-uniform sampler2D uEmissiveTexture;
+uniform sampler2D uDiffuseTexture;  // Alpha: emissive intensity (PACKED_EMISSIVE)
+uniform sampler2D uEmissiveTexture; // Emissive tint map (PACKED_EMISSIVE_TINT_TEXTURE)
 
 // Uniform blocks
 layout(std140) uniform uLightBlock
@@ -75,15 +89,27 @@ light_shade_result get_lights_shading()
     return lightResult;
 }
 
+vec3 get_emissive(vec4 diffuseTexel)
+{
+#if defined(PACKED_EMISSIVE_TINT_TEXTURE)
+    return diffuseTexel.a * texture(uEmissiveTexture, vUV).rgb;
+#elif defined(PACKED_EMISSIVE)
+    return diffuseTexel.a * EMISSIVE_TINT;
+#else
+    return texture(uEmissiveTexture, vUV).rgb;
+#endif
+}
+
 void main()
 {
     // Compute phong shading
     light_shade_result lightResult = get_lights_shading();
+    vec4 diffuseTexel = texture(uDiffuseTexture, vUV);
     
-    vec3 diffuseColor  = gDefaultMaterial.diffuse * lightResult.diffuse * texture(uDiffuseTexture, vUV).rgb;
+    vec3 diffuseColor  = gDefaultMaterial.diffuse * lightResult.diffuse * diffuseTexel.rgb;
     vec3 ambientColor  = gDefaultMaterial.ambient * lightResult.ambient;
     vec3 specularColor = gDefaultMaterial.specular * lightResult.specular;
-    vec3 emissiveColor = gDefaultMaterial.emission + texture(uEmissiveTexture, vUV).rgb;
+    vec3 emissiveColor = gDefaultMaterial.emission + get_emissive(diffuseTexel);
     
     // Apply light color
     oColor = vec4((ambientColor + diffuseColor + specularColor + emissiveColor), 1.0);
@@ -92,17 +118,18 @@ void main()
 demo_base::demo_base(GL::cache& GLCache, GL::debug& GLDebug)
     : GLDebug(GLDebug), TavernScene(GLCache)
 {
-    // Create shader
+    // Get shader from GLCache (shared with any other user of the same sources and defines)
+    GL::program* TavernProgram = nullptr;
     {
-        // Assemble fragment shader strings (defines + code)
-        char FragmentShaderConfig[] = "#define LIGHT_COUNT %d\n";
-        snprintf(FragmentShaderConfig, ARRAY_SIZE(FragmentShaderConfig), "#define LIGHT_COUNT %d\n", TavernScene.LightCount);
-        const char* FragmentShaderStrs[2] = {
-            FragmentShaderConfig,
-            gFragmentShaderStr,
-        };
-
-        this->Program = GL::CreateProgramEx(1, &gVertexShaderStr, 2, FragmentShaderStrs, true);
+        // Assemble defines (config + material defines), the emissive tint is constant
+        const GL::packed_material& Material = tavern_scene::LoadMaterial(GLCache);
+        char ShaderConfig[128];
+        snprintf(ShaderConfig, ARRAY_SIZE(ShaderConfig), "#define LIGHT_COUNT %d\n#define EMISSIVE_TINT vec3(%f, %f, %f)\n",
+            TavernScene.LightCount, Material.EmissiveTint.x, Material.EmissiveTint.y, Material.EmissiveTint.z);
+        std::string Defines = std::string(ShaderConfig) + Material.ShaderDefines;
+
+        TavernProgram = GLCache.LoadProgram(gVertexShaderStr, gFragmentShaderStr, Defines.c_str(), true);
+        this->Program = TavernProgram->ID;
     }
     
     // Create a vertex array and bind attribs onto the vertex buffer
@@ -121,20 +148,19 @@ demo_base::demo_base(GL::cache& GLCache, GL::debug& GLDebug)
         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
     }
 
-    // Set uniforms that won't change
+    // Set uniforms that won't change (waits for the link)
     {
-        glUseProgram(Program);
-        glUniform1i(glGetUniformLocation(Program, "uDiffuseTexture"), 0);
-        glUniform1i(glGetUniformLocation(Program, "uEmissiveTexture"), 1);
-        glUniformBlockBinding(Program, glGetUniformBlockIndex(Program, "uLightBlock"), LIGHT_BLOCK_BINDING_POINT);
+        TavernProgram->Use();
+        TavernProgram->SetInt("uDiffuseTexture", 0);
+        TavernProgram->SetInt("uEmissiveTexture", 1);
+        TavernProgram->BindUniformBlock("uLightBlock", LIGHT_BLOCK_BINDING_POINT);
     }
 }
 
 demo_base::~demo_base()
 {
-    // Cleanup GL
+    // Cleanup GL (the program stays in GLCache, demo_base has no room to keep the cache and release it)
     glDeleteVertexArrays(1, &VAO);
-    glDeleteProgram(Program);
 }
 
 void demo_base::Update(const platform_io& IO)
@@ -187,18 +213,21 @@ void demo_base::DisplayDebugUI()
 
 void demo_base::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
 {
+    // Cached program found from its GL name (no room in demo_base for a GL::program pointer)
+    GL::program& TavernProgram = *GL::program::Find(Program);
+
     glEnable(GL_DEPTH_TEST);
 
     // Use shader and configure its uniforms
-    glUseProgram(Program);
+    TavernProgram.Use();
 
-    // Set uniforms
+    // Set uniforms (locations are reflected once, unchanged values are not uploaded again)
     mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(ModelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uProjection"), 1, GL_FALSE, ProjectionMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uModel"), 1, GL_FALSE, ModelMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uView"), 1, GL_FALSE, ViewMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uModelNormalMatrix"), 1, GL_FALSE, NormalMatrix.e);
-    glUniform3fv(glGetUniformLocation(Program, "uViewPosition"), 1, Camera.Position.e);
+    TavernProgram.SetMat4("uProjection", ProjectionMatrix);
+    TavernProgram.SetMat4("uModel", ModelMatrix);
+    TavernProgram.SetMat4("uView", ViewMatrix);
+    TavernProgram.SetMat4("uModelNormalMatrix", NormalMatrix);
+    TavernProgram.SetVec3("uViewPosition", Camera.Position);
     
     // Bind uniform buffer and textures
     glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
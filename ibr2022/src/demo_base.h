@@ -10,6 +10,8 @@
 
 #include "tavern_scene.h"
 
+// The data layout is frozen: demo_base is embedded by value in the demos of the prebuilt ibr-pg.lib
+// (new tavern rendering features go in demo_lighting)
 class demo_base : public demo
 {
 public:
@@ -26,7 +28,7 @@ private:
     // 3d camera
     camera Camera = {};
 
-    // GL objects needed by this demo
+    // GL objects needed by this demo (program owned by GLCache, see GL::program::Find)
     GLuint Program = 0;
     GLuint VAO = 0;
 
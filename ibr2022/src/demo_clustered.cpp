@@ -0,0 +1,496 @@
+#include <chrono>
+
+#include <imgui.h>
+
+#include "opengl_helpers.h"
+#include "opengl_helpers_wireframe.h"
+
+#include "color.h"
+#include "maths.h"
+
+#include "demo_clustered.h"
+
+const int LIGHT_BLOCK_BINDING_POINT = 0;
+
+// Light count limited by the minimum GL_MAX_UNIFORM_BLOCK_SIZE (16 KB of GL::light_data)
+const int MAX_LIGHT_COUNT = 512;
+
+// Froxel grid (exponential depth slices)
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+const float CAMERA_FOVY = Math::ToRadians(60.f);
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.f;
+
+static const char* gVertexShaderStr = R"GLSL(
+// Attributes
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec2 aUV;
+layout(location = 2) in vec3 aNormal;
+
+// Uniforms (view/projection from uFrame)
+uniform mat4 uModel;
+uniform mat4 uModelNormalMatrix;
+
+// Varyings
+out vec2 vUV;
+out vec3 vPos;    // Vertex position in world-space
+out vec3 vNormal; // Vertex normal in world-space
+out float vViewDepth;
+
+void main()
+{
+    vUV = aUV;
+    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vPos = pos4.xyz / pos4.w;
+    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vViewDepth = -(uFrame.view * pos4).z;
+    gl_Position = uFrame.viewProj * pos4;
+})GLSL";
+
+static const char* gFragmentShaderStr = R"GLSL(
+// Varyings
+in vec2 vUV;
+in vec3 vPos;
+in vec3 vNormal;
+in float vViewDepth;
+
+// Uniforms
+uniform sampler2D uDiffuseTexture;  // Alpha: emissive intensity (PACKED_EMISSIVE)
+uniform sampler2D uEmissiveTexture; // Emissive tint map (PACKED_EMISSIVE_TINT_TEXTURE)
+uniform vec3 uEmissiveTint;
+uniform usamplerBuffer uClusterGrid;  // (offset, count) in uLightIndices per cluster
+uniform usamplerBuffer uLightIndices;
+uniform float uClusterNear;
+uniform float uClusterDepthScale;     // Slice count / log(far / near)
+uniform bool uShowHeatmap;
+
+// Uniform blocks
+layout(std140) uniform uLightBlock
+{
+	light uLight[MAX_LIGHT_COUNT];
+};
+
+// Shader outputs
+out vec4 oColor;
+
+int get_cluster_index()
+{
+    vec2 tile = (gl_FragCoord.xy - uFrame.viewport.xy) / uFrame.viewport.zw * vec2(CLUSTER_X, CLUSTER_Y);
+    int slice = int(floor(log(vViewDepth / uClusterNear) * uClusterDepthScale));
+    ivec3 cluster = clamp(ivec3(ivec2(tile), slice), ivec3(0), ivec3(CLUSTER_X, CLUSTER_Y, CLUSTER_Z) - 1);
+    return (cluster.z * CLUSTER_Y + cluster.y) * CLUSTER_X + cluster.x;
+}
+
+light_shade_result get_lights_shading(uvec2 cluster)
+{
+    light_shade_result lightResult = light_shade_result(vec3(0.0), vec3(0.0), vec3(0.0));
+    for (uint i = 0u; i < cluster.y; ++i)
+    {
+        uint lightIndex = texelFetch(uLightIndices, int(cluster.x + i)).r;
+        light_shade_result light = light_shade(uLight[lightIndex], gDefaultMaterial.shininess, uFrame.viewPosition.xyz, vPos, normalize(vNormal));
+        lightResult.ambient  += light.ambient;
+        lightResult.diffuse  += light.diffuse;
+        lightResult.specular += light.specular;
+    }
+    return lightResult;
+}
+
+vec3 get_emissive(vec4 diffuseTexel)
+{
+#if defined(PACKED_EMISSIVE_TINT_TEXTURE)
+    return diffuseTexel.a * texture(uEmissiveTexture, vUV).rgb;
+#elif defined(PACKED_EMISSIVE)
+    return diffuseTexel.a * uEmissiveTint;
+#else
+    return texture(uEmissiveTexture, vUV).rgb;
+#endif
+}
+
+void main()
+{
+    uvec2 cluster = texelFetch(uClusterGrid, get_cluster_index()).rg;
+    if (uShowHeatmap)
+    {
+        float heat = clamp(float(cluster.y) / 32.0, 0.0, 1.0);
+        oColor = vec4(mix(vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0), heat) * heat, 1.0);
+        return;
+    }
+
+    // Compute phong shading
+    light_shade_result lightResult = get_lights_shading(cluster);
+    vec4 diffuseTexel = texture(uDiffuseTexture, vUV);
+
+    vec3 diffuseColor  = gDefaultMaterial.diffuse * lightResult.diffuse * diffuseTexel.rgb;
+    vec3 ambientColor  = gDefaultMaterial.ambient * lightResult.ambient;
+    vec3 specularColor = gDefaultMaterial.specular * lightResult.specular;
+    vec3 emissiveColor = gDefaultMaterial.emission + get_emissive(diffuseTexel);
+
+    // Apply light color
+    oColor = vec4((ambientColor + diffuseColor + specularColor + emissiveColor), 1.0);
+})GLSL";
+
+// View depth of the near plane of a slice
+static float GetSliceDepth(int Slice)
+{
+    return CAMERA_NEAR * powf(CAMERA_FAR / CAMERA_NEAR, (float)Slice / CLUSTER_Z);
+}
+
+demo_clustered::demo_clustered(GL::cache& GLCache, GL::debug& GLDebug)
+    : GLDebug(GLDebug), TavernScene(GLCache), TavernRenderer(GLCache, TavernScene)
+{
+    // Create shader
+    {
+        char ClusterDefines[256];
+        snprintf(ClusterDefines, ARRAY_SIZE(ClusterDefines),
+            "#define MAX_LIGHT_COUNT %d\n#define CLUSTER_X %d\n#define CLUSTER_Y %d\n#define CLUSTER_Z %d\n",
+            MAX_LIGHT_COUNT, CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+
+        // Assemble fragment shader strings (defines + code)
+        const char* FragmentShaderStrs[3] = {
+            ClusterDefines,
+            TavernRenderer.MaterialShaderDefines.c_str(),
+            gFragmentShaderStr,
+        };
+
+        this->TavernProgram.Create(1, &gVertexShaderStr, 3, FragmentShaderStrs, true);
+    }
+
+    // Create a vertex array and bind attribs onto the vertex buffer
+    {
+        glGenVertexArrays(1, &TavernVAO);
+        glBindVertexArray(TavernVAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+
+        vertex_descriptor& Desc = TavernScene.MeshDesc;
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.PositionOffset);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.UVOffset);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
+    }
+
+    // Init lights
+    {
+        Lights.resize(MAX_LIGHT_COUNT);
+        LightsData.resize(MAX_LIGHT_COUNT);
+        FlickerPhases.resize(MAX_LIGHT_COUNT);
+
+        // Sun light
+        GL::light& Sun = Lights[0];
+        Sun.Enabled     = true;
+        Sun.Position    = { 1.f, 3.f, 1.f, 0.f }; // Directional light
+        Sun.Ambient     = { 0.2f, 0.2f, 0.2f };
+        Sun.Diffuse     = Color::RGB(0x374D58);
+        Sun.Attenuation = { 1.f, 0.f, 0.f };
+
+        // Candles scattered in the tavern (no ambient, it would add up with hundreds of lights)
+        for (int i = 1; i < MAX_LIGHT_COUNT; ++i)
+        {
+            GL::light& Candle = Lights[i];
+            Candle.Enabled     = true;
+            Candle.Position    = { Rng(-6.f, 5.f), Rng(-0.5f, 2.5f), Rng(-4.f, 7.f), 1.f };
+            Candle.Ambient     = { 0.f, 0.f, 0.f };
+            Candle.Diffuse     = Color::RGB(0xFFB400);
+            Candle.Specular    = Candle.Diffuse;
+            Candle.Attenuation = { 1.f, 0.f, 4.f };
+            FlickerPhases[i]   = Rng(0.f, Math::TwoPi());
+        }
+
+        glGenBuffers(1, &LightsUniformBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, LightsUniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, MAX_LIGHT_COUNT * sizeof(GL::light_data), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    // Cluster texture buffers
+    {
+        ClusterGrid.resize(2 * CLUSTER_COUNT);
+        ClusterBounds.resize(CLUSTER_COUNT);
+
+        glGenBuffers(1, &ClusterGridBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, ClusterGridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, ClusterGrid.size() * sizeof(uint32_t), ClusterGrid.data(), GL_STREAM_DRAW);
+        glGenTextures(1, &ClusterGridTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, ClusterGridTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, ClusterGridBuffer);
+
+        glGenBuffers(1, &LightIndexBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, LightIndexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(uint16_t), nullptr, GL_STREAM_DRAW);
+        glGenTextures(1, &LightIndexTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, LightIndexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, LightIndexBuffer);
+
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        ThreadCount = Math::Min(JobPool.GetThreadCount(), 8);
+    }
+}
+
+demo_clustered::~demo_clustered()
+{
+    // Cleanup GL
+    glDeleteVertexArrays(1, &TavernVAO);
+    glDeleteBuffers(1, &LightsUniformBuffer);
+    glDeleteTextures(1, &ClusterGridTexture);
+    glDeleteBuffers(1, &ClusterGridBuffer);
+    glDeleteTextures(1, &LightIndexTexture);
+    glDeleteBuffers(1, &LightIndexBuffer);
+}
+
+void demo_clustered::Update(const platform_io& IO)
+{
+    const float AspectRatio = (float)IO.WindowWidth / (float)IO.WindowHeight;
+    glViewport(0, 0, IO.WindowWidth, IO.WindowHeight);
+
+    Camera = CameraUpdateFreefly(Camera, IO.CameraInputs);
+    FrameBlock.SetTime(IO.Time, IO.DeltaTime);
+
+    // Clear screen
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Shader is compiled in background, only clear the screen until it is linked
+    if (!TavernProgram.IsReady())
+    {
+        this->DisplayDebugUI();
+        return;
+    }
+
+    mat4 ProjectionMatrix = Mat4::Perspective(CAMERA_FOVY, AspectRatio, CAMERA_NEAR, CAMERA_FAR);
+    mat4 ViewMatrix = CameraGetInverseMatrix(Camera);
+    mat4 ModelMatrix = Mat4::Translate({ 0.f, 0.f, 0.f });
+
+    // Cluster bounds only depend on the projection
+    if (ClusterBoundsAspectRatio != AspectRatio)
+        this->BuildClusterBounds(CAMERA_FOVY, AspectRatio);
+
+    this->UpdateLights((float)IO.Time);
+    this->AssignLights(ViewMatrix);
+
+    // Render tavern
+    this->RenderTavern(ProjectionMatrix, ViewMatrix, ModelMatrix);
+
+    // Render tavern wireframe
+    if (Wireframe)
+    {
+        GLDebug.Wireframe.BindBuffer(TavernScene.MeshBuffer, TavernScene.MeshDesc.Stride, TavernScene.MeshDesc.PositionOffset, TavernScene.MeshVertexCount);
+        GLDebug.Wireframe.DrawArray(0, TavernScene.MeshVertexCount, ProjectionMatrix * ViewMatrix * ModelMatrix);
+    }
+
+    // Display debug UI
+    this->DisplayDebugUI();
+}
+
+void demo_clustered::DisplayDebugUI()
+{
+    if (ImGui::TreeNodeEx("demo_clustered", ImGuiTreeNodeFlags_Framed))
+    {
+        // Debug display
+        ImGui::Checkbox("Wireframe", &Wireframe);
+        ImGui::Checkbox("Light count heatmap", &ShowHeatmap);
+        if (ImGui::TreeNodeEx("Camera"))
+        {
+            ImGui::Text("Position: (%.2f, %.2f, %.2f)", Camera.Position.x, Camera.Position.y, Camera.Position.z);
+            ImGui::Text("Pitch: %.2f", Math::ToDegrees(Camera.Pitch));
+            ImGui::Text("Yaw: %.2f", Math::ToDegrees(Camera.Yaw));
+            ImGui::TreePop();
+        }
+
+        ImGui::SliderInt("Light count", &LightCount, 1, MAX_LIGHT_COUNT);
+        ImGui::SliderInt("Threads", &ThreadCount, 1, JobPool.GetThreadCount());
+        ImGui::Text("Clusters: %dx%dx%d", CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+        ImGui::Text("Light assignment: %.3f ms", AssignTime);
+        ImGui::Text("Light indices: %d (max %d per cluster)", (int)LightIndices.size(), MaxLightsPerCluster);
+
+        ImGui::TreePop();
+    }
+}
+
+void demo_clustered::UpdateLights(float Time)
+{
+    // Candle flicker (sum of sines with a random phase per candle)
+    v3 CandleColor = Color::RGB(0xFFB400);
+    for (int i = 1; i < LightCount; ++i)
+    {
+        float Phase = FlickerPhases[i];
+        float Flicker = 0.8f + 0.12f * Math::Sin(Time * 7.f + Phase) + 0.08f * Math::Sin(Time * 13.3f + 2.f * Phase);
+        Lights[i].Diffuse = CandleColor * Flicker;
+        Lights[i].Specular = Lights[i].Diffuse;
+    }
+
+    for (int i = 0; i < LightCount; ++i)
+        LightsData[i] = GL::PackLight(Lights[i]);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, LightsUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, LightCount * sizeof(GL::light_data), LightsData.data());
+}
+
+void demo_clustered::BuildClusterBounds(float FovY, float AspectRatio)
+{
+    ClusterBoundsAspectRatio = AspectRatio;
+
+    float TanY = Math::Tan(FovY * 0.5f);
+    float TanX = TanY * AspectRatio;
+    for (int z = 0; z < CLUSTER_Z; ++z)
+    {
+        float Near = GetSliceDepth(z);
+        float Far = GetSliceDepth(z + 1);
+        for (int y = 0; y < CLUSTER_Y; ++y)
+        {
+            float Bottom = (-1.f + 2.f * y / CLUSTER_Y) * TanY;
+            float Top = (-1.f + 2.f * (y + 1) / CLUSTER_Y) * TanY;
+            for (int x = 0; x < CLUSTER_X; ++x)
+            {
+                float Left = (-1.f + 2.f * x / CLUSTER_X) * TanX;
+                float Right = (-1.f + 2.f * (x + 1) / CLUSTER_X) * TanX;
+
+                // Box around the froxel (view space looks toward -z)
+                cluster_bounds& Bounds = ClusterBounds[(z * CLUSTER_Y + y) * CLUSTER_X + x];
+                Bounds.Min = { Math::Min(Left * Near, Left * Far), Math::Min(Bottom * Near, Bottom * Far), -Far };
+                Bounds.Max = { Math::Max(Right * Near, Right * Far), Math::Max(Top * Near, Top * Far), -Near };
+            }
+        }
+    }
+}
+
+void demo_clustered::AssignLights(const mat4& ViewMatrix)
+{
+    auto StartTime = std::chrono::high_resolution_clock::now();
+
+    // Light spheres in view space
+    LightSpheres.resize(LightCount);
+    for (int i = 0; i < LightCount; ++i)
+    {
+        v4 Center = ViewMatrix * Vec4::vec4(Lights[i].Position.xyz, 1.f);
+        LightSpheres[i] = { Center.xyz, GL::GetLightRadius(Lights[i]) }; // Same cutoff than light_shade
+    }
+
+    // Split depth slices between threads (each thread writes its own clusters and index list)
+    Jobs.resize(ThreadCount);
+    int SlicesPerJob = (CLUSTER_Z + ThreadCount - 1) / ThreadCount;
+    for (int i = 0; i < ThreadCount; ++i)
+    {
+        Jobs[i].FirstSlice = Math::Min(i * SlicesPerJob, CLUSTER_Z);
+        Jobs[i].EndSlice = Math::Min(Jobs[i].FirstSlice + SlicesPerJob, CLUSTER_Z);
+    }
+
+    JobPool.Run(ThreadCount, [this](int JobIndex) { this->AssignSlices(Jobs[JobIndex]); });
+
+    // Concatenate index lists (job offsets are relative to their own list)
+    LightIndices.clear();
+    MaxLightsPerCluster = 0;
+    for (cluster_job& Job : Jobs)
+    {
+        uint32_t BaseOffset = (uint32_t)LightIndices.size();
+        for (int i = Job.FirstSlice * CLUSTER_X * CLUSTER_Y; i < Job.EndSlice * CLUSTER_X * CLUSTER_Y; ++i)
+        {
+            ClusterGrid[2 * i + 0] += BaseOffset;
+            MaxLightsPerCluster = Math::Max(MaxLightsPerCluster, (int)ClusterGrid[2 * i + 1]);
+        }
+        LightIndices.insert(LightIndices.end(), Job.LightIndices.begin(), Job.LightIndices.end());
+    }
+
+    auto EndTime = std::chrono::high_resolution_clock::now();
+    AssignTime = std::chrono::duration<double, std::milli>(EndTime - StartTime).count();
+
+    // Upload (texture buffers can't be empty)
+    if (LightIndices.empty())
+        LightIndices.push_back(0);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, ClusterGridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, ClusterGrid.size() * sizeof(uint32_t), ClusterGrid.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, LightIndexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, LightIndices.size() * sizeof(uint16_t), LightIndices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void demo_clustered::AssignSlices(cluster_job& Job)
+{
+    Job.LightIndices.clear();
+
+    std::vector<uint16_t> SliceLights;
+    for (int z = Job.FirstSlice; z < Job.EndSlice; ++z)
+    {
+        // Lights overlapping the slice depth range
+        float SliceNear = -GetSliceDepth(z);
+        float SliceFar = -GetSliceDepth(z + 1);
+        SliceLights.clear();
+        for (int i = 0; i < LightCount; ++i)
+        {
+            const light_sphere& Sphere = LightSpheres[i];
+            if (Sphere.Center.z - Sphere.Radius <= SliceNear && Sphere.Center.z + Sphere.Radius >= SliceFar)
+                SliceLights.push_back((uint16_t)i);
+        }
+
+        for (int i = 0; i < CLUSTER_X * CLUSTER_Y; ++i)
+        {
+            int ClusterIndex = z * CLUSTER_X * CLUSTER_Y + i;
+            const cluster_bounds& Bounds = ClusterBounds[ClusterIndex];
+            uint32_t Offset = (uint32_t)Job.LightIndices.size();
+
+            // Sphere/box test (distance from the sphere center to the box)
+            for (uint16_t LightIndex : SliceLights)
+            {
+                const light_sphere& Sphere = LightSpheres[LightIndex];
+                v3 Delta = {
+                    Math::Max(Math::Max(Bounds.Min.x - Sphere.Center.x, 0.f), Sphere.Center.x - Bounds.Max.x),
+                    Math::Max(Math::Max(Bounds.Min.y - Sphere.Center.y, 0.f), Sphere.Center.y - Bounds.Max.y),
+                    Math::Max(Math::Max(Bounds.Min.z - Sphere.Center.z, 0.f), Sphere.Center.z - Bounds.Max.z),
+                };
+                if (Vec3::Dot(Delta, Delta) <= Sphere.Radius * Sphere.Radius)
+                    Job.LightIndices.push_back(LightIndex);
+            }
+
+            ClusterGrid[2 * ClusterIndex + 0] = Offset;
+            ClusterGrid[2 * ClusterIndex + 1] = (uint32_t)Job.LightIndices.size() - Offset;
+        }
+    }
+}
+
+void demo_clustered::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
+{
+    glEnable(GL_DEPTH_TEST);
+
+    // Use shader and configure its uniforms
+    TavernProgram.Use();
+
+    // Uniforms that won't change (only uploaded once by GL::program)
+    TavernProgram.SetInt("uDiffuseTexture", 0);
+    TavernProgram.SetInt("uEmissiveTexture", 1);
+    TavernProgram.SetInt("uClusterGrid", 2);
+    TavernProgram.SetInt("uLightIndices", 3);
+    TavernProgram.SetVec3("uEmissiveTint", TavernRenderer.EmissiveTint);
+    TavernProgram.SetFloat("uClusterNear", CAMERA_NEAR);
+    TavernProgram.SetFloat("uClusterDepthScale", CLUSTER_Z / logf(CAMERA_FAR / CAMERA_NEAR));
+    TavernProgram.BindUniformBlock("uLightBlock", LIGHT_BLOCK_BINDING_POINT);
+
+    // Set uniforms
+    mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(ModelMatrix));
+    TavernProgram.SetMat4("uModel", ModelMatrix);
+    TavernProgram.SetMat4("uModelNormalMatrix", NormalMatrix);
+    TavernProgram.SetInt("uShowHeatmap", ShowHeatmap);
+
+    // Upload view and bind uniform buffers and textures
+    FrameBlock.SetView(ProjectionMatrix, ViewMatrix);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, LightsUniformBuffer);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, TavernScene.DiffuseTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, TavernScene.EmissiveTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, ClusterGridTexture);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_BUFFER, LightIndexTexture);
+    glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
+
+    // Draw mesh
+    glBindVertexArray(TavernVAO);
+    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+
+#include "demo.h"
+
+#include "opengl_headers.h"
+
+#include "camera.h"
+
+#include "job_pool.h"
+
+#include "tavern_scene.h"
+#include "tavern_renderer.h"
+
+// Clustered forward shading: the view frustum is sliced into froxels, lights are assigned to them on the CPU
+// (multithreaded, every frame) and the tavern shader only loops over the lights of its cluster
+class demo_clustered : public demo
+{
+public:
+    demo_clustered(GL::cache& GLCache, GL::debug& GLDebug);
+    virtual ~demo_clustered();
+    virtual void Update(const platform_io& IO);
+
+    void RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
+    void DisplayDebugUI();
+
+private:
+    struct light_sphere
+    {
+        v3 Center; // View space
+        float Radius;
+    };
+
+    struct cluster_bounds
+    {
+        v3 Min; // View space
+        v3 Max;
+    };
+
+    // Lights assigned to a range of depth slices
+    struct cluster_job
+    {
+        int FirstSlice;
+        int EndSlice;
+        std::vector<uint16_t> LightIndices;
+    };
+
+    void UpdateLights(float Time);
+    void BuildClusterBounds(float FovY, float AspectRatio);
+    void AssignLights(const mat4& ViewMatrix);
+    void AssignSlices(cluster_job& Job);
+
+    GL::debug& GLDebug;
+
+    // 3d camera
+    camera Camera = {};
+
+    GL::program TavernProgram;
+    GLuint TavernVAO = 0;
+    GL::frame_block FrameBlock;
+
+    // Sun + flickering candles
+    int LightCount = 256;
+    std::vector<GL::light> Lights;
+    std::vector<GL::light_data> LightsData;
+    std::vector<float> FlickerPhases;
+    GLuint LightsUniformBuffer = 0;
+
+    // Clusters (offset/count per cluster and light indices in texture buffers)
+    float ClusterBoundsAspectRatio = 0.f;
+    std::vector<cluster_bounds> ClusterBounds;
+    std::vector<light_sphere> LightSpheres;
+    std::vector<uint32_t> ClusterGrid;
+    std::vector<uint16_t> LightIndices;
+    std::vector<cluster_job> Jobs;
+    GLuint ClusterGridBuffer = 0;
+    GLuint ClusterGridTexture = 0;
+    GLuint LightIndexBuffer = 0;
+    GLuint LightIndexTexture = 0;
+
+    // Slices are split in ThreadCount jobs run by JobPool (workers created once)
+    job_pool JobPool;
+    int ThreadCount = 1;
+
+    // Stats
+    double AssignTime = 0.0; // ms
+    int MaxLightsPerCluster = 0;
+    bool ShowHeatmap = false;
+
+    tavern_scene TavernScene;
+    tavern_renderer TavernRenderer;
+
+    bool Wireframe = false;
+};
@@ -63,7 +63,7 @@ void main()
 demo_instancing::demo_instancing()
 {
     // Create render pipeline
-    this->Program = GL::CreateProgram(gVertexShaderStr, gFragmentShaderStr);
+    this->Program.Create(gVertexShaderStr, gFragmentShaderStr);
     
     // Gen mesh
     {
@@ -115,7 +115,6 @@ demo_instancing::~demo_instancing()
     glDeleteTextures(1, &Texture);
     glDeleteBuffers(1, &VertexBuffer);
     glDeleteVertexArrays(1, &VAO);
-    glDeleteProgram(Program);
 
     glDeleteBuffers(1, &InstanceTransformVBO);
     glDeleteBuffers(1, &InstanceColorVBO);
@@ -124,15 +123,15 @@ demo_instancing::~demo_instancing()
     InstanceColor.clear();
 }
 
-void demo_instancing::Draw(const GLuint& Program, const mat4& ViewProj) const
+void demo_instancing::Draw(GL::program& Program, const mat4& ViewProj) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uVP"), 1, GL_FALSE, ViewProj.e);
+    Program.SetMat4("uVP", ViewProj);
     glDrawArrays(GL_TRIANGLES, 0, VertexCount);
 }
 
-void demo_instancing::DrawInstanced(const GLuint& Program, const mat4& ViewProj, const GLsizei& instanceCount) const
+void demo_instancing::DrawInstanced(GL::program& Program, const mat4& ViewProj, const GLsizei& instanceCount) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uVP"), 1, GL_FALSE, ViewProj.e);
+    Program.SetMat4("uVP", ViewProj);
     glDrawArraysInstanced(GL_TRIANGLES, 0, VertexCount, instanceCount);
 }
 
@@ -153,8 +152,8 @@ void demo_instancing::Update(const platform_io& IO)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     // Use shader and send data
-    glUseProgram(Program);
-    glUniform1f(glGetUniformLocation(Program, "uTime"), (float)IO.Time);
+    Program.Use();
+    Program.SetFloat("uTime", (float)IO.Time);
     
     glBindTexture(GL_TEXTURE_2D, Texture);
     glBindVertexArray(VAO);
@@ -3,6 +3,7 @@
 #include "demo.h"
 
 #include "opengl_headers.h"
+#include "opengl_helpers_program.h"
 
 #include "camera.h"
 
@@ -15,8 +16,8 @@ public:
     virtual ~demo_instancing();
     virtual void Update(const platform_io& IO);
 
-    void Draw(const GLuint& Program, const mat4& ViewProj) const;
-    void DrawInstanced(const GLuint& Program, const mat4& ViewProj, const GLsizei& instanceCount) const;
+    void Draw(GL::program& Program, const mat4& ViewProj) const;
+    void DrawInstanced(GL::program& Program, const mat4& ViewProj, const GLsizei& instanceCount) const;
 
     void SetInstanceAttributes();
     void UpdateInstanceAttributes();
@@ -30,7 +31,7 @@ private:
     camera Camera = {};
     
     // GL objects needed by this demo
-    GLuint Program = 0;
+    GL::program Program;
     GLuint Texture = 0;
 
     GLuint VAO = 0;
@@ -0,0 +1,598 @@
+
+#include <vector>
+
+#include <imgui.h>
+
+#include "opengl_helpers.h"
+#include "opengl_helpers_wireframe.h"
+
+#include "color.h"
+#include "maths.h"
+#include "mesh.h"
+
+#include "demo_lighting.h"
+
+const int LIGHT_BLOCK_BINDING_POINT = 0;
+
+enum render_path
+{
+    RENDER_PATH_FORWARD,
+    RENDER_PATH_DEFERRED,
+    RENDER_PATH_LIGHTMAP,
+};
+
+#pragma region deferred_shaders
+static const char* gGBufferVertexShaderStr = R"GLSL(
+// Attributes
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec2 aUV;
+layout(location = 2) in vec3 aNormal;
+
+// Uniforms (view/projection from uFrame)
+uniform mat4 uModel;
+uniform mat4 uModelNormalMatrix;
+
+// Varyings
+out vec2 vUV;
+out vec3 vNormal;
+
+void main()
+{
+    vUV = aUV;
+    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    gl_Position = uFrame.viewProj * (uModel * vec4(aPosition, 1.0));
+})GLSL";
+
+static const char* gGBufferFragmentShaderStr = R"GLSL(
+// Varyings
+in vec2 vUV;
+in vec3 vNormal;
+
+// Uniforms
+uniform sampler2D uDiffuseTexture;  // Alpha: emissive intensity (PACKED_EMISSIVE)
+uniform sampler2D uEmissiveTexture; // Emissive tint map (PACKED_EMISSIVE_TINT_TEXTURE)
+uniform vec3 uEmissiveTint;
+
+// G-buffer
+layout(location = 0) out vec4 oAlbedo;
+layout(location = 1) out vec2 oNormal;
+layout(location = 2) out vec3 oEmissive;
+
+vec3 get_emissive(vec4 diffuseTexel)
+{
+#if defined(PACKED_EMISSIVE_TINT_TEXTURE)
+    return diffuseTexel.a * texture(uEmissiveTexture, vUV).rgb;
+#elif defined(PACKED_EMISSIVE)
+    return diffuseTexel.a * uEmissiveTint;
+#else
+    return texture(uEmissiveTexture, vUV).rgb;
+#endif
+}
+
+// Octahedral normal encoding
+vec2 oct_wrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 oct_encode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : oct_wrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec4 diffuseTexel = texture(uDiffuseTexture, vUV);
+    oAlbedo = vec4(diffuseTexel.rgb, 1.0);
+    oNormal = oct_encode(normalize(vNormal));
+    oEmissive = get_emissive(diffuseTexel);
+})GLSL";
+
+// Fullscreen triangle, drawn once per light inside its scissor rect
+static const char* gDeferredLightVertexShaderStr = R"GLSL(
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+})GLSL";
+
+static const char* gDeferredLightFragmentShaderStr = R"GLSL(
+// Uniforms
+uniform sampler2D uGBufferAlbedo;
+uniform sampler2D uGBufferNormal;
+uniform sampler2D uGBufferEmissive;
+uniform sampler2D uGBufferDepth;
+uniform mat4 uInverseViewProj;
+uniform int uLightIndex; // -1: emissive pass
+
+// Uniform blocks
+layout(std140) uniform uLightBlock
+{
+	light uLight[LIGHT_COUNT];
+};
+
+// Shader outputs
+out vec4 oColor;
+
+vec3 oct_decode(vec2 f)
+{
+    f = f * 2.0 - 1.0;
+    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(uGBufferDepth, coord, 0).r;
+    if (depth == 1.0)
+        discard;
+
+    if (uLightIndex < 0)
+    {
+        oColor = vec4(gDefaultMaterial.emission + texelFetch(uGBufferEmissive, coord, 0).rgb, 1.0);
+        return;
+    }
+
+    // World position from depth
+    vec2 uv = (gl_FragCoord.xy - uFrame.viewport.xy) / uFrame.viewport.zw;
+    vec4 position = uInverseViewProj * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    position /= position.w;
+
+    vec3 normal = oct_decode(texelFetch(uGBufferNormal, coord, 0).rg);
+    vec3 albedo = texelFetch(uGBufferAlbedo, coord, 0).rgb;
+
+    light_shade_result light = light_shade(uLight[uLightIndex], gDefaultMaterial.shininess, uFrame.viewPosition.xyz, position.xyz, normal);
+    vec3 ambientColor  = gDefaultMaterial.ambient * light.ambient;
+    vec3 diffuseColor  = gDefaultMaterial.diffuse * light.diffuse * albedo;
+    vec3 specularColor = gDefaultMaterial.specular * light.specular;
+    oColor = vec4(ambientColor + diffuseColor + specularColor, 1.0);
+})GLSL";
+#pragma endregion deferred_shaders
+
+demo_lighting::demo_lighting(GL::cache& GLCache, GL::debug& GLDebug)
+    : GLCache(GLCache), GLDebug(GLDebug), TavernScene(GLCache), TavernRenderer(GLCache, TavernScene)
+{
+    // Create a vertex array and bind attribs onto the vertex buffer
+    {
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+        
+        vertex_descriptor& Desc = TavernScene.MeshDesc;
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.PositionOffset);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.UVOffset);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
+    }
+
+    // Deferred path (programs shared through GLCache, G-buffer created on first use)
+    {
+        GBufferProgram = GLCache.LoadProgram(gGBufferVertexShaderStr, gGBufferFragmentShaderStr, TavernRenderer.MaterialShaderDefines.c_str(), true);
+        DeferredLightProgram = GLCache.LoadProgram(gDeferredLightVertexShaderStr, gDeferredLightFragmentShaderStr, TavernRenderer.ProgramDefines.c_str(), true);
+        glGenVertexArrays(1, &EmptyVAO);
+        glGenQueries(ARRAY_SIZE(TimerQueries), TimerQueries);
+    }
+
+    // Lightmap (loaded from disk cache or baked in background, the first time it is used)
+    LightmapProgram = TavernRenderer.LoadProgramVariant("#define LIGHTMAP\n");
+}
+
+demo_lighting::~demo_lighting()
+{
+    // Cleanup GL
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &EmptyVAO);
+    glDeleteQueries(ARRAY_SIZE(TimerQueries), TimerQueries);
+    glDeleteTextures(1, &LightmapTexture);
+    glDeleteBuffers(1, &LightmapUVBuffer);
+    GLCache.ReleaseProgram(LightmapProgram);
+    glDeleteFramebuffers(1, &GBufferFBO);
+    glDeleteTextures(ARRAY_SIZE(GBufferTextures), GBufferTextures);
+    GLCache.ReleaseProgram(GBufferProgram);
+    GLCache.ReleaseProgram(DeferredLightProgram);
+}
+
+void demo_lighting::Update(const platform_io& IO)
+{
+    const float AspectRatio = (float)IO.WindowWidth / (float)IO.WindowHeight;
+    glViewport(0, 0, IO.WindowWidth, IO.WindowHeight);
+
+    Camera = CameraUpdateFreefly(Camera, IO.CameraInputs);
+    FrameBlock.SetTime(IO.Time, IO.DeltaTime);
+
+    // Clear screen
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    mat4 ProjectionMatrix = Mat4::Perspective(Math::ToRadians(60.f), AspectRatio, 0.1f, 100.f);
+    mat4 ViewMatrix = CameraGetInverseMatrix(Camera);
+    mat4 ModelMatrix = Mat4::Translate({ 0.f, 0.f, 0.f });
+
+    // Background bake done
+    if (LightmapBaker.Poll())
+    {
+        this->UploadLightmap();
+        LightmapBaker.SaveToCache("media/fantasy_game_inn.obj", BakingKey);
+    }
+
+    // Read back the last timing of the current path if it is available
+    int Path = Deferred ? RENDER_PATH_DEFERRED : ((UseLightmap && LightmapTexture) ? RENDER_PATH_LIGHTMAP : RENDER_PATH_FORWARD);
+    if (TimerQueryPending[Path])
+    {
+        GLint Available = 0;
+        glGetQueryObjectiv(TimerQueries[Path], GL_QUERY_RESULT_AVAILABLE, &Available);
+        if (Available)
+        {
+            GLuint64 Elapsed = 0;
+            glGetQueryObjectui64v(TimerQueries[Path], GL_QUERY_RESULT, &Elapsed);
+            GPUTimes[Path] = Elapsed / 1000000.0;
+            TimerQueryPending[Path] = false;
+        }
+    }
+
+    // Render tavern
+    bool StartQuery = !TimerQueryPending[Path];
+    if (StartQuery)
+        glBeginQuery(GL_TIME_ELAPSED, TimerQueries[Path]);
+
+    if (Deferred)
+        this->RenderTavernDeferred(ProjectionMatrix, ViewMatrix, ModelMatrix);
+    else
+        this->RenderTavern(ProjectionMatrix, ViewMatrix, ModelMatrix);
+
+    if (StartQuery)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        TimerQueryPending[Path] = true;
+    }
+
+    // Render tavern wireframe
+    if (Wireframe)
+    {
+        GLDebug.Wireframe.BindBuffer(TavernScene.MeshBuffer, TavernScene.MeshDesc.Stride, TavernScene.MeshDesc.PositionOffset, TavernScene.MeshVertexCount);
+        GLDebug.Wireframe.DrawArray(0, TavernScene.MeshVertexCount, ProjectionMatrix * ViewMatrix * ModelMatrix);
+    }
+    
+    // Display debug UI
+    this->DisplayDebugUI();
+}
+
+void demo_lighting::DisplayDebugUI()
+{
+    if (ImGui::TreeNodeEx("demo_lighting", ImGuiTreeNodeFlags_Framed))
+    {
+        // Debug display
+        ImGui::Checkbox("Wireframe", &Wireframe);
+        if (ImGui::TreeNodeEx("Camera"))
+        {
+            ImGui::Text("Position: (%.2f, %.2f, %.2f)", Camera.Position.x, Camera.Position.y, Camera.Position.z);
+            ImGui::Text("Pitch: %.2f", Math::ToDegrees(Camera.Pitch));
+            ImGui::Text("Yaw: %.2f", Math::ToDegrees(Camera.Yaw));
+            ImGui::TreePop();
+        }
+        ImGui::Checkbox("Deferred", &Deferred);
+        ImGui::Text("GPU time: forward %.3f ms, deferred %.3f ms, lightmap %.3f ms",
+            GPUTimes[RENDER_PATH_FORWARD], GPUTimes[RENDER_PATH_DEFERRED], GPUTimes[RENDER_PATH_LIGHTMAP]);
+        if (ImGui::TreeNodeEx("Lightmap"))
+        {
+            if (ImGui::Checkbox("Use lightmap (forward path)", &UseLightmap) && UseLightmap && LightmapTexture == 0 && !LightmapBaker.IsRunning())
+                this->StartLightmapBake();
+            for (int i = 0; i < TavernScene.LightCount; ++i)
+            {
+                char Label[32];
+                snprintf(Label, ARRAY_SIZE(Label), "Bake light %d", i);
+                ImGui::CheckboxFlags(Label, &BakedLightMask, 1u << i);
+            }
+
+            static const int Resolutions[] = { 256, 512, 1024, 2048 };
+            int ResolutionIndex = 0;
+            while (ResolutionIndex < 3 && Resolutions[ResolutionIndex] < LightmapSettings.Resolution)
+                ++ResolutionIndex;
+            if (ImGui::Combo("Resolution", &ResolutionIndex, "256\0" "512\0" "1024\0" "2048\0"))
+                LightmapSettings.Resolution = Resolutions[ResolutionIndex];
+            ImGui::SliderInt("Bounce samples", &LightmapSettings.SampleCount, 0, 256);
+
+            if (LightmapBaker.IsRunning())
+            {
+                ImGui::ProgressBar(LightmapBaker.GetProgress());
+                if (ImGui::Button("Cancel"))
+                    LightmapBaker.Cancel();
+            }
+            else
+            {
+                if (ImGui::Button("Bake"))
+                    this->StartLightmapBake();
+                if (LightmapTexture)
+                {
+                    ImGui::SameLine();
+                    if (LightmapBaker.BakeTime > 0.0)
+                        ImGui::Text("%dx%d, baked in %.2f s", LightmapBaker.Resolution, LightmapBaker.Resolution, LightmapBaker.BakeTime / 1000.0);
+                    else
+                        ImGui::Text("%dx%d, loaded from cache", LightmapBaker.Resolution, LightmapBaker.Resolution);
+                }
+            }
+
+            if (LightmapTexture && LightmapKey != lightmap_baker::ComputeKey(LightmapSourceHash, GetBakedLights(), LightmapSettings))
+                ImGui::TextColored(ImVec4(1.f, 0.6f, 0.f, 1.f), "Out of date (lights or settings changed)");
+            ImGui::TreePop();
+        }
+        TavernScene.InspectLights();
+        if (TavernRenderer.MaterialShaderDefines.empty())
+            ImGui::Text("Material: not packed");
+        else
+            ImGui::Text("Material: packed (%d KB saved)", TavernRenderer.MaterialBytesSaved / 1024);
+
+        ImGui::TreePop();
+    }
+}
+
+void demo_lighting::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
+{
+    // Shader is compiled in background, skip the tavern until it is linked
+    if (!TavernRenderer.IsProgramReady())
+        return;
+
+    glEnable(GL_DEPTH_TEST);
+
+    // Use shader and configure its uniforms (baked lights are skipped with the lightmap variant)
+    bool Lightmapped = UseLightmap && LightmapTexture && LightmapProgram->IsReady();
+    GL::program& Program = Lightmapped ? *LightmapProgram : *TavernRenderer.Program;
+    Program.Use();
+    if (Lightmapped)
+    {
+        TavernRenderer.SetProgramConstants(Program);
+        Program.SetInt("uLightmap", 2);
+    }
+
+    // Set uniforms
+    mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(ModelMatrix));
+    Program.SetMat4("uModel", ModelMatrix);
+    Program.SetMat4("uModelNormalMatrix", NormalMatrix);
+    Program.SetInt("uLightCount", TavernRenderer.CullLights(ProjectionMatrix * ViewMatrix, ModelMatrix, Lightmapped ? BakedLightMask : 0));
+    
+    // Upload view and bind uniform buffers and textures
+    FrameBlock.SetView(ProjectionMatrix, ViewMatrix);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernRenderer.CulledLightsUniformBuffer);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, TavernScene.DiffuseTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, TavernScene.EmissiveTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, LightmapTexture);
+    glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
+    
+    // Draw mesh
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+}
+
+std::vector<GL::light> demo_lighting::GetBakedLights() const
+{
+    std::vector<GL::light> Lights;
+    for (int i = 0; i < TavernScene.LightCount; ++i)
+    {
+        if (BakedLightMask & (1u << i))
+            Lights.push_back(TavernScene.GetLight(i));
+    }
+    return Lights;
+}
+
+void demo_lighting::StartLightmapBake()
+{
+    // Albedo scaled by the default material diffuse (gDefaultMaterial)
+    const char* AlbedoFilename = "media/fantasy_game_inn_diffuse.png";
+    const v3 AlbedoScale = { 0.8f, 0.8f, 0.8f };
+
+    // Vertices are only kept on GPU
+    std::vector<vertex_full> Vertices(TavernScene.MeshVertexCount);
+    glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, Vertices.size() * sizeof(vertex_full), Vertices.data());
+    LightmapSourceHash = lightmap_baker::HashSources(Vertices, AlbedoFilename, IMG_FLIP, AlbedoScale);
+
+    // Lights are baked in object space (the tavern is drawn with an identity model matrix)
+    std::vector<GL::light> Lights = GetBakedLights();
+    BakingKey = lightmap_baker::ComputeKey(LightmapSourceHash, Lights, LightmapSettings);
+    if (LightmapBaker.LoadFromCache("media/fantasy_game_inn.obj", BakingKey, LightmapSettings.Resolution, (int)Vertices.size()))
+    {
+        this->UploadLightmap();
+        return;
+    }
+
+    LightmapBaker.Start(Vertices, Lights, AlbedoFilename, IMG_FLIP, AlbedoScale, LightmapSettings);
+}
+
+void demo_lighting::UploadLightmap()
+{
+    if (LightmapTexture == 0)
+    {
+        glGenTextures(1, &LightmapTexture);
+        glGenBuffers(1, &LightmapUVBuffer);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, LightmapTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, LightmapBaker.Resolution, LightmapBaker.Resolution, 0, GL_RGBA, GL_FLOAT, LightmapBaker.Texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Lightmap UVs in their own buffer (the mesh buffer is shared through GLCache)
+    glBindBuffer(GL_ARRAY_BUFFER, LightmapUVBuffer);
+    glBufferData(GL_ARRAY_BUFFER, LightmapBaker.LightmapUVs.size() * sizeof(v2), LightmapBaker.LightmapUVs.data(), GL_STATIC_DRAW);
+    glBindVertexArray(VAO);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(v2), (void*)0);
+
+    LightmapKey = BakingKey;
+}
+
+void demo_lighting::ResizeGBuffer(int Width, int Height)
+{
+    GBufferWidth = Width;
+    GBufferHeight = Height;
+
+    // Albedo (RGBA8), octahedral normal (RG16), emissive (R11G11B10F), depth: 16 bytes per pixel
+    const GLenum Formats[4][3] =
+    {
+        { GL_RGBA8,              GL_RGBA,          GL_UNSIGNED_BYTE },
+        { GL_RG16,               GL_RG,            GL_UNSIGNED_SHORT },
+        { GL_R11F_G11F_B10F,     GL_RGB,           GL_FLOAT },
+        { GL_DEPTH24_STENCIL8,   GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 },
+    };
+
+    if (GBufferFBO == 0)
+    {
+        glGenFramebuffers(1, &GBufferFBO);
+        glGenTextures(ARRAY_SIZE(GBufferTextures), GBufferTextures);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, GBufferFBO);
+    for (int i = 0; i < (int)ARRAY_SIZE(GBufferTextures); ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, GBufferTextures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, Formats[i][0], Width, Height, 0, Formats[i][1], Formats[i][2], nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        GLenum Attachment = (i == 3) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_COLOR_ATTACHMENT0 + i;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, Attachment, GL_TEXTURE_2D, GBufferTextures[i], 0);
+    }
+
+    const GLenum DrawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, DrawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "G-buffer framebuffer incomplete\n");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void demo_lighting::RenderTavernDeferred(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
+{
+    if (!GBufferProgram->IsReady() || !DeferredLightProgram->IsReady())
+        return;
+
+    GLint Viewport[4];
+    glGetIntegerv(GL_VIEWPORT, Viewport);
+    if (Viewport[2] != GBufferWidth || Viewport[3] != GBufferHeight)
+        this->ResizeGBuffer(Viewport[2], Viewport[3]);
+
+    GLint TargetFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &TargetFramebuffer);
+
+    FrameBlock.SetView(ProjectionMatrix, ViewMatrix);
+
+    // Geometry pass
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, GBufferFBO);
+        glViewport(0, 0, GBufferWidth, GBufferHeight);
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+        GL::program& Program = *GBufferProgram;
+        Program.Use();
+        Program.SetInt("uDiffuseTexture", 0);
+        Program.SetInt("uEmissiveTexture", 1);
+        Program.SetVec3("uEmissiveTint", TavernRenderer.EmissiveTint);
+        Program.SetMat4("uModel", ModelMatrix);
+        Program.SetMat4("uModelNormalMatrix", Mat4::Transpose(Mat4::Inverse(ModelMatrix)));
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, TavernScene.DiffuseTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, TavernScene.EmissiveTexture);
+
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    }
+
+    // Copy depth so later passes (wireframe, overlays) can depth test against the tavern
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, GBufferFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, TargetFramebuffer);
+    glBlitFramebuffer(0, 0, GBufferWidth, GBufferHeight, Viewport[0], Viewport[1], Viewport[0] + Viewport[2], Viewport[1] + Viewport[3], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+
+    // Lighting pass: emissive, then one additive scissored fullscreen triangle per light
+    {
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        GL::program& Program = *DeferredLightProgram;
+        Program.Use();
+        Program.SetInt("uGBufferAlbedo", 0);
+        Program.SetInt("uGBufferNormal", 1);
+        Program.SetInt("uGBufferEmissive", 2);
+        Program.SetInt("uGBufferDepth", 3);
+        Program.SetMat4("uInverseViewProj", Mat4::Inverse(ProjectionMatrix * ViewMatrix));
+        Program.BindUniformBlock("uLightBlock", LIGHT_BLOCK_BINDING_POINT);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
+        for (int i = 0; i < 4; ++i)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, GBufferTextures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
+
+        glBindVertexArray(EmptyVAO);
+        Program.SetInt("uLightIndex", -1);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glEnable(GL_SCISSOR_TEST);
+        for (int i = 0; i < TavernScene.LightCount; ++i)
+        {
+            const GL::light& Light = TavernScene.GetLight(i);
+            if (!Light.Enabled)
+                continue;
+
+            // Screen rect of the light sphere (whole viewport for directional lights or when the sphere crosses the near plane)
+            v2 Min = { -1.f, -1.f };
+            v2 Max = { 1.f, 1.f };
+            float Radius = GL::GetLightRadius(Light);
+            v4 Center = ViewMatrix * Vec4::vec4(Light.Position.xyz, 1.f);
+            if (Radius < INFINITY && Center.z + Radius < -0.1f)
+            {
+                Min = { 1.f, 1.f };
+                Max = { -1.f, -1.f };
+                for (int Corner = 0; Corner < 8; ++Corner)
+                {
+                    v4 Position = Center;
+                    Position.x += (Corner & 1) ? Radius : -Radius;
+                    Position.y += (Corner & 2) ? Radius : -Radius;
+                    Position.z += (Corner & 4) ? Radius : -Radius;
+                    v4 Clip = ProjectionMatrix * Position;
+                    Min = { Math::Min(Min.x, Clip.x / Clip.w), Math::Min(Min.y, Clip.y / Clip.w) };
+                    Max = { Math::Max(Max.x, Clip.x / Clip.w), Math::Max(Max.y, Clip.y / Clip.w) };
+                }
+                Min = { Math::Max(Min.x, -1.f), Math::Max(Min.y, -1.f) };
+                Max = { Math::Min(Max.x, 1.f), Math::Min(Max.y, 1.f) };
+                if (Min.x >= Max.x || Min.y >= Max.y)
+                    continue;
+            }
+
+            int X0 = Viewport[0] + (int)floorf((Min.x * 0.5f + 0.5f) * Viewport[2]);
+            int Y0 = Viewport[1] + (int)floorf((Min.y * 0.5f + 0.5f) * Viewport[3]);
+            int X1 = Viewport[0] + (int)ceilf((Max.x * 0.5f + 0.5f) * Viewport[2]);
+            int Y1 = Viewport[1] + (int)ceilf((Max.y * 0.5f + 0.5f) * Viewport[3]);
+            glScissor(X0, Y0, X1 - X0, Y1 - Y0);
+
+            Program.SetInt("uLightIndex", i);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glDisable(GL_SCISSOR_TEST);
+
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+
+#include "demo.h"
+
+#include "opengl_headers.h"
+
+#include "camera.h"
+
+#include "tavern_scene.h"
+#include "tavern_renderer.h"
+#include "lightmap_baker.h"
+
+// Tavern rendered with the forward, deferred or lightmapped paths, with the GPU time of each path
+class demo_lighting : public demo
+{
+public:
+    demo_lighting(GL::cache& GLCache, GL::debug& GLDebug);
+    virtual ~demo_lighting();
+    virtual void Update(const platform_io& IO);
+
+    void RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
+    void RenderTavernDeferred(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
+    void DisplayDebugUI();
+
+private:
+    void ResizeGBuffer(int Width, int Height);
+    std::vector<GL::light> GetBakedLights() const;
+    void StartLightmapBake();
+    void UploadLightmap();
+
+    GL::cache& GLCache;
+    GL::debug& GLDebug;
+
+    // 3d camera
+    camera Camera = {};
+
+    // GL objects needed by this demo (program is owned by TavernRenderer)
+    GLuint VAO = 0;
+    GL::frame_block FrameBlock;
+
+    tavern_scene TavernScene;
+    tavern_renderer TavernRenderer;
+
+    // Deferred path (G-buffer: albedo, octahedral normal, emissive, depth)
+    bool Deferred = false;
+    GL::program* GBufferProgram = nullptr;
+    GL::program* DeferredLightProgram = nullptr;
+    GLuint GBufferFBO = 0;
+    GLuint GBufferTextures[4] = {};
+    int GBufferWidth = 0;
+    int GBufferHeight = 0;
+    GLuint EmptyVAO = 0;
+
+    // Static lighting baked on the CPU, lights in BakedLightMask are a texture fetch, the others stay dynamic
+    bool UseLightmap = false;
+    unsigned int BakedLightMask = 0x3E; // Candles (the sun stays dynamic)
+    lightmap_baker LightmapBaker;
+    lightmap_baker::settings LightmapSettings;
+    uint64_t LightmapSourceHash = 0; // Mesh and albedo (see lightmap_baker::HashSources)
+    uint64_t BakingKey = 0;          // Bake in progress
+    uint64_t LightmapKey = 0;        // Bake in LightmapTexture
+    GL::program* LightmapProgram = nullptr;
+    GLuint LightmapTexture = 0;
+    GLuint LightmapUVBuffer = 0;
+
+    // GPU time of the forward, deferred and lightmap paths (queries are read back without stalling)
+    GLuint TimerQueries[3] = {};
+    bool TimerQueryPending[3] = {};
+    double GPUTimes[3] = {}; // ms
+
+    bool Wireframe = false;
+};
@@ -57,7 +57,7 @@ void main()
 demo_minimal::demo_minimal()
 {
     // Create render pipeline
-    this->Program = GL::CreateProgram(gVertexShaderStr, gFragmentShaderStr);
+    this->Program.Create(gVertexShaderStr, gFragmentShaderStr);
     
     // Gen mesh
     {
@@ -104,12 +104,11 @@ demo_minimal::~demo_minimal()
     glDeleteTextures(1, &Texture);
     glDeleteBuffers(1, &VertexBuffer);
     glDeleteVertexArrays(1, &VAO);
-    glDeleteProgram(Program);
 }
 
-static void DrawQuad(GLuint Program, mat4 ModelViewProj)
+static void DrawQuad(GL::program& Program, mat4 ModelViewProj)
 {
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uModelViewProj"), 1, GL_FALSE, ModelViewProj.e);
+    Program.SetMat4("uModelViewProj", ModelViewProj);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
@@ -130,8 +129,8 @@ void demo_minimal::Update(const platform_io& IO)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     // Use shader and send data
-    glUseProgram(Program);
-    glUniform1f(glGetUniformLocation(Program, "uTime"), (float)IO.Time);
+    Program.Use();
+    Program.SetFloat("uTime", (float)IO.Time);
     
     glBindTexture(GL_TEXTURE_2D, Texture);
     glBindVertexArray(VAO);
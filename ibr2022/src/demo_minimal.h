@@ -3,6 +3,7 @@
 #include "demo.h"
 
 #include "opengl_headers.h"
+#include "opengl_helpers_program.h"
 
 #include "camera.h"
 
@@ -18,7 +19,7 @@ private:
     camera Camera = {};
     
     // GL objects needed by this demo
-    GLuint Program = 0;
+    GL::program Program;
     GLuint Texture = 0;
 
     GLuint VAO = 0;
@@ -1,4 +1,5 @@
 
+#include <chrono>
 #include <vector>
 
 #include <imgui.h>
@@ -14,191 +15,21 @@
 
 const int LIGHT_BLOCK_BINDING_POINT = 0;
 
-struct vertex
-{
-    v3 Position;
-    v2 UV;
-};
-
-#pragma region tavern_shader
-static const char* gVertexShaderStr = R"GLSL(
-// Attributes
-layout(location = 0) in vec3 aPosition;
-layout(location = 1) in vec2 aUV;
-layout(location = 2) in vec3 aNormal;
-
-// Uniforms
-uniform mat4 uProjection;
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uModelNormalMatrix;
-
-// Varyings
-out vec2 vUV;
-out vec3 vPos;    // Vertex position in view-space
-out vec3 vNormal; // Vertex normal in view-space
-
-void main()
-{
-    vUV = aUV;
-    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
-    vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
-    gl_Position = uProjection * uView * pos4;
-})GLSL";
-
-static const char* gFragmentShaderStr = R"GLSL(
-// Varyings
-in vec2 vUV;
-in vec3 vPos;
-in vec3 vNormal;
-
-// Uniforms
-uniform mat4 uProjection;
-uniform vec3 uViewPosition;
-
-uniform sampler2D uDiffuseTexture;
-uniform sampler2D uEmissiveTexture;
-
-// Uniform blocks
-layout(std140) uniform uLightBlock
-{
-	light uLight[LIGHT_COUNT];
-};
-
-// Shader outputs
-out vec4 oColor;
-
-light_shade_result get_lights_shading()
-{
-    light_shade_result lightResult = light_shade_result(vec3(0.0), vec3(0.0), vec3(0.0));
-	for (int i = 0; i < LIGHT_COUNT; ++i)
-    {
-        light_shade_result light = light_shade(uLight[i], gDefaultMaterial.shininess, uViewPosition, vPos, normalize(vNormal));
-        lightResult.ambient  += light.ambient;
-        lightResult.diffuse  += light.diffuse;
-        lightResult.specular += light.specular;
-    }
-    return lightResult;
-}
-
-void main()
-{
-    // Compute phong shading
-    light_shade_result lightResult = get_lights_shading();
-    
-    vec3 diffuseColor  = gDefaultMaterial.diffuse * lightResult.diffuse * texture(uDiffuseTexture, vUV).rgb;
-    vec3 ambientColor  = gDefaultMaterial.ambient * lightResult.ambient;
-    vec3 specularColor = gDefaultMaterial.specular * lightResult.specular;
-    vec3 emissiveColor = gDefaultMaterial.emission + texture(uEmissiveTexture, vUV).rgb;
-    
-    // Apply light color
-    oColor = vec4((ambientColor + diffuseColor + specularColor + emissiveColor), 1.0);
-})GLSL";
-#pragma endregion tavern_shader
-
-#pragma region postprocess_shader
-static const char* gVertexPostProcessShaderStr = R"GLSL(
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec2 aUV;
-
-out vec2 vUV;
-
-void main()
-{
-    vUV = aUV;
-    gl_Position = vec4(aPos, 1.0);
-}
-)GLSL";
-
-static const char* gFragmentPostProcessShaderStr = R"GLSL(
-out vec4 oColor;
-
-in vec2 vUV;
-
-uniform sampler2D uRenderTex;
-
-uniform float uOffset;
-uniform mat3 uKernel;
-
-void main()
-{
-    vec2 offsets[9] = vec2[](
-        vec2(-uOffset,  uOffset),
-        vec2( 0.0f,     uOffset),
-        vec2( uOffset,  uOffset),
-        vec2(-uOffset,  0.0f),
-        vec2( 0.0f,     0.0f),
-        vec2( uOffset,  0.0f),
-        vec2(-uOffset, -uOffset),
-        vec2( 0.0f,    -uOffset),
-        vec2( uOffset, -uOffset)
-    );
-
-    vec3 surroundingFrags[9];
-    for (int i = 0; i < 9; ++i)
-    {
-        surroundingFrags[i] = vec3(texture(uRenderTex, vUV + offsets[i]));
-    }
-
-    vec3 blendedColor = vec3(0.0);
-    for (int i = 0; i < 9; ++i)
-    {
-        blendedColor += surroundingFrags[i] * uKernel[i / 3][i % 3];
-    }
-
-    oColor = vec4(blendedColor, 1.0);
-}
-)GLSL";
-#pragma endregion postprocess_shader
-
-#pragma region render_shader
-static const char* gVertexRenderShaderStr = R"GLSL(
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec2 aUV;
-
-out vec2 vUV;
-
-void main()
-{
-    vUV = aUV;
-    gl_Position = vec4(aPos, 1.0);
-}
-)GLSL";
-
-static const char* gFragmentRenderShaderStr = R"GLSL(
-out vec4 oColor;
-
-in vec2 vUV;
-
-uniform float uGamma;
-uniform sampler2D uRenderTex;
-
-void main()
-{
-    oColor = texture(uRenderTex, vUV);
-
-    oColor.rgb = pow(oColor.rgb, vec3(1.0 / uGamma));
-}
-)GLSL";
-#pragma endregion render_shader
-
 demo_postprocess::demo_postprocess(GL::cache& GLCache, GL::debug& GLDebug)
-    : GLDebug(GLDebug), TavernScene(GLCache)
+    : GLDebug(GLDebug), TavernScene(GLCache), TavernRenderer(GLCache, TavernScene), UberPostProcess(GLCache), RenderGraph(GLCache.RenderTargets), TAA(GLCache.RenderTargets)
 {
-    // Create shader
+    // Tavern program is shared through TavernRenderer, blur programs are owned by Blur, screen programs by UberPostProcess
+    // Screen variants reachable from the default settings and the grading UI are compiled up front
     {
-        // Assemble fragment shader strings (defines + code)
-        char FragmentShaderConfig[] = "#define LIGHT_COUNT %d\n";
-        snprintf(FragmentShaderConfig, ARRAY_SIZE(FragmentShaderConfig), "#define LIGHT_COUNT %d\n", TavernScene.LightCount);
-        const char* FragmentShaderStrs[2] = {
-            FragmentShaderConfig,
-            gFragmentShaderStr,
+        const int EffectSets[] =
+        {
+            GL::POSTPROCESS_GAMMA,
+            GL::POSTPROCESS_GAMMA | GL::POSTPROCESS_LUT,
+            GL::POSTPROCESS_BLOOM | GL::POSTPROCESS_GAMMA,
+            GL::POSTPROCESS_BLOOM | GL::POSTPROCESS_GAMMA | GL::POSTPROCESS_LUT,
+            GL::POSTPROCESS_COLOR_MATRIX | GL::POSTPROCESS_GAMMA,
         };
-
-        this->TavernProgram = GL::CreateProgramEx(1, &gVertexShaderStr, 2, FragmentShaderStrs, true);
-        this->PostProcessProgram = GL::CreateProgramEx(1, &gVertexPostProcessShaderStr, 1, &gFragmentPostProcessShaderStr, false);
-        this->RenderProgram = GL::CreateProgramEx(1, &gVertexRenderShaderStr, 1, &gFragmentRenderShaderStr, false);
+        UberPostProcess.Precompile(ARRAY_SIZE(EffectSets), EffectSets);
     }
 
     // Create a vertex array and bind attribs onto the vertex buffer
@@ -217,106 +48,21 @@ demo_postprocess::demo_postprocess(GL::cache& GLCache, GL::debug& GLDebug)
         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
     }
 
-    // Set uniforms that won't change
-    {
-        glUseProgram(TavernProgram);
-        glUniform1i(glGetUniformLocation(TavernProgram, "uDiffuseTexture"), 0);
-        glUniform1i(glGetUniformLocation(TavernProgram, "uEmissiveTexture"), 1);
-        glUniformBlockBinding(TavernProgram, glGetUniformBlockIndex(TavernProgram, "uLightBlock"), LIGHT_BLOCK_BINDING_POINT);
-    }
-
-    // create texture to be rendered as the screen
-    {
-        //direct scene render
-        glGenTextures(1, &RawRenderTex);
-        glBindTexture(GL_TEXTURE_2D, RawRenderTex);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, RenderResolution, RenderResolution, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-        //scene depth render
-        glGenTextures(1, &RenderDepthMap);
-        glBindTexture(GL_TEXTURE_2D, RenderDepthMap);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, RenderResolution, RenderResolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-        //ping pong framebuffers
-        glGenTextures(2, ppRenderTex);
-        for (int i = 0; i < 2; ++i)
-        {
-            glBindTexture(GL_TEXTURE_2D, ppRenderTex[i]);
-
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, RenderResolution, RenderResolution, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        }
-    }
-
-    // create frame buffer
-    {
-        //direct scene render framebuffer
-        glGenFramebuffers(1, &FBO);
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, RawRenderTex, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, RenderDepthMap, 0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        //ping pong framebuffer
-        glGenFramebuffers(2, ppFBO);
-        for (int i = 0; i < 2; ++i)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, ppFBO[i]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ppRenderTex[i], 0);
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    }
+    glGenQueries(2 * FRAME_QUERY_COUNT, FrameTimerQueries[0]);
 
-    // create screen quad
+    // Default grade: slight S-curve and saturation boost
     {
-        // Create a descriptor based on the `struct vertex` format
-        vertex_descriptor Descriptor = {};
-        Descriptor.Stride = sizeof(vertex);
-        Descriptor.HasUV = true;
-        Descriptor.PositionOffset = OFFSETOF(vertex, Position);
-        Descriptor.UVOffset = OFFSETOF(vertex, UV);
-
-        // Create a cube in RAM
-        vertex Quad[6];
-        Mesh::BuildQuad(Quad, Quad + 6, Descriptor);
-
-        for (int i = 0; i < 6; ++i)
-        {
-            Quad[i].Position *= 2.f;
-        }
-
-        GLuint VBO;
-        // Upload cube to gpu (VRAM)
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(vertex), Quad, GL_STATIC_DRAW);
+        GL::color_operation Curves;
+        Curves.Type = GL::color_operation::CURVES;
+        Curves.Curves[0] = { { 0.f, 0.f }, { 0.25f, 0.2f }, { 0.75f, 0.8f }, { 1.f, 1.f } };
+        GradingChain.push_back(Curves);
 
-        glGenVertexArrays(1, &RenderVAO);
-        glBindVertexArray(RenderVAO);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)sizeof(v3));
-        glBindVertexArray(0);
+        GL::color_operation HSL;
+        HSL.Type = GL::color_operation::HSL;
+        HSL.Saturation = 1.15f;
+        GradingChain.push_back(HSL);
 
-        glDeleteBuffers(1, &VBO);
+        this->BakeGradingLUT();
     }
 
     //initializing kernels matrix
@@ -333,11 +79,62 @@ demo_postprocess::~demo_postprocess()
 {
     // Cleanup GL
     glDeleteVertexArrays(1, &TavernVAO);
-    glDeleteVertexArrays(1, &RenderVAO);
-    glDeleteProgram(TavernProgram);
-    glDeleteProgram(PostProcessProgram);
 
-    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &GradingLUT);
+    glDeleteQueries(2 * FRAME_QUERY_COUNT, FrameTimerQueries[0]);
+}
+
+void demo_postprocess::UpdateRenderScale()
+{
+    // Read the oldest frame timestamps without stalling (FRAME_QUERY_COUNT frames of latency)
+    GLuint* Queries = FrameTimerQueries[FrameQueryIndex];
+    GLint Available = 0;
+    if (FrameTimerQueryPending[FrameQueryIndex])
+        glGetQueryObjectiv(Queries[1], GL_QUERY_RESULT_AVAILABLE, &Available);
+    if (Available)
+    {
+        GLuint64 Start = 0;
+        GLuint64 End = 0;
+        glGetQueryObjectui64v(Queries[0], GL_QUERY_RESULT, &Start);
+        glGetQueryObjectui64v(Queries[1], GL_QUERY_RESULT, &End);
+        FrameTimerQueryPending[FrameQueryIndex] = false;
+
+        double FrameTime = (End - Start) / 1000000.0;
+        GPUFrameTime = (GPUFrameTime == 0.0) ? FrameTime : GPUFrameTime + (FrameTime - GPUFrameTime) * 0.1;
+    }
+
+    if (RenderScaleCooldown > 0)
+        RenderScaleCooldown--;
+
+    if (!DynamicResolution)
+    {
+        if (TAAMode == TAA_UPSAMPLE)
+            RenderScale = UpsampleScale;
+        else
+            RenderScale = SpatialUpscale ? SpatialUpscaleScale : 1.f;
+        return;
+    }
+
+    // Only react to new measurements
+    if (!Available || GPUFrameTime <= 0.0 || RenderScaleCooldown > 0)
+        return;
+
+    // GPU time is roughly proportional to the pixel count (RenderScale^2)
+    float Ideal = RenderScale * sqrtf((float)(TargetFrameTime / GPUFrameTime));
+    Ideal = Math::Clamp(Ideal, MinRenderScale, 1.f);
+
+    // Go down as soon as the ideal scale is a step below, go up with one more step of margin (no oscillation)
+    float NewScale = RenderScale;
+    if (Ideal < RenderScale - 0.5f * RenderScaleStep)
+        NewScale = Math::Max(MinRenderScale, RenderScaleStep * floorf(Ideal / RenderScaleStep + 0.5f));
+    else if (Ideal > RenderScale + RenderScaleStep)
+        NewScale = Math::Min(1.f, RenderScale + RenderScaleStep);
+
+    if (NewScale != RenderScale)
+    {
+        RenderScale = NewScale;
+        RenderScaleCooldown = 4 * FRAME_QUERY_COUNT;
+    }
 }
 
 void demo_postprocess::Update(const platform_io& IO)
@@ -346,19 +143,125 @@ void demo_postprocess::Update(const platform_io& IO)
     glViewport(0, 0, IO.WindowWidth, IO.WindowHeight);
 
     Camera = CameraUpdateFreefly(Camera, IO.CameraInputs);
+    FrameBlock.SetTime(IO.Time, IO.DeltaTime);
 
     mat4 ProjectionMatrix = Mat4::Perspective(Math::ToRadians(60.f), AspectRatio, 0.1f, 100.f);
     mat4 ViewMatrix = CameraGetInverseMatrix(Camera);
     mat4 ModelMatrix = Mat4::Translate({ 0.f, 0.f, 0.f });
 
+    // Shaders are compiled in background, only clear the screen until the tavern shader is linked
+    if (!TavernRenderer.IsProgramReady())
+    {
+        glClearColor(0.f, 0.f, 0.f, 1.f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        this->DisplayDebugUI();
+        return;
+    }
+
+    // Render size from the window (follows IO.WindowSizeChanged) and the dynamic resolution scale
+    this->UpdateRenderScale();
+    RenderWidth = Math::Max(1, (int)(IO.WindowWidth * RenderScale + 0.5f));
+    RenderHeight = Math::Max(1, (int)(IO.WindowHeight * RenderScale + 0.5f));
+
+    GLuint* FrameQueries = FrameTimerQueries[FrameQueryIndex];
+    bool MeasureFrame = !FrameTimerQueryPending[FrameQueryIndex];
+    if (MeasureFrame)
+        glQueryCounter(FrameQueries[0], GL_TIMESTAMP);
+
+    // Jittered projection, each frame samples another sub-pixel position
+    mat4 SceneProjectionMatrix = ProjectionMatrix;
+    int OutputWidth = (TAAMode == TAA_UPSAMPLE) ? IO.WindowWidth : RenderWidth;
+    int OutputHeight = (TAAMode == TAA_UPSAMPLE) ? IO.WindowHeight : RenderHeight;
+    if (TAAMode != TAA_OFF)
+    {
+        TAA.NextJitter(RenderWidth, OutputWidth);
+        SceneProjectionMatrix = TAA.JitterProjection(ProjectionMatrix, RenderWidth, RenderHeight);
+    }
+    else
+    {
+        TAA.InvalidateHistory();
+    }
+
     // Render tavern
-    this->RenderTavernFBO(ProjectionMatrix, ViewMatrix, ModelMatrix);
+    GL::render_graph::resource SceneColor = RenderGraph.Create("Scene color", { RenderWidth, RenderHeight, GL_R11F_G11F_B10F });
+    GL::render_graph::resource SceneDepth = RenderGraph.Create("Scene depth", { RenderWidth, RenderHeight, GL_DEPTH_COMPONENT24 });
+    int TavernPass = RenderGraph.AddPass("Tavern", [=](GL::render_graph& Graph)
+    {
+        Graph.BindFramebuffer(SceneColor, SceneDepth);
+        this->RenderTavern(SceneProjectionMatrix, ViewMatrix, ModelMatrix);
+    });
+    RenderGraph.Write(TavernPass, SceneColor);
+    RenderGraph.Write(TavernPass, SceneDepth);
+
+    // Resolved scene (output size), post-processing runs after the TAA
+    GL::render_graph::resource Resolved = SceneColor;
+    if (TAAMode != TAA_OFF)
+    {
+        RenderGraph.BeginTimer(TAATimer);
+        GL::render_graph::resource TAAOutput = TAA.AddPasses(RenderGraph, SceneColor, SceneDepth, ProjectionMatrix * ViewMatrix * ModelMatrix, OutputWidth, OutputHeight);
+        RenderGraph.EndTimer(TAATimer);
+        if (TAAOutput != -1)
+            Resolved = TAAOutput;
+    }
+    float PixelScale = (float)RenderGraph.GetDesc(Resolved).Width / IO.WindowWidth;
 
-    this->RenderPingPong(PostProcessCount);
+    GL::render_graph::resource PostProcessed = this->AddBlurPasses(Resolved, PixelScale);
 
-    // Render screen
-    glViewport(0, 0, IO.WindowWidth, IO.WindowHeight);
-    this->RenderScreen();
+    // Bloom from the unblurred scene, added by the screen pass
+    GL::render_graph::resource BloomTexture = -1;
+    if (PostProcessSettings.Effects & GL::POSTPROCESS_BLOOM)
+    {
+        RenderGraph.BeginTimer(BloomTimer);
+        BloomTexture = Bloom.AddPasses(RenderGraph, Resolved);
+        RenderGraph.EndTimer(BloomTimer);
+    }
+
+    // Render screen, root of the graph (bilinear upscale)
+    // or into a target at the post-processed size, upscaled to the window by the spatial upscaler (perceptual space)
+    int WindowWidth = IO.WindowWidth;
+    int WindowHeight = IO.WindowHeight;
+    float Time = (float)IO.Time;
+    GL::render_target_desc ScreenDesc = RenderGraph.GetDesc(PostProcessed);
+    GL::render_graph::resource Graded = -1;
+    if (SpatialUpscale && Upscaler.IsReady() && (ScreenDesc.Width != WindowWidth || ScreenDesc.Height != WindowHeight))
+        Graded = RenderGraph.Create("Graded", { ScreenDesc.Width, ScreenDesc.Height, GL_RGBA8 });
+
+    int ScreenPass = RenderGraph.AddPass("Screen", [=](GL::render_graph& Graph)
+    {
+        if (Graded != -1)
+        {
+            Graph.BindFramebuffer(Graded);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, WindowWidth, WindowHeight);
+        }
+        this->RenderScreen(Graph.GetTexture(PostProcessed), (BloomTexture != -1) ? Graph.GetTexture(BloomTexture) : 0, Time);
+    });
+    RenderGraph.Read(ScreenPass, PostProcessed);
+    if (BloomTexture != -1)
+        RenderGraph.Read(ScreenPass, BloomTexture);
+
+    UpscaleInputWidth = 0;
+    if (Graded != -1)
+    {
+        RenderGraph.Write(ScreenPass, Graded);
+        RenderGraph.BeginTimer(UpscaleTimer);
+        Upscaler.AddPasses(RenderGraph, Graded, WindowWidth, WindowHeight);
+        RenderGraph.EndTimer(UpscaleTimer);
+        UpscaleInputWidth = ScreenDesc.Width;
+        UpscaleInputHeight = ScreenDesc.Height;
+    }
+
+    RenderGraph.Execute(IO.Time);
+
+    if (MeasureFrame)
+    {
+        glQueryCounter(FrameQueries[1], GL_TIMESTAMP);
+        FrameTimerQueryPending[FrameQueryIndex] = true;
+    }
+    FrameQueryIndex = (FrameQueryIndex + 1) % FRAME_QUERY_COUNT;
 
     // Render tavern wireframe
     if (Wireframe)
@@ -386,22 +289,129 @@ void demo_postprocess::DisplayDebugUI()
         }
         TavernScene.InspectLights();
 
-        if (ImGui::TreeNodeEx("Gamma correction"))
+        if (ImGui::TreeNodeEx("Resolution"))
+        {
+            ImGui::Checkbox("Dynamic resolution", &DynamicResolution);
+            ImGui::SliderFloat("Target GPU time (ms)", &TargetFrameTime, 1.f, 33.f);
+            ImGui::SliderFloat("Min scale", &MinRenderScale, 0.25f, 1.f);
+            ImGui::Text("GPU frame time: %.3f ms", GPUFrameTime);
+            ImGui::Text("Render scale: %.2f (%dx%d)", RenderScale, RenderWidth, RenderHeight);
+
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNodeEx("Spatial upscaler"))
+        {
+            ImGui::Checkbox("EASU + RCAS", &SpatialUpscale);
+            if (SpatialUpscale)
+            {
+                ImGui::SliderFloat("Upscale scale", &SpatialUpscaleScale, 0.5f, 0.77f);
+                if (DynamicResolution)
+                    ImGui::TextDisabled("Render scale is driven by the dynamic resolution");
+                ImGui::SliderFloat("Sharpness (stops, 0 = max)", &Upscaler.Sharpness, 0.f, 2.f);
+                ImGui::Checkbox("Denoise sharpening", &Upscaler.Denoise);
+                if (UpscaleInputWidth > 0)
+                    ImGui::Text("%dx%d to window, GPU %.3f ms", UpscaleInputWidth, UpscaleInputHeight, UpscaleTimer.Time);
+                else
+                    ImGui::TextDisabled("Inactive (scene at window size)");
+            }
+
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNodeEx("Temporal AA"))
         {
-            ImGui::DragFloat("Gamma", &Gamma, 0.1f, 0.6f, 3.f);
+            ImGui::Combo("Mode", &TAAMode, "Off\0Anti-aliasing\0Upsample to window\0");
+            if (TAAMode != TAA_OFF)
+            {
+                ImGui::SliderFloat("Blend", &TAA.Blend, 0.02f, 0.5f);
+                if (TAAMode == TAA_UPSAMPLE)
+                {
+                    ImGui::SliderFloat("Upsample scale", &UpsampleScale, 0.5f, 0.7f);
+                    if (DynamicResolution)
+                        ImGui::TextDisabled("Render scale is driven by the dynamic resolution");
+                }
+                ImGui::Text("Jitter: (%.2f, %.2f), %d phases", TAA.Jitter.x, TAA.Jitter.y, TAA.PhaseCount);
+                ImGui::Text("GPU %.3f ms", TAATimer.Time);
+            }
 
             ImGui::TreePop();
         }
 
+        if (ImGui::TreeNodeEx("Screen effects (fused)"))
+        {
+            int& Effects = PostProcessSettings.Effects;
+            for (int i = 0; i < GL::POSTPROCESS_EFFECT_COUNT; ++i)
+                ImGui::CheckboxFlags(GL::uber_postprocess::GetEffectName(1 << i), (unsigned int*)&Effects, 1 << i);
+
+            if (Effects & GL::POSTPROCESS_BLOOM)
+            {
+                ImGui::SliderFloat("Bloom intensity", &PostProcessSettings.BloomIntensity, 0.f, 0.5f);
+                ImGui::SliderFloat("Bloom threshold", &Bloom.Threshold, 0.f, 4.f);
+                ImGui::SliderFloat("Bloom knee", &Bloom.Knee, 0.f, 1.f);
+                ImGui::SliderFloat("Bloom radius", &Bloom.Radius, 0.5f, 2.f);
+                ImGui::SliderInt("Bloom levels", &Bloom.LevelCount, 1, GL::bloom::MAX_LEVELS);
+                ImGui::Text("Bloom: %d levels, %d passes, GPU %.3f ms", Bloom.UsedLevelCount, Bloom.PassCount, BloomTimer.Time);
+            }
+            if (Effects & GL::POSTPROCESS_COLOR_MATRIX)
+            {
+                bool Changed = ImGui::Combo("Preset", &ColorPreset, "None\0Grayscale\0Sepia\0Inverse\0");
+                Changed |= ImGui::SliderFloat("Saturation", &Saturation, 0.f, 2.f);
+                Changed |= ImGui::SliderFloat("Contrast", &Contrast, 0.f, 2.f);
+                Changed |= ImGui::SliderFloat("Exposure", &Exposure, 0.f, 4.f);
+                if (Changed)
+                    this->UpdateColorMatrix();
+            }
+            if (Effects & GL::POSTPROCESS_VIGNETTE)
+            {
+                ImGui::SliderFloat("Vignette intensity", &PostProcessSettings.VignetteIntensity, 0.f, 1.f);
+                ImGui::SliderFloat("Vignette radius", &PostProcessSettings.VignetteRadius, 0.f, 0.99f);
+            }
+            if (Effects & GL::POSTPROCESS_GAMMA)
+                ImGui::DragFloat("Gamma", &PostProcessSettings.Gamma, 0.1f, 0.6f, 3.f);
+            if (Effects & GL::POSTPROCESS_GRAIN)
+                ImGui::SliderFloat("Grain intensity", &PostProcessSettings.GrainIntensity, 0.f, 0.3f);
+
+            ImGui::Text("1 pass, variant \"%s\" (%d compiled)", GL::uber_postprocess::BuildDefines(UberPostProcess.DrawnEffects).c_str(), UberPostProcess.GetVariantCount());
+            ImGui::TreePop();
+        }
+
+        this->DisplayGradingUI();
+
         if (ImGui::TreeNodeEx("Post processing"))
         {
-            ImGui::DragFloat("Processing offset", &PostProcessOffset, 0.001f);
-            ImGui::DragInt("Processing count", &PostProcessCount, 0.1f);
+            ImGui::Checkbox("Gaussian blur", &GaussianBlur);
+            if (GaussianBlur)
+            {
+                ImGui::SliderFloat("Sigma (pixels)", &BlurSigma, 0.f, 64.f);
+                ImGui::SliderFloat("Max separable sigma", &Blur.MaxSeparableSigma, 1.f, 10.f);
+                ImGui::SliderInt("Max pyramid levels", &Blur.MaxPyramidLevels, 1, 8);
+            }
+            else
+            {
+                ImGui::DragFloat("Processing offset", &PostProcessOffset, 0.001f);
+                ImGui::DragInt("Processing count", &PostProcessCount, 0.1f, 0, 100);
+
+                ImGui::Text("Kernels matrix");
+                ImGui::DragFloat3("0", Kernel.c[0].e);
+                ImGui::DragFloat3("1", Kernel.c[1].e);
+                ImGui::DragFloat3("2", Kernel.c[2].e);
+                ImGui::Text("Separable: %s", Blur.Separable ? "yes (1D passes)" : "no (3x3 passes)");
+            }
+
+            if (Blur.PyramidLevels > 0)
+                ImGui::Text("Dual Kawase pyramid: %d levels", Blur.PyramidLevels);
+            ImGui::Text("%d passes, %.1f taps per pixel, GPU %.3f ms", Blur.PassCount, Blur.TapsPerPixel, BlurTimer.Time);
 
-            ImGui::Text("Kernels matrix");
-            ImGui::DragFloat3("0", Kernel.c[0].e);
-            ImGui::DragFloat3("1", Kernel.c[1].e);
-            ImGui::DragFloat3("2", Kernel.c[2].e);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNodeEx("Render graph"))
+        {
+            const GL::render_target_pool& Pool = RenderGraph.GetPool();
+            ImGui::Text("Passes: %d executed, %d culled", RenderGraph.ExecutedPassCount, RenderGraph.CulledPassCount);
+            ImGui::Text("Transient targets: %d on %d textures", RenderGraph.TransientCount, RenderGraph.PhysicalTextureCount);
+            ImGui::Text("Pool (all demos): %d textures, %d framebuffers, %.1f MB", Pool.TextureCount, Pool.FramebufferCount, Pool.AllocatedBytes / (1024.0 * 1024.0));
 
             ImGui::TreePop();
         }
@@ -410,11 +420,9 @@ void demo_postprocess::DisplayDebugUI()
     }
 }
 
-void demo_postprocess::RenderTavernFBO(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
+// Framebuffer is bound by the graph
+void demo_postprocess::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
 {
-    glViewport(0, 0, RenderResolution, RenderResolution);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-
     // Clear screen
     glClearColor(0.f, 0.f, 0.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -422,18 +430,18 @@ void demo_postprocess::RenderTavernFBO(const mat4& ProjectionMatrix, const mat4&
     glEnable(GL_DEPTH_TEST);
 
     // Use shader and configure its uniforms
-    glUseProgram(TavernProgram);
+    GL::program& TavernProgram = *TavernRenderer.Program;
+    TavernProgram.Use();
 
     // Set uniforms
     mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(ModelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uProjection"), 1, GL_FALSE, ProjectionMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uModel"), 1, GL_FALSE, ModelMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uView"), 1, GL_FALSE, ViewMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uModelNormalMatrix"), 1, GL_FALSE, NormalMatrix.e);
-    glUniform3fv(glGetUniformLocation(TavernProgram, "uViewPosition"), 1, Camera.Position.e);
+    TavernProgram.SetMat4("uModel", ModelMatrix);
+    TavernProgram.SetMat4("uModelNormalMatrix", NormalMatrix);
+    TavernProgram.SetInt("uLightCount", TavernRenderer.CullLights(ProjectionMatrix * ViewMatrix, ModelMatrix));
     
-    // Bind uniform buffer and textures
-    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
+    // Upload view and bind uniform buffers and textures
+    FrameBlock.SetView(ProjectionMatrix, ViewMatrix);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernRenderer.CulledLightsUniformBuffer);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, TavernScene.DiffuseTexture);
     glActiveTexture(GL_TEXTURE1);
@@ -443,45 +451,218 @@ void demo_postprocess::RenderTavernFBO(const mat4& ProjectionMatrix, const mat4&
     // Draw mesh
     glBindVertexArray(TavernVAO);
     glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+}
+
+GL::render_graph::resource demo_postprocess::AddBlurPasses(GL::render_graph::resource Source, float PixelScale)
+{
+    RenderGraph.BeginTimer(BlurTimer);
+
+    // Sigma is given in window pixels, the kernel offset in UV (both independent of the source size)
+    GL::render_graph::resource Result;
+    if (GaussianBlur)
+        Result = Blur.Gaussian(RenderGraph, Source, BlurSigma * PixelScale);
+    else
+        Result = Blur.ApplyKernel(RenderGraph, Source, Kernel, PostProcessOffset, PostProcessCount);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderGraph.EndTimer(BlurTimer);
+    return Result;
 }
 
-void demo_postprocess::RenderPingPong(const int iteration)
+// Color matrix from the preset and the adjustments (linear space)
+void demo_postprocess::UpdateColorMatrix()
 {
-    glUseProgram(PostProcessProgram);
-    glUniform1f(glGetUniformLocation(PostProcessProgram, "uOffset"), PostProcessOffset);
-    glUniformMatrix3fv(glGetUniformLocation(PostProcessProgram, "uKernel"), 1, GL_FALSE, Kernel.e);
+    // Presets as row major 3x3 + offset
+    static const float Presets[4][12] = {
+        { 1.f, 0.f, 0.f,  0.f, 1.f, 0.f,  0.f, 0.f, 1.f,  0.f, 0.f, 0.f },
+        { 0.2126f, 0.7152f, 0.0722f,  0.2126f, 0.7152f, 0.0722f,  0.2126f, 0.7152f, 0.0722f,  0.f, 0.f, 0.f },
+        { 0.393f, 0.769f, 0.189f,  0.349f, 0.686f, 0.168f,  0.272f, 0.534f, 0.131f,  0.f, 0.f, 0.f },
+        { -1.f, 0.f, 0.f,  0.f, -1.f, 0.f,  0.f, 0.f, -1.f,  1.f, 1.f, 1.f },
+    };
+    const float* Preset = Presets[ColorPreset];
+    mat4 PresetMatrix = Mat4::Identity();
+    for (int Row = 0; Row < 3; ++Row)
+    {
+        for (int Column = 0; Column < 3; ++Column)
+            PresetMatrix.c[Column].e[Row] = Preset[Row * 3 + Column];
+        PresetMatrix.c[3].e[Row] = Preset[9 + Row];
+    }
 
-    for (int i = 0; i < iteration; ++i)
+    // Saturation: lerp from luminance, contrast: around mid grey (0.18 linear)
+    const v3 Luminance = { 0.2126f, 0.7152f, 0.0722f };
+    mat4 Adjust = Mat4::Identity();
+    for (int Row = 0; Row < 3; ++Row)
     {
-        glViewport(0, 0, RenderResolution, RenderResolution);
-        glBindFramebuffer(GL_FRAMEBUFFER, ppFBO[pp]);
+        for (int Column = 0; Column < 3; ++Column)
+        {
+            float Saturated = (1.f - Saturation) * Luminance.e[Column] + ((Row == Column) ? Saturation : 0.f);
+            Adjust.c[Column].e[Row] = Saturated * Contrast * Exposure;
+        }
+        Adjust.c[3].e[Row] = 0.18f * (1.f - Contrast);
+    }
 
-        // Clear screen
-        glClearColor(0.f, 0.f, 0.f, 1.f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    PostProcessSettings.ColorMatrix = Adjust * PresetMatrix;
+}
 
-        glBindVertexArray(RenderVAO);
-        glBindTexture(GL_TEXTURE_2D, i == 0 ? RawRenderTex : ppRenderTex[!pp]);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+void demo_postprocess::BakeGradingLUT()
+{
+    std::vector<v3> Texels;
+    auto Start = std::chrono::high_resolution_clock::now();
+    GL::BakeColorLUT(GradingChain, GradingLUTSize, &Texels);
+    GradingBakeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+    GradingLUT = GL::UploadLUTTexture(GradingLUTSize, Texels, GradingLUT);
+    GradingSource = "chain";
+    PostProcessSettings.LUTTexture = GradingLUT;
+    PostProcessSettings.LUTSize = GradingLUTSize;
+}
 
-        pp = !pp;
+void demo_postprocess::DisplayGradingUI()
+{
+    if (!ImGui::TreeNodeEx("Color grading (3D LUT)"))
+        return;
+
+    static const char* OperationNames[] = { "Matrix", "HSL", "Curves" };
+    static const char* CurveNames[] = { "Master", "Red", "Green", "Blue" };
+
+    bool Changed = false;
+    int RemovedOperation = -1;
+    for (int i = 0; i < (int)GradingChain.size(); ++i)
+    {
+        GL::color_operation& Operation = GradingChain[i];
+        ImGui::PushID(i);
+        bool Open = ImGui::TreeNodeEx("Operation", ImGuiTreeNodeFlags_DefaultOpen, "%d. %s", i + 1, OperationNames[Operation.Type]);
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Remove"))
+            RemovedOperation = i;
+
+        if (Open)
+        {
+            switch (Operation.Type)
+            {
+            case GL::color_operation::MATRIX:
+                // Rows (rgb weights + offset)
+                for (int Row = 0; Row < 3; ++Row)
+                {
+                    float Values[4] = { Operation.Matrix.c[0].e[Row], Operation.Matrix.c[1].e[Row], Operation.Matrix.c[2].e[Row], Operation.Matrix.c[3].e[Row] };
+                    ImGui::PushID(Row);
+                    if (ImGui::DragFloat4(CurveNames[1 + Row], Values, 0.01f))
+                    {
+                        for (int Column = 0; Column < 4; ++Column)
+                            Operation.Matrix.c[Column].e[Row] = Values[Column];
+                        Changed = true;
+                    }
+                    ImGui::PopID();
+                }
+                break;
+
+            case GL::color_operation::HSL:
+                Changed |= ImGui::SliderFloat("Hue shift", &Operation.HueShift, -180.f, 180.f);
+                Changed |= ImGui::SliderFloat("Saturation", &Operation.Saturation, 0.f, 2.f);
+                Changed |= ImGui::SliderFloat("Lightness", &Operation.Lightness, -0.5f, 0.5f);
+                break;
+
+            case GL::color_operation::CURVES:
+                for (int Curve = 0; Curve < 4; ++Curve)
+                {
+                    std::vector<v2>& Points = Operation.Curves[Curve];
+                    ImGui::PushID(Curve);
+                    ImGui::Text("%s (%d points)", CurveNames[Curve], (int)Points.size());
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton("+"))
+                    {
+                        if (Points.empty())
+                            Points = { { 0.f, 0.f }, { 1.f, 1.f } };
+                        else
+                            Points.insert(Points.end() - 1, { 0.5f * (Points[Points.size() - 2].x + Points.back().x), 0.5f * (Points[Points.size() - 2].y + Points.back().y) });
+                        Changed = true;
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton("Reset"))
+                    {
+                        Points.clear();
+                        Changed = true;
+                    }
+                    for (int p = 0; p < (int)Points.size(); ++p)
+                    {
+                        ImGui::PushID(p);
+                        if (ImGui::SliderFloat2("", Points[p].e, 0.f, 1.f))
+                        {
+                            // Keep the points sorted
+                            float MinX = (p > 0) ? Points[p - 1].x : 0.f;
+                            float MaxX = (p + 1 < (int)Points.size()) ? Points[p + 1].x : 1.f;
+                            Points[p].x = Math::Clamp(Points[p].x, MinX, MaxX);
+                            Changed = true;
+                        }
+                        ImGui::PopID();
+                    }
+                    ImGui::PopID();
+                }
+                break;
+            }
+            ImGui::TreePop();
+        }
+        ImGui::PopID();
+    }
+
+    if (RemovedOperation != -1)
+    {
+        GradingChain.erase(GradingChain.begin() + RemovedOperation);
+        Changed = true;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (int Type = 0; Type < 3; ++Type)
+    {
+        if (Type > 0)
+            ImGui::SameLine();
+        if (ImGui::Button((std::string("Add ") + OperationNames[Type]).c_str()))
+        {
+            GL::color_operation Operation;
+            Operation.Type = (GL::color_operation::type)Type;
+            GradingChain.push_back(Operation);
+            Changed = true;
+        }
+    }
+
+    Changed |= ImGui::SliderInt("LUT size", &GradingLUTSize, 2, 64);
+    if (Changed)
+        this->BakeGradingLUT();
+
+    ImGui::InputText("File", CubeFilename, sizeof(CubeFilename));
+    if (ImGui::Button("Load .cube"))
+    {
+        int Size;
+        std::vector<v3> Texels;
+        std::string Title;
+        if (GL::LoadCubeLUT(CubeFilename, &Size, &Texels, &Title))
+        {
+            GradingLUT = GL::UploadLUTTexture(Size, Texels, GradingLUT);
+            GradingSource = Title.empty() ? CubeFilename : Title;
+            PostProcessSettings.LUTTexture = GradingLUT;
+            PostProcessSettings.LUTSize = Size;
+            PostProcessSettings.Effects |= GL::POSTPROCESS_LUT;
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Save chain as .cube"))
+    {
+        std::vector<v3> Texels;
+        GL::BakeColorLUT(GradingChain, GradingLUTSize, &Texels);
+        GL::SaveCubeLUT(CubeFilename, GradingLUTSize, Texels, "ibr2022 grading chain");
+    }
+
+    ImGui::Text("LUT: %s, %d^3, baked in %.2f ms", GradingSource.c_str(), PostProcessSettings.LUTSize, GradingBakeTime);
+    if (!(PostProcessSettings.Effects & GL::POSTPROCESS_LUT))
+        ImGui::TextDisabled("Enable the LUT screen effect to apply it");
+
+    ImGui::TreePop();
 }
 
-void demo_postprocess::RenderScreen()
+void demo_postprocess::RenderScreen(GLuint Texture, GLuint BloomTexture, float Time)
 {
     // Clear screen
     glClearColor(0.f, 0.f, 0.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glUseProgram(RenderProgram);
-    glUniform1f(glGetUniformLocation(RenderProgram, "uGamma"), Gamma);
-
-    glBindVertexArray(RenderVAO);
-    //is postprocessing active ?
-    glBindTexture(GL_TEXTURE_2D, PostProcessCount > 0 ? ppRenderTex[!pp] : RawRenderTex);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-}
\ No newline at end of file
+    PostProcessSettings.BloomTexture = BloomTexture;
+    UberPostProcess.Draw(Texture, PostProcessSettings, Time);
+}
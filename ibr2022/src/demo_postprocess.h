@@ -1,14 +1,23 @@
 #pragma once
 
 #include <array>
+#include <string>
+#include <vector>
 
 #include "demo.h"
 
 #include "opengl_headers.h"
+#include "opengl_helpers_blur.h"
+#include "opengl_helpers_postprocess.h"
+#include "opengl_helpers_color_grading.h"
+#include "opengl_helpers_bloom.h"
+#include "opengl_helpers_taa.h"
+#include "opengl_helpers_upscaler.h"
 
 #include "camera.h"
 
 #include "tavern_scene.h"
+#include "tavern_renderer.h"
 
 class demo_postprocess : public demo
 {
@@ -17,10 +26,15 @@ public:
     virtual ~demo_postprocess();
     virtual void Update(const platform_io& IO);
 
-    void RenderTavernFBO(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
-    void RenderPingPong(const int iteration);
+    void UpdateRenderScale();
 
-    void RenderScreen();
+    void RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
+    GL::render_graph::resource AddBlurPasses(GL::render_graph::resource Source, float PixelScale);
+
+    void UpdateColorMatrix();
+    void BakeGradingLUT();
+    void DisplayGradingUI();
+    void RenderScreen(GLuint Texture, GLuint BloomTexture, float Time);
 
     void DisplayDebugUI();
 
@@ -31,28 +45,73 @@ private:
     camera Camera = {};
 
     // GL objects needed by the tavern
-    GLuint TavernProgram = 0;
-    GLuint TavernVAO = 0;
+    GLuint TavernVAO = 0; // (program is owned by TavernRenderer)
+    GL::frame_block FrameBlock;
 
     tavern_scene TavernScene;
+    tavern_renderer TavernRenderer;
 
     bool Wireframe = false;
 
-    GLuint RenderVAO = 0;
-    GLuint RenderProgram = 0;
-
-    GLuint FBO = 0;
-    GLuint RawRenderTex = 0;
-    GLuint RenderDepthMap = 0;
-    unsigned int RenderResolution = 1024;
-
-    //ping pong framebuffers
-    bool pp = false;
-    GLuint PostProcessProgram = 0;
-    GLuint ppFBO[2];
-    GLuint ppRenderTex[2];
-
-    float Gamma = 2.2f;
+    // Per-pixel effects fused in the screen pass
+    GL::uber_postprocess UberPostProcess;
+    GL::postprocess_settings PostProcessSettings;
+    int ColorPreset = 0; // None, grayscale, sepia, inverse
+    float Saturation = 1.f;
+    float Contrast = 1.f;
+    float Exposure = 1.f;
+
+    // Color grading chain baked into a 3D LUT (or loaded from a .cube file), applied by the LUT effect
+    std::vector<GL::color_operation> GradingChain;
+    GLuint GradingLUT = 0;
+    int GradingLUTSize = 32;
+    std::string GradingSource = "chain"; // Chain or .cube title
+    double GradingBakeTime = 0.0; // ms
+    char CubeFilename[256] = "media/grade.cube";
+
+    // Scene and post-processing targets are transient resources of the graph (pooled by GLCache.RenderTargets)
+    GL::render_graph RenderGraph;
+    int RenderWidth = 0;  // Window size * RenderScale (0 until the first frame)
+    int RenderHeight = 0;
+
+    // Temporal AA, in upsample mode the scene is rendered at UpsampleScale and reconstructed at window resolution
+    enum taa_mode { TAA_OFF, TAA_AA, TAA_UPSAMPLE };
+    int TAAMode = TAA_OFF;
+    float UpsampleScale = 0.6f; // Render scale without dynamic resolution
+    GL::taa TAA;
+    GL::pass_timer TAATimer;
+
+    // Spatial upscaling (EASU + RCAS) after the screen effects when the scene is smaller than the window
+    bool SpatialUpscale = false;
+    float SpatialUpscaleScale = 0.67f; // Render scale without dynamic resolution
+    GL::spatial_upscaler Upscaler;
+    GL::pass_timer UpscaleTimer;
+    int UpscaleInputWidth = 0; // 0 when the upscaler did not run last frame
+    int UpscaleInputHeight = 0;
+
+    // Dynamic resolution: RenderScale follows the GPU frame time to stay around TargetFrameTime
+    // The render targets are upscaled (bilinear) when drawn to the screen
+    bool DynamicResolution = true;
+    float TargetFrameTime = 8.f; // ms
+    float RenderScale = 1.f;
+    float MinRenderScale = 0.5f;
+    float RenderScaleStep = 0.05f; // Scale changes by steps (each size gets its own pooled targets)
+    int RenderScaleCooldown = 0;   // Frames before the next change (measures lag behind)
+    static const int FRAME_QUERY_COUNT = 3;
+    GLuint FrameTimerQueries[FRAME_QUERY_COUNT][2] = {}; // Timestamps at the start and end of the frame
+    bool FrameTimerQueryPending[FRAME_QUERY_COUNT] = {};
+    int FrameQueryIndex = 0;
+    double GPUFrameTime = 0.0; // ms, smoothed
+
+    // Blur (kernel applied PostProcessCount times, or gaussian)
+    GL::blur Blur;
+    bool GaussianBlur = false;
+    float BlurSigma = 2.f; // Pixels
+    GL::pass_timer BlurTimer;
+
+    // Bloom, enabled with the bloom screen effect
+    GL::bloom Bloom;
+    GL::pass_timer BloomTimer;
 
     mat3 Kernel;
     int PostProcessCount = 1;
@@ -1,4 +1,6 @@
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include <imgui.h>
@@ -14,6 +16,19 @@
 
 const int LIGHT_BLOCK_BINDING_POINT = 0;
 
+const float CAMERA_FOVY = Math::ToRadians(60.f);
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.f;
+
+// Point shadows
+const int POINT_SHADOW_RESOLUTIONS[3] = { 128, 256, 512 };
+const float POINT_SHADOW_NEAR = 0.05f;
+const float POINT_SHADOW_MAX_RANGE = 10.f;
+
+// Cube face directions and up vectors (+X, -X, +Y, -Y, +Z, -Z)
+static const v3 gCubeFaceDirections[6] = { { 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f } };
+static const v3 gCubeFaceUps[6]        = { { 0.f, 1.f, 0.f }, {  0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f,  0.f, 1.f }, { 0.f, 1.f, 0.f }, { 0.f, 1.f,  0.f } };
+
 struct vertex
 {
     v3 Position;
@@ -28,18 +43,15 @@ layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec2 aUV;
 layout(location = 2) in vec3 aNormal;
 
-// Uniforms
-uniform mat4 uProjection;
+// Uniforms (view/projection from uFrame)
 uniform mat4 uModel;
-uniform mat4 uView;
 uniform mat4 uModelNormalMatrix;
-uniform mat4 uLightSpaceMatrix;
 
 // Varyings
 out vec2 vUV;
-out vec3 vPos;    // Vertex position in view-space
-out vec3 vNormal; // Vertex normal in view-space
-out vec4 vLightSpace;
+out vec3 vPos;    // Vertex position in world-space
+out vec3 vNormal; // Vertex normal in world-space
+out float vViewDepth;
 
 void main()
 {
@@ -47,9 +59,9 @@ void main()
     vec4 pos4 = (uModel * vec4(aPosition, 1.0));
     vPos = pos4.xyz / pos4.w;
     vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
-    vLightSpace = uLightSpaceMatrix * pos4;
+    vViewDepth = -(uFrame.view * pos4).z;
 
-    gl_Position = uProjection * uView * pos4;
+    gl_Position = uFrame.viewProj * pos4;
 })GLSL";
 
 static const char* gFragmentShaderStr = R"GLSL(
@@ -57,15 +69,24 @@ static const char* gFragmentShaderStr = R"GLSL(
 in vec2 vUV;
 in vec3 vPos;
 in vec3 vNormal;
-in vec4 vLightSpace;
+in float vViewDepth;
 
 // Uniforms
-uniform mat4 uProjection;
-uniform vec3 uViewPosition;
-
-uniform sampler2D uDiffuseTexture;
-uniform sampler2D uEmissiveTexture;
-uniform sampler2D uShadowMap;
+uniform sampler2D uDiffuseTexture;  // Alpha: emissive intensity (PACKED_EMISSIVE)
+uniform sampler2D uEmissiveTexture; // Emissive tint map (PACKED_EMISSIVE_TINT_TEXTURE)
+uniform vec3 uEmissiveTint;
+uniform sampler2DArray uShadowMap;            // One layer per cascade
+uniform sampler2DArrayShadow uShadowMapCompare; // Same texture, comparison sampler
+uniform sampler2DArray uShadowMoments;        // VSM: (depth, depth^2), ESM: exp(c * depth)
+uniform int uShadowFilter;                    // See demo_shadowmap::shadow_filter
+uniform float uESMExponent;
+uniform mat4 uCascadeMatrices[CASCADE_COUNT];
+uniform float uCascadeSplits[CASCADE_COUNT];  // Far view depth of each cascade
+uniform bool uShowCascades;
+uniform sampler2D uPointShadowAtlas;                          // 6 faces per shadowed point light
+uniform mat4 uPointShadowMatrices[MAX_POINT_SHADOWS * 6];
+uniform vec4 uPointShadowTiles[MAX_POINT_SHADOWS * 6];        // Atlas rect of each face (xy: offset, zw: size)
+uniform int uPointShadowSlots[LIGHT_COUNT];                   // -1: light without point shadow
 
 // Uniform blocks
 layout(std140) uniform uLightBlock
@@ -76,21 +97,42 @@ layout(std140) uniform uLightBlock
 // Shader outputs
 out vec4 oColor;
 
-light_shade_result get_lights_shading()
+float point_shadow(int slot, vec3 lightPosition);
+
+// Light 0 (sun) is shadowed by the cascades, other lights by their point shadow if they have one
+light_shade_result get_lights_shading(float sunShadow)
 {
     light_shade_result lightResult = light_shade_result(vec3(0.0), vec3(0.0), vec3(0.0));
 	for (int i = 0; i < LIGHT_COUNT; ++i)
     {
-        light_shade_result light = light_shade(uLight[i], gDefaultMaterial.shininess, uViewPosition, vPos, normalize(vNormal));
+        light_shade_result light = light_shade(uLight[i], gDefaultMaterial.shininess, uFrame.viewPosition.xyz, vPos, normalize(vNormal));
+        float shadow = 1.0;
+        if (i == 0)
+            shadow = sunShadow;
+        else if (uPointShadowSlots[i] >= 0 && light.diffuse + light.specular != vec3(0.0))
+            shadow = point_shadow(uPointShadowSlots[i], uLight[i].position.xyz / uLight[i].position.w);
+
         lightResult.ambient  += light.ambient;
-        lightResult.diffuse  += light.diffuse;
-        lightResult.specular += light.specular;
+        lightResult.diffuse  += shadow * light.diffuse;
+        lightResult.specular += shadow * light.specular;
     }
     return lightResult;
 }
 
-float enlighten(vec4 lightSpace, float bias)
+vec3 get_emissive(vec4 diffuseTexel)
+{
+#if defined(PACKED_EMISSIVE_TINT_TEXTURE)
+    return diffuseTexel.a * texture(uEmissiveTexture, vUV).rgb;
+#elif defined(PACKED_EMISSIVE)
+    return diffuseTexel.a * uEmissiveTint;
+#else
+    return texture(uEmissiveTexture, vUV).rgb;
+#endif
+}
+
+float sample_cascade(int cascade, float bias)
 {
+    vec4 lightSpace = uCascadeMatrices[cascade] * vec4(vPos, 1.0);
     vec3 perspective = lightSpace.xyz / lightSpace.w;
     perspective = perspective * 0.5 + 0.5;
 
@@ -99,35 +141,129 @@ float enlighten(vec4 lightSpace, float bias)
     if (currentDepth > 1.0)
         return 1.0;
 
+    if (uShadowFilter == SHADOW_FILTER_VSM)
+    {
+        // Chebyshev upper bound, the low end is cut to reduce light bleeding
+        vec2 moments = texture(uShadowMoments, vec3(perspective.xy, cascade)).rg;
+        if (currentDepth - bias <= moments.x)
+            return 1.0;
+        float variance = max(moments.y - moments.x * moments.x, 0.00002);
+        float d = currentDepth - moments.x;
+        float pMax = variance / (variance + d * d);
+        return clamp((pMax - 0.3) / 0.7, 0.0, 1.0);
+    }
+    else if (uShadowFilter == SHADOW_FILTER_ESM)
+    {
+        float occluder = texture(uShadowMoments, vec3(perspective.xy, cascade)).r;
+        return clamp(occluder * exp(-uESMExponent * (currentDepth - bias)), 0.0, 1.0);
+    }
+
     // is the fragment lit ?
     float lit = 0.0;
-    vec2 texelSize = 1.0 / textureSize(uShadowMap, 0);
+    vec2 texelSize = 1.0 / textureSize(uShadowMap, 0).xy;
     for (int i = -1; i <= 1; ++i)
     {
         for (int j = -1; j <= 1; ++j)
         {
-            float pcfDepth = texture(uShadowMap, perspective.xy + vec2(i, j) * texelSize).r;
-            lit += currentDepth - bias > pcfDepth ? 0.0 : 1.0;
+            vec2 uv = perspective.xy + vec2(i, j) * texelSize;
+            if (uShadowFilter == SHADOW_FILTER_HARDWARE_PCF)
+            {
+                lit += texture(uShadowMapCompare, vec4(uv, cascade, currentDepth - bias));
+            }
+            else
+            {
+                float pcfDepth = texture(uShadowMap, vec3(uv, cascade)).r;
+                lit += currentDepth - bias > pcfDepth ? 0.0 : 1.0;
+            }
         }
     }
 
     return lit / 9.0;
 }
 
+float point_shadow(int slot, vec3 lightPosition)
+{
+    // Cube face from the major axis (+X, -X, +Y, -Y, +Z, -Z), the position is offset along the normal against acne
+    vec3 position = vPos + normalize(vNormal) * 0.02;
+    vec3 d = position - lightPosition;
+    vec3 a = abs(d);
+    int face = (a.x >= a.y && a.x >= a.z) ? (d.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (d.y > 0.0 ? 2 : 3) : (d.z > 0.0 ? 4 : 5));
+    int index = slot * 6 + face;
+
+    vec4 clip = uPointShadowMatrices[index] * vec4(position, 1.0);
+    vec3 perspective = clip.xyz / clip.w * 0.5 + 0.5;
+    if (perspective.z > 1.0)
+        return 1.0;
+
+    // 3x3 PCF, taps are clamped inside the face tile
+    vec4 tile = uPointShadowTiles[index];
+    vec2 texelSize = 1.0 / textureSize(uPointShadowAtlas, 0);
+    vec2 tileMin = tile.xy + 0.5 * texelSize;
+    vec2 tileMax = tile.xy + tile.zw - 0.5 * texelSize;
+    vec2 uv = tile.xy + perspective.xy * tile.zw;
+    float lit = 0.0;
+    for (int i = -1; i <= 1; ++i)
+    {
+        for (int j = -1; j <= 1; ++j)
+        {
+            float pcfDepth = texture(uPointShadowAtlas, clamp(uv + vec2(i, j) * texelSize, tileMin, tileMax)).r;
+            lit += perspective.z - 0.0005 > pcfDepth ? 0.0 : 1.0;
+        }
+    }
+    return lit / 9.0;
+}
+
+int get_cascade()
+{
+    for (int i = 0; i < CASCADE_COUNT; ++i)
+    {
+        if (vViewDepth < uCascadeSplits[i])
+            return i;
+    }
+    return CASCADE_COUNT;
+}
+
+float enlighten(int cascade, float bias)
+{
+    // Beyond shadow distance
+    if (cascade == CASCADE_COUNT)
+        return 1.0;
+
+    float lit = sample_cascade(cascade, bias);
+
+    // Blend with the next cascade over the last 10% of the cascade range
+    float cascadeStart = cascade == 0 ? 0.0 : uCascadeSplits[cascade - 1];
+    float blend = (uCascadeSplits[cascade] - vViewDepth) / (0.1 * (uCascadeSplits[cascade] - cascadeStart));
+    if (blend < 1.0)
+    {
+        float nextLit = cascade + 1 < CASCADE_COUNT ? sample_cascade(cascade + 1, bias) : 1.0;
+        lit = mix(nextLit, lit, blend);
+    }
+    return lit;
+}
+
 void main()
 {
+    int cascade = get_cascade();
+    float sunShadow = enlighten(cascade, 0.002);
+
     // Compute phong shading
-    light_shade_result lightResult = get_lights_shading();
+    light_shade_result lightResult = get_lights_shading(sunShadow);
+    vec4 diffuseTexel = texture(uDiffuseTexture, vUV);
     
-    vec3 diffuseColor  = gDefaultMaterial.diffuse * lightResult.diffuse * texture(uDiffuseTexture, vUV).rgb;
-    vec3 ambientColor  = gDefaultMaterial.ambient * lightResult.ambient * texture(uDiffuseTexture, vUV).rgb;
+    vec3 diffuseColor  = gDefaultMaterial.diffuse * lightResult.diffuse * diffuseTexel.rgb;
+    vec3 ambientColor  = gDefaultMaterial.ambient * lightResult.ambient * diffuseTexel.rgb;
     vec3 specularColor = gDefaultMaterial.specular * lightResult.specular;
-    vec3 emissiveColor = gDefaultMaterial.emission + texture(uEmissiveTexture, vUV).rgb;
-
-    float shadow = enlighten(vLightSpace, 0.005);
+    vec3 emissiveColor = gDefaultMaterial.emission + get_emissive(diffuseTexel);
     
     // Apply light color
-    oColor = vec4((ambientColor + shadow * (diffuseColor + specularColor) + emissiveColor), 1.0);
+    oColor = vec4((ambientColor + diffuseColor + specularColor + emissiveColor), 1.0);
+
+    if (uShowCascades && cascade < CASCADE_COUNT)
+    {
+        const vec3 cascadeColors[4] = vec3[4](vec3(1.0, 0.2, 0.2), vec3(0.2, 1.0, 0.2), vec3(0.2, 0.2, 1.0), vec3(1.0, 1.0, 0.2));
+        oColor.rgb *= cascadeColors[cascade % 4];
+    }
 })GLSL";
 #pragma endregion tavern
 
@@ -152,6 +288,56 @@ void main()
 )GLSL";
 #pragma endregion depth_map_shader
 
+// shaders used to build the VSM/ESM moments (vertex shader is gVertexRenderShaderStr)
+#pragma region moments_shader
+static const char* gFragmentMomentsShaderStr = R"GLSL(
+in vec2 vTex;
+
+uniform sampler2DArray uDepthMap;
+uniform int uLayer;
+uniform bool uExponential;
+uniform float uESMExponent;
+
+out vec2 oMoments;
+
+void main()
+{
+    // 2x2 downsample
+    vec2 texelSize = 1.0 / textureSize(uDepthMap, 0).xy;
+    vec2 moments = vec2(0.0);
+    for (int i = 0; i < 4; ++i)
+    {
+        float depth = texture(uDepthMap, vec3(vTex + (vec2(i & 1, i >> 1) - 0.5) * texelSize, uLayer)).r;
+        moments += uExponential ? vec2(exp(uESMExponent * depth), 0.0) : vec2(depth, depth * depth);
+    }
+    oMoments = moments * 0.25;
+}
+)GLSL";
+
+static const char* gFragmentBlurShaderStr = R"GLSL(
+in vec2 vTex;
+
+uniform sampler2D uSource;
+uniform vec3 uDirection; // One texel along the blur axis (xy)
+
+out vec2 oMoments;
+
+const float weights[5] = float[5](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+
+void main()
+{
+    // 9 taps gaussian
+    vec2 result = texture(uSource, vTex).rg * weights[0];
+    for (int i = 1; i < 5; ++i)
+    {
+        result += texture(uSource, vTex + uDirection.xy * float(i)).rg * weights[i];
+        result += texture(uSource, vTex - uDirection.xy * float(i)).rg * weights[i];
+    }
+    oMoments = result;
+}
+)GLSL";
+#pragma endregion moments_shader
+
 // shader used to render a texture on a quad, a screen
 #pragma region render_shader
 static const char* gVertexRenderShaderStr = R"GLSL(
@@ -172,32 +358,35 @@ out vec4 oColor;
 
 in vec2 vTex;
 
-uniform sampler2D renderTex;
+uniform sampler2DArray renderTex;
+uniform int uLayer;
 
 void main()
 {
-    float r = texture(renderTex, vTex).r;
+    float r = texture(renderTex, vec3(vTex, uLayer)).r;
     oColor = vec4(vec3(r), 1.0);
 }
 )GLSL";
 #pragma endregion render_shader
 
 demo_shadowmap::demo_shadowmap(GL::cache& GLCache, GL::debug& GLDebug)
-    : GLDebug(GLDebug), TavernScene(GLCache)
+    : GLCache(GLCache), GLDebug(GLDebug), TavernScene(GLCache), TavernRenderer(GLCache, TavernScene)
 {
     // Create shader
     {
-        // Assemble fragment shader strings (defines + code)
-        char FragmentShaderConfig[] = "#define LIGHT_COUNT %d\n";
-        snprintf(FragmentShaderConfig, ARRAY_SIZE(FragmentShaderConfig), "#define LIGHT_COUNT %d\n", TavernScene.LightCount);
-        const char* FragmentShaderStrs[2] = {
-            FragmentShaderConfig,
-            gFragmentShaderStr,
-        };
-
-        this->TavernProgram = GL::CreateProgramEx(1, &gVertexShaderStr, 2, FragmentShaderStrs, true);
-        this->DepthProgram = GL::CreateProgramEx(1, &gVertexDepthShaderStr, 1, &gFragmentDepthShaderStr, true);
-        this->RenderProgram = GL::CreateProgramEx(1, &gVertexRenderShaderStr, 1, &gFragmentRenderShaderStr, true);
+        char CascadeDefine[256];
+        snprintf(CascadeDefine, ARRAY_SIZE(CascadeDefine),
+            "#define CASCADE_COUNT %d\n#define MAX_POINT_SHADOWS %d\n"
+            "#define SHADOW_FILTER_HARDWARE_PCF %d\n#define SHADOW_FILTER_VSM %d\n#define SHADOW_FILTER_ESM %d\n",
+            CASCADE_COUNT, MAX_POINT_SHADOWS, SHADOW_FILTER_HARDWARE_PCF, SHADOW_FILTER_VSM, SHADOW_FILTER_ESM);
+
+        // Programs shared through GLCache (defines + code)
+        std::string TavernDefines = CascadeDefine + TavernRenderer.ProgramDefines;
+        this->TavernProgram = GLCache.LoadProgram(gVertexShaderStr, gFragmentShaderStr, TavernDefines.c_str(), true);
+        this->DepthProgram = GLCache.LoadProgram(gVertexDepthShaderStr, gFragmentDepthShaderStr, "", true);
+        this->RenderProgram = GLCache.LoadProgram(gVertexRenderShaderStr, gFragmentRenderShaderStr, "", true);
+        this->MomentsProgram = GLCache.LoadProgram(gVertexRenderShaderStr, gFragmentMomentsShaderStr);
+        this->BlurProgram = GLCache.LoadProgram(gVertexRenderShaderStr, gFragmentBlurShaderStr);
     }
 
     // Create a vertex array and bind attribs onto the vertex buffer
@@ -216,36 +405,44 @@ demo_shadowmap::demo_shadowmap(GL::cache& GLCache, GL::debug& GLDebug)
         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
     }
 
-    // Set uniforms that won't change
-    {
-        glUseProgram(TavernProgram);
-        glUniform1i(glGetUniformLocation(TavernProgram, "uDiffuseTexture"), 0);
-        glUniform1i(glGetUniformLocation(TavernProgram, "uEmissiveTexture"), 1);
-        glUniform1i(glGetUniformLocation(TavernProgram, "uShadowMap"), 2);
-        glUniformBlockBinding(TavernProgram, glGetUniformBlockIndex(TavernProgram, "uLightBlock"), LIGHT_BLOCK_BINDING_POINT);
-    }
-
     // Initialize depth frame buffer
     {
         glGenFramebuffers(1, &DepthFBO);
 
         glGenTextures(1, &DepthMap);
-        glBindTexture(GL_TEXTURE_2D, DepthMap);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-            DepthMapResolution, DepthMapResolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-        // attaching texture to the framebuffer's depth buffer department
+        glBindTexture(GL_TEXTURE_2D_ARRAY, DepthMap);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT,
+            DepthMapResolution, DepthMapResolution, CASCADE_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // attaching the first layer to the framebuffer's depth buffer department (each cascade attaches its own layer)
         glBindFramebuffer(GL_FRAMEBUFFER, DepthFBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, DepthMap, 0);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, DepthMap, 0, 0);
         glDrawBuffer(GL_NONE);
         glReadBuffer(GL_NONE);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
+    // Comparison sampler (hardware PCF) and VSM/ESM maps
+    {
+        glGenSamplers(1, &CompareSampler);
+        glSamplerParameteri(CompareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(CompareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glSamplerParameteri(CompareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(CompareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(CompareSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(CompareSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        this->CreateMomentsMaps();
+        glGenQueries(ARRAY_SIZE(TimerQueries), TimerQueries);
+    }
+
+    // Point shadow atlas
+    this->CreatePointShadowAtlas();
+
     // Initialize quad for frame buffer's rendering
     {
         // Create a cube in RAM
@@ -283,9 +480,19 @@ demo_shadowmap::~demo_shadowmap()
     glDeleteVertexArrays(1, &TavernVAO);
     glDeleteVertexArrays(1, &RenderVAO);
     glDeleteFramebuffers(1, &DepthFBO);
-    glDeleteProgram(TavernProgram);
-    glDeleteProgram(DepthProgram);
-    glDeleteProgram(RenderProgram);
+    glDeleteTextures(1, &DepthMap);
+    glDeleteFramebuffers(1, &PointShadowFBO);
+    glDeleteTextures(1, &PointShadowAtlas);
+    glDeleteSamplers(1, &CompareSampler);
+    glDeleteFramebuffers(1, &MomentsFBO);
+    glDeleteTextures(1, &MomentsMap);
+    glDeleteTextures(2, MomentsTempTextures);
+    glDeleteQueries(ARRAY_SIZE(TimerQueries), TimerQueries);
+    GLCache.ReleaseProgram(TavernProgram);
+    GLCache.ReleaseProgram(DepthProgram);
+    GLCache.ReleaseProgram(RenderProgram);
+    GLCache.ReleaseProgram(MomentsProgram);
+    GLCache.ReleaseProgram(BlurProgram);
 }
 
 void demo_shadowmap::Update(const platform_io& IO)
@@ -293,29 +500,78 @@ void demo_shadowmap::Update(const platform_io& IO)
     const float AspectRatio = (float)IO.WindowWidth / (float)IO.WindowHeight;
 
     Camera = CameraUpdateFreefly(Camera, IO.CameraInputs);
+    FrameBlock.SetTime(IO.Time, IO.DeltaTime);
 
     // Clear screen
     glClearColor(0.f, 0.f, 0.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    mat4 ProjectionMatrix = Mat4::Perspective(Math::ToRadians(60.f), AspectRatio, 0.1f, 100.f);
+    // Shaders are compiled in background, only clear the screen until the tavern shader is linked
+    if (!TavernProgram->IsReady())
+    {
+        this->DisplayDebugUI();
+        return;
+    }
+
+    mat4 ProjectionMatrix = Mat4::Perspective(CAMERA_FOVY, AspectRatio, CAMERA_NEAR, CAMERA_FAR);
     mat4 ViewMatrix = CameraGetInverseMatrix(Camera);
     mat4 ModelMatrix = Mat4::Translate({ 0.f, 0.f, 0.f });
 
-    v3 LightPos = TavernScene.GetLightPositionFromIndex(0);
-    mat4 LightProjectionMatrix = Mat4::Orthographic(-LightRange, LightRange, -LightRange, LightRange, -LightRange, LightRange);
-    mat4 LightViewMatrix = Mat4::LookAt(LightPos, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
-    mat4 LightSpaceMatrix = LightProjectionMatrix * LightViewMatrix;
+    // Sun is a directional light (position is its direction)
+    v3 LightDirection = Vec3::Normalize(TavernScene.GetLightPositionFromIndex(0));
+    this->UpdateCascades(ViewMatrix, AspectRatio, LightDirection);
 
-    // Render depth map into a frame buffer
-    this->RenderTavernDepthMap(ModelMatrix, LightSpaceMatrix);
+    // Read back the timings of the previous frames when available (queries 0: shadow passes, 1: tavern pass, 2: point shadows)
+    for (int i = 0; i < (int)ARRAY_SIZE(TimerQueries); ++i)
+    {
+        GLint Available = 0;
+        if (TimerQueryPending[i])
+            glGetQueryObjectiv(TimerQueries[i], GL_QUERY_RESULT_AVAILABLE, &Available);
+        if (Available)
+        {
+            GLuint64 Elapsed = 0;
+            glGetQueryObjectui64v(TimerQueries[i], GL_QUERY_RESULT, &Elapsed);
+            if (i == 2)
+                PointShadowTime = Elapsed / 1000000.0;
+            else
+                ((i == 0) ? ShadowPassTimes : LookupTimes)[TimerQueryFilters[i]] = Elapsed / 1000000.0;
+            TimerQueryPending[i] = false;
+        }
+    }
+    bool StartQueries = !TimerQueryPending[0] && !TimerQueryPending[1] && !TimerQueryPending[2];
+
+    // Render depth maps into a frame buffer
+    if (StartQueries)
+        glBeginQuery(GL_TIME_ELAPSED, TimerQueries[0]);
+    this->RenderTavernDepthMap(ModelMatrix);
+    this->PrefilterCascades();
+    if (StartQueries)
+        glEndQuery(GL_TIME_ELAPSED);
+
+    // Point shadows (timed apart, the face budget does not depend on the cascade filter)
+    if (StartQueries)
+        glBeginQuery(GL_TIME_ELAPSED, TimerQueries[2]);
+    this->UpdatePointShadows(ModelMatrix);
+    if (StartQueries)
+        glEndQuery(GL_TIME_ELAPSED);
 
     // Render tavern
     glViewport(0, 0, IO.WindowWidth, IO.WindowHeight);
-    this->RenderTavern(ProjectionMatrix, ViewMatrix, ModelMatrix, LightSpaceMatrix);
+    if (StartQueries)
+        glBeginQuery(GL_TIME_ELAPSED, TimerQueries[1]);
+    this->RenderTavern(ProjectionMatrix, ViewMatrix, ModelMatrix);
+    if (StartQueries)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        for (int i = 0; i < (int)ARRAY_SIZE(TimerQueries); ++i)
+        {
+            TimerQueryPending[i] = true;
+            TimerQueryFilters[i] = ShadowFilter;
+        }
+    }
 
     // Render depth map on a quad
-    //this->RenderDepthMap();
+    //this->RenderDepthMap(0);
 
     // Render tavern wireframe
     if (Wireframe)
@@ -343,77 +599,470 @@ void demo_shadowmap::DisplayDebugUI()
         }
         TavernScene.InspectLights();
 
+        ImGui::Checkbox("Show cascades", &ShowCascades);
+        ImGui::SliderFloat("Shadow distance", &ShadowDistance, 5.f, CAMERA_FAR);
+        ImGui::SliderFloat("Split lambda", &CascadeSplitLambda, 0.f, 1.f);
+        ImGui::Checkbox("Cache shadows", &CacheShadows);
+        ImGui::Text("Cascades rendered this frame: %d/%d", RenderedCascadeCount, CASCADE_COUNT);
+
+        // Filtering modes, timings are the last measured with each mode
+        static const char* FilterDescriptions[SHADOW_FILTER_COUNT] =
+        {
+            "9 taps, hard 1-texel steps",
+            "9 bilinear compare taps (36 texels), smooth edges",
+            "1 tap, 9x9 blur at 1/2 res, soft, light bleeding",
+            "1 tap, 9x9 blur at 1/2 res, soft, darkens contact shadows",
+        };
+        if (ImGui::Combo("Shadow filter", &ShadowFilter, "PCF\0Hardware PCF\0VSM\0ESM\0"))
+            memset(CascadeFiltered, 0, sizeof(CascadeFiltered));
+        if (ShadowFilter == SHADOW_FILTER_ESM && ImGui::SliderFloat("ESM exponent", &ESMExponent, 5.f, 80.f))
+            memset(CascadeFiltered, 0, sizeof(CascadeFiltered));
+        static const char* FilterNames[SHADOW_FILTER_COUNT] = { "PCF", "Hardware PCF", "VSM", "ESM" };
+        ImGui::Columns(4, "Shadow filters");
+        ImGui::Text("Filter"); ImGui::NextColumn();
+        ImGui::Text("Shadow pass"); ImGui::NextColumn();
+        ImGui::Text("Tavern pass"); ImGui::NextColumn();
+        ImGui::Text("Quality"); ImGui::NextColumn();
+        ImGui::Separator();
+        for (int i = 0; i < SHADOW_FILTER_COUNT; ++i)
+        {
+            ImGui::Text("%s", FilterNames[i]); ImGui::NextColumn();
+            ImGui::Text("%.3f ms", ShadowPassTimes[i]); ImGui::NextColumn();
+            ImGui::Text("%.3f ms", LookupTimes[i]); ImGui::NextColumn();
+            ImGui::Text("%s", FilterDescriptions[i]); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+
+        if (ImGui::Combo("Point shadow quality", &PointShadowQuality, "Low\0Medium\0High\0"))
+            this->CreatePointShadowAtlas();
+        ImGui::SliderInt("Point shadow face budget", &PointShadowFaceBudget, 1, MAX_POINT_SHADOWS * 6);
+        ImGui::Checkbox("Round-robin refresh", &PointShadowRoundRobin);
+        ImGui::Text("Point shadows: %d lights, %dx%d faces, %d faces rendered this frame",
+            PointShadowCount, PointShadowFaceResolution, PointShadowFaceResolution, RenderedPointShadowFaces);
+        ImGui::Text("Point shadow pass: %.3f ms", PointShadowTime);
+        for (int i = 0; i < CASCADE_COUNT; ++i)
+            ImGui::Text("Cascade %d: %.2f (%dx%d)", i, CascadeSplits[i], DepthMapResolution, DepthMapResolution);
+
         ImGui::TreePop();
     }
+}
+
+void demo_shadowmap::UpdateCascades(const mat4& ViewMatrix, float AspectRatio, v3 LightDirection)
+{
+    mat4 InverseViewMatrix = Mat4::Inverse(ViewMatrix);
+    float TanY = Math::Tan(CAMERA_FOVY * 0.5f);
+    float TanX = TanY * AspectRatio;
 
-    if (ImGui::Begin("Depth map"))
+    // Scene bounds to keep every caster in the light depth range
+    v3 SceneCenter = (TavernRenderer.MeshMin + TavernRenderer.MeshMax) * 0.5f;
+    float SceneRadius = Vec3::Length(TavernRenderer.MeshMax - TavernRenderer.MeshMin) * 0.5f;
+
+    v3 Up = fabsf(LightDirection.y) > 0.99f ? v3{ 1.f, 0.f, 0.f } : v3{ 0.f, 1.f, 0.f };
+    mat4 LightRotation = Mat4::LookAt({ 0.f, 0.f, 0.f }, -LightDirection, Up);
+    mat4 InverseLightRotation = Mat4::Transpose(LightRotation);
+
+    float SliceNear = CAMERA_NEAR;
+    for (int i = 0; i < CASCADE_COUNT; ++i)
     {
-        ImGui::Image((ImTextureID)DepthMap, { DepthMapResolution * 0.4f, DepthMapResolution * 0.4f }, ImVec2(0, 1), ImVec2(1, 0));
+        // Practical split scheme
+        float Ratio = (float)(i + 1) / CASCADE_COUNT;
+        float LogSplit = CAMERA_NEAR * powf(ShadowDistance / CAMERA_NEAR, Ratio);
+        float UniformSplit = CAMERA_NEAR + (ShadowDistance - CAMERA_NEAR) * Ratio;
+        float SliceFar = Math::Lerp(UniformSplit, LogSplit, CascadeSplitLambda);
+        CascadeSplits[i] = SliceFar;
+
+        // Bounding sphere of the frustum slice (doesn't change with camera rotation, so the cascade doesn't shimmer)
+        v3 Corners[8];
+        v3 Center = {};
+        for (int Corner = 0; Corner < 8; ++Corner)
+        {
+            float Depth = (Corner & 4) ? SliceFar : SliceNear;
+            v4 ViewCorner = { ((Corner & 1) ? 1.f : -1.f) * Depth * TanX, ((Corner & 2) ? 1.f : -1.f) * Depth * TanY, -Depth, 1.f };
+            Corners[Corner] = (InverseViewMatrix * ViewCorner).xyz;
+            Center += Corners[Corner] / 8.f;
+        }
+        float Radius = 0.f;
+        for (const v3& Corner : Corners)
+            Radius = Math::Max(Radius, Vec3::Length(Corner - Center));
+        Radius = ceilf(Radius * 16.f) / 16.f;
+
+        // Snap the center to texels in light space so the shadow edges don't swim when the camera moves
+        // (the matrix also stays the same until the camera moves by a texel, which keeps the cascade cached)
+        float TexelSize = 2.f * Radius / DepthMapResolution;
+        v4 LightSpaceCenter = LightRotation * Vec4::vec4(Center, 1.f);
+        LightSpaceCenter.x = floorf(LightSpaceCenter.x / TexelSize) * TexelSize;
+        LightSpaceCenter.y = floorf(LightSpaceCenter.y / TexelSize) * TexelSize;
+        LightSpaceCenter.z = floorf(LightSpaceCenter.z);
+        Center = (InverseLightRotation * LightSpaceCenter).xyz;
+
+        // Light frustum fitted around the sphere, depth range covers the casters between the sun and the slice
+        float DepthRange = ceilf(Vec3::Length(Center - SceneCenter) + SceneRadius);
+        mat4 LightViewMatrix = Mat4::LookAt(Center, Center - LightDirection, Up);
+        mat4 LightProjectionMatrix = Mat4::Orthographic(-Radius, Radius, -Radius, Radius, -DepthRange, DepthRange);
+
+        CascadeMatrices[i] = LightProjectionMatrix * LightViewMatrix;
+        SliceNear = SliceFar;
     }
-
-    ImGui::End();
 }
 
-void demo_shadowmap::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix, const mat4& LightSpaceMatrix) const
+void demo_shadowmap::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
 {
     glEnable(GL_DEPTH_TEST);
 
     // Use shader and configure its uniforms
-    glUseProgram(TavernProgram);
+    TavernProgram->Use();
+
+    // Uniforms that won't change (only uploaded once by GL::program)
+    TavernProgram->SetInt("uDiffuseTexture", 0);
+    TavernProgram->SetInt("uEmissiveTexture", 1);
+    TavernProgram->SetVec3("uEmissiveTint", TavernRenderer.EmissiveTint);
+    TavernProgram->SetInt("uShadowMap", 2);
+    TavernProgram->BindUniformBlock("uLightBlock", LIGHT_BLOCK_BINDING_POINT);
 
     // Set uniforms
     mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(ModelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uProjection"), 1, GL_FALSE, ProjectionMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uModel"), 1, GL_FALSE, ModelMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uView"), 1, GL_FALSE, ViewMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uModelNormalMatrix"), 1, GL_FALSE, NormalMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(TavernProgram, "uLightSpaceMatrix"), 1, GL_FALSE, LightSpaceMatrix.e);
-    glUniform3fv(glGetUniformLocation(TavernProgram, "uViewPosition"), 1, Camera.Position.e);
+    TavernProgram->SetMat4("uModel", ModelMatrix);
+    TavernProgram->SetMat4("uModelNormalMatrix", NormalMatrix);
+    TavernProgram->SetInt("uShowCascades", ShowCascades);
+    TavernProgram->SetInt("uPointShadowAtlas", 3);
+    TavernProgram->SetInt("uShadowMapCompare", 4);
+    TavernProgram->SetInt("uShadowMoments", 5);
+    TavernProgram->SetInt("uShadowFilter", ShadowFilter);
+    TavernProgram->SetFloat("uESMExponent", ESMExponent);
+    char Name[64];
+    for (int i = 0; i < CASCADE_COUNT; ++i)
+    {
+        snprintf(Name, ARRAY_SIZE(Name), "uCascadeMatrices[%d]", i);
+        TavernProgram->SetMat4(Name, CascadeMatrices[i]);
+        snprintf(Name, ARRAY_SIZE(Name), "uCascadeSplits[%d]", i);
+        TavernProgram->SetFloat(Name, CascadeSplits[i]);
+    }
+    for (int i = 0; i < TavernScene.LightCount; ++i)
+    {
+        int Slot = -1;
+        for (int j = 0; j < PointShadowCount; ++j)
+            Slot = (PointShadows[j].LightIndex == i) ? j : Slot;
+        snprintf(Name, ARRAY_SIZE(Name), "uPointShadowSlots[%d]", i);
+        TavernProgram->SetInt(Name, Slot);
+    }
+    float TileSize = 1.f / PointShadowTilesPerRow;
+    for (int i = 0; i < PointShadowCount * 6; ++i)
+    {
+        snprintf(Name, ARRAY_SIZE(Name), "uPointShadowMatrices[%d]", i);
+        TavernProgram->SetMat4(Name, PointShadows[i / 6].FaceMatrices[i % 6]);
+        snprintf(Name, ARRAY_SIZE(Name), "uPointShadowTiles[%d]", i);
+        TavernProgram->SetVec4(Name, { (i % PointShadowTilesPerRow) * TileSize, (i / PointShadowTilesPerRow) * TileSize, TileSize, TileSize });
+    }
     
-    // Bind uniform buffer and textures
+    // Upload view and bind uniform buffers and textures
+    FrameBlock.SetView(ProjectionMatrix, ViewMatrix);
     glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, TavernScene.DiffuseTexture);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, TavernScene.EmissiveTexture);
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, DepthMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, DepthMap);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, PointShadowAtlas);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, DepthMap);
+    glBindSampler(4, CompareSampler);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, MomentsMap);
     glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
     
     // Draw mesh
     glBindVertexArray(TavernVAO);
     glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    glBindSampler(4, 0);
+}
+
+void demo_shadowmap::RenderTavernDepthMap(const mat4& ModelMatrix)
+{
+    // Cached cascades stay valid while the casters don't move
+    bool CastersMoved = memcmp(&CachedModelMatrix, &ModelMatrix, sizeof(mat4)) != 0;
+    CachedModelMatrix = ModelMatrix;
+
+    RenderedCascadeCount = 0;
+    for (int i = 0; i < CASCADE_COUNT; ++i)
+    {
+        if (CacheShadows && !CastersMoved && CascadeCached[i] && memcmp(&CachedCascadeMatrices[i], &CascadeMatrices[i], sizeof(mat4)) == 0)
+            continue;
+
+        // One pass per cascade, rendered into its layer
+        if (RenderedCascadeCount++ == 0)
+        {
+            glViewport(0, 0, DepthMapResolution, DepthMapResolution);
+            glBindFramebuffer(GL_FRAMEBUFFER, DepthFBO);
+            glEnable(GL_DEPTH_TEST);
+
+            // Use shader and configure its uniforms
+            DepthProgram->Use();
+            DepthProgram->SetMat4("uModel", ModelMatrix);
+            glBindVertexArray(TavernVAO);
+        }
+
+        CascadeCached[i] = true;
+        CascadeFiltered[i] = false;
+        CachedCascadeMatrices[i] = CascadeMatrices[i];
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, DepthMap, 0, i);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        DepthProgram->SetMat4("uLightSpaceMatrix", CascadeMatrices[i]);
+        glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void demo_shadowmap::CreateMomentsMaps()
+{
+    glGenFramebuffers(1, &MomentsFBO);
+
+    glGenTextures(1, &MomentsMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, MomentsMap);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG32F, MomentsResolution, MomentsResolution, CASCADE_COUNT, 0, GL_RG, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Ping-pong targets for the separable blur
+    glGenTextures(2, MomentsTempTextures);
+    for (int i = 0; i < 2; ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, MomentsTempTextures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, MomentsResolution, MomentsResolution, 0, GL_RG, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void demo_shadowmap::PrefilterCascades()
+{
+    if (ShadowFilter != SHADOW_FILTER_VSM && ShadowFilter != SHADOW_FILTER_ESM)
+        return;
+    if (!MomentsProgram->IsReady() || !BlurProgram->IsReady())
+        return;
+
+    bool FBOBound = false;
+    for (int i = 0; i < CASCADE_COUNT; ++i)
+    {
+        if (CascadeFiltered[i])
+            continue;
+        CascadeFiltered[i] = true;
+
+        if (!FBOBound)
+        {
+            FBOBound = true;
+            glBindFramebuffer(GL_FRAMEBUFFER, MomentsFBO);
+            glViewport(0, 0, MomentsResolution, MomentsResolution);
+            glDisable(GL_DEPTH_TEST);
+            glBindVertexArray(RenderVAO);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        // Moments at reduced resolution
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, MomentsTempTextures[0], 0);
+        MomentsProgram->Use();
+        MomentsProgram->SetInt("uDepthMap", 0);
+        MomentsProgram->SetInt("uLayer", i);
+        MomentsProgram->SetInt("uExponential", ShadowFilter == SHADOW_FILTER_ESM);
+        MomentsProgram->SetFloat("uESMExponent", ESMExponent);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, DepthMap);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        // Separable blur, the vertical pass writes the cascade layer
+        BlurProgram->Use();
+        BlurProgram->SetInt("uSource", 0);
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, MomentsTempTextures[1], 0);
+        BlurProgram->SetVec3("uDirection", { 1.f / MomentsResolution, 0.f, 0.f });
+        glBindTexture(GL_TEXTURE_2D, MomentsTempTextures[0]);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, MomentsMap, 0, i);
+        BlurProgram->SetVec3("uDirection", { 0.f, 1.f / MomentsResolution, 0.f });
+        glBindTexture(GL_TEXTURE_2D, MomentsTempTextures[1]);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    if (FBOBound)
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void demo_shadowmap::RenderTavernDepthMap(const mat4& ModelMatrix, const mat4& LightSpaceMatrix) const
+void demo_shadowmap::CreatePointShadowAtlas()
 {
-    glViewport(0, 0, DepthMapResolution, DepthMapResolution);
-    glBindFramebuffer(GL_FRAMEBUFFER, DepthFBO);
-    //glCullFace(GL_FRONT);
+    // Square grid of face tiles
+    PointShadowFaceResolution = POINT_SHADOW_RESOLUTIONS[PointShadowQuality];
+    PointShadowTilesPerRow = (int)ceilf(sqrtf(MAX_POINT_SHADOWS * 6.f));
+    int AtlasSize = PointShadowTilesPerRow * PointShadowFaceResolution;
 
+    if (PointShadowFBO == 0)
+    {
+        glGenFramebuffers(1, &PointShadowFBO);
+        glGenTextures(1, &PointShadowAtlas);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, PointShadowAtlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, AtlasSize, AtlasSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, PointShadowFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, PointShadowAtlas, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    // Faces not rendered yet are unshadowed (far depth)
+    glDisable(GL_SCISSOR_TEST);
+    glDepthMask(GL_TRUE);
+    glClearDepth(1.0);
     glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // Use shader and configure its uniforms
-    glUseProgram(DepthProgram);
+    // New atlas content, every face has to be rendered again
+    PointShadowCount = 0;
+}
 
-    // Set uniforms
-    glUniformMatrix4fv(glGetUniformLocation(DepthProgram, "uModel"), 1, GL_FALSE, ModelMatrix.e);
-    glUniformMatrix4fv(glGetUniformLocation(DepthProgram, "uLightSpaceMatrix"), 1, GL_FALSE, LightSpaceMatrix.e);
+void demo_shadowmap::UpdatePointShadows(const mat4& ModelMatrix)
+{
+    bool CastersMoved = memcmp(&PointShadowModelMatrix, &ModelMatrix, sizeof(mat4)) != 0;
+    PointShadowModelMatrix = ModelMatrix;
+
+    // Assign slots to the enabled point lights, faces are dirty when the light (or its range) changed
+    // The lookup keeps the matrices of the last render of each face until the face is rendered again
+    std::vector<int> NewSlots;
+    int Count = 0;
+    for (int i = 0; i < TavernScene.LightCount && Count < MAX_POINT_SHADOWS; ++i)
+    {
+        const GL::light& Light = TavernScene.GetLight(i);
+        if (!Light.Enabled || Light.Position.w <= 0.f)
+            continue;
+
+        point_shadow& Shadow = PointShadows[Count];
+        float Range = Math::Min(GL::GetLightRadius(Light), POINT_SHADOW_MAX_RANGE);
+        bool Changed = Count >= PointShadowCount || CastersMoved || Shadow.LightIndex != i
+            || memcmp(&Shadow.Position, &Light.Position, sizeof(v4)) != 0 || Shadow.Range != Range;
+        if (Changed)
+        {
+            // Tiles of another light (or never rendered), cleared so they do not cast the previous shadows
+            if (Count >= PointShadowCount || Shadow.LightIndex != i)
+            {
+                NewSlots.push_back(Count);
+                for (int Face = 0; Face < 6; ++Face)
+                    Shadow.FaceMatrices[Face] = Mat4::Identity();
+            }
+
+            Shadow.LightIndex = i;
+            Shadow.Position = Light.Position;
+            Shadow.Range = Range;
+
+            v3 Position = Light.Position.xyz / Light.Position.w;
+            mat4 ProjectionMatrix = Mat4::Perspective(Math::HalfPi(), 1.f, POINT_SHADOW_NEAR, Range);
+            for (int Face = 0; Face < 6; ++Face)
+            {
+                Shadow.PendingFaceMatrices[Face] = ProjectionMatrix * Mat4::LookAt(Position, Position + gCubeFaceDirections[Face], gCubeFaceUps[Face]);
+                Shadow.FaceDirty[Face] = true;
+            }
+        }
+        Count++;
+    }
+    PointShadowCount = Count;
 
-    // Draw mesh
+    if (!NewSlots.empty())
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, PointShadowFBO);
+        glEnable(GL_SCISSOR_TEST);
+        glDepthMask(GL_TRUE);
+        for (int Slot : NewSlots)
+        {
+            for (int i = Slot * 6; i < Slot * 6 + 6; ++i)
+            {
+                glScissor((i % PointShadowTilesPerRow) * PointShadowFaceResolution, (i / PointShadowTilesPerRow) * PointShadowFaceResolution,
+                    PointShadowFaceResolution, PointShadowFaceResolution);
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+        }
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Most important dirty faces first (closest lights to the camera)
+    struct face_update
+    {
+        float Importance;
+        int Index; // Slot * 6 + face
+    };
+    std::vector<face_update> Updates;
+    for (int i = 0; i < PointShadowCount * 6; ++i)
+    {
+        if (PointShadows[i / 6].FaceDirty[i % 6])
+        {
+            v3 Position = PointShadows[i / 6].Position.xyz / PointShadows[i / 6].Position.w;
+            Updates.push_back({ 1.f / (1.f + Vec3::Length(Position - Camera.Position)), i });
+        }
+    }
+    std::sort(Updates.begin(), Updates.end(), [](const face_update& A, const face_update& B) { return A.Importance > B.Importance; });
+    if ((int)Updates.size() > PointShadowFaceBudget)
+        Updates.resize(PointShadowFaceBudget);
+
+    // Spend the remaining budget on clean faces, round-robin
+    if (PointShadowRoundRobin && PointShadowCount > 0)
+    {
+        for (int i = 0; i < PointShadowCount * 6 && (int)Updates.size() < PointShadowFaceBudget; ++i)
+        {
+            PointShadowRoundRobinFace = (PointShadowRoundRobinFace + 1) % (PointShadowCount * 6);
+            if (!PointShadows[PointShadowRoundRobinFace / 6].FaceDirty[PointShadowRoundRobinFace % 6])
+                Updates.push_back({ 0.f, PointShadowRoundRobinFace });
+        }
+    }
+
+    RenderedPointShadowFaces = (int)Updates.size();
+    if (Updates.empty())
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, PointShadowFBO);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+
+    DepthProgram->Use();
+    DepthProgram->SetMat4("uModel", ModelMatrix);
     glBindVertexArray(TavernVAO);
-    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
 
+    for (const face_update& Update : Updates)
+    {
+        point_shadow& Shadow = PointShadows[Update.Index / 6];
+        int Face = Update.Index % 6;
+        int X = (Update.Index % PointShadowTilesPerRow) * PointShadowFaceResolution;
+        int Y = (Update.Index / PointShadowTilesPerRow) * PointShadowFaceResolution;
+        glViewport(X, Y, PointShadowFaceResolution, PointShadowFaceResolution);
+        glScissor(X, Y, PointShadowFaceResolution, PointShadowFaceResolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        DepthProgram->SetMat4("uLightSpaceMatrix", Shadow.PendingFaceMatrices[Face]);
+        glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+        Shadow.FaceMatrices[Face] = Shadow.PendingFaceMatrices[Face];
+        Shadow.FaceDirty[Face] = false;
+    }
+
+    glDisable(GL_SCISSOR_TEST);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    //glCullFace(GL_BACK);
 }
 
-void demo_shadowmap::RenderDepthMap() const
+void demo_shadowmap::RenderDepthMap(int Cascade)
 {
-    glUseProgram(RenderProgram);
+    RenderProgram->Use();
+    RenderProgram->SetInt("uLayer", Cascade);
     glBindVertexArray(RenderVAO);
     glDisable(GL_DEPTH_TEST);
-    glBindTexture(GL_TEXTURE_2D, DepthMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, DepthMap);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-}
\ No newline at end of file
+}
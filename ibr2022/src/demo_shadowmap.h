@@ -9,6 +9,7 @@
 #include "camera.h"
 
 #include "tavern_scene.h"
+#include "tavern_renderer.h"
 
 class demo_shadowmap : public demo
 {
@@ -17,34 +18,113 @@ public:
     virtual ~demo_shadowmap();
     virtual void Update(const platform_io& IO);
 
-    void RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix, const mat4& LightSpaceMatrix) const;
-    void RenderTavernDepthMap(const mat4& ModelMatrix, const mat4& LightSpaceMatrix) const;
-    void RenderDepthMap() const;
+    void RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
+    void RenderTavernDepthMap(const mat4& ModelMatrix);
+    void RenderDepthMap(int Cascade);
 
     void DisplayDebugUI();
 
+    static const int CASCADE_COUNT = 4;
+    static const int MAX_POINT_SHADOWS = 5;
+
+    enum shadow_filter
+    {
+        SHADOW_FILTER_PCF,          // Manual 3x3 compare
+        SHADOW_FILTER_HARDWARE_PCF, // 3x3 comparison sampler taps (2x2 bilinear PCF each)
+        SHADOW_FILTER_VSM,          // Variance shadow map
+        SHADOW_FILTER_ESM,          // Exponential shadow map
+        SHADOW_FILTER_COUNT,
+    };
+
 private:
+    struct point_shadow
+    {
+        int LightIndex;
+        v4 Position;    // Light position when the faces were computed
+        float Range;    // Far plane (light radius, clamped)
+        mat4 FaceMatrices[6];        // Matrices the atlas tiles were rendered with (used by the lookup)
+        mat4 PendingFaceMatrices[6]; // Current matrices, copied to FaceMatrices when the face is rendered
+        bool FaceDirty[6];
+    };
+
+    void UpdateCascades(const mat4& ViewMatrix, float AspectRatio, v3 LightDirection);
+    void CreatePointShadowAtlas();
+    void UpdatePointShadows(const mat4& ModelMatrix);
+    void CreateMomentsMaps();
+    void PrefilterCascades();
+
+    GL::cache& GLCache;
     GL::debug& GLDebug;
 
     // 3d camera
     camera Camera = {};
 
-    // shaders
-    GLuint TavernProgram = 0;
-    GLuint DepthProgram = 0;
-    GLuint RenderProgram = 0;
+    // shaders (shared through GLCache)
+    GL::program* TavernProgram = nullptr;
+    GL::program* DepthProgram = nullptr;
+    GL::program* RenderProgram = nullptr;
 
     GLuint TavernVAO = 0;
+    GL::frame_block FrameBlock;
     GLuint RenderVAO = 0;
 
     // depth map frame buffer
     GLuint DepthFBO = 0;
-    // depth map texture
+    // depth map texture array (one layer per cascade, same memory than a single 1024x1024 map)
     GLuint DepthMap = 0;
-    unsigned int DepthMapResolution = 1024;
-    float LightRange = 10.f;
+    unsigned int DepthMapResolution = 512;
+
+    // Cascades (practical split scheme: blend of logarithmic and uniform splits)
+    float ShadowDistance = 30.f;
+    float CascadeSplitLambda = 0.75f;
+    float CascadeSplits[CASCADE_COUNT] = {}; // Far view depth of each cascade
+    mat4 CascadeMatrices[CASCADE_COUNT] = {};
+    bool ShowCascades = false;
+
+    // Shadow cache: a cascade is only re-rendered when its matrix or the caster transform changes
+    bool CacheShadows = true;
+    bool CascadeCached[CASCADE_COUNT] = {};
+    mat4 CachedCascadeMatrices[CASCADE_COUNT] = {};
+    mat4 CachedModelMatrix = {};
+    int RenderedCascadeCount = 0; // This frame
+
+    // Cascade filtering (VSM/ESM moments are built at reduced resolution and blurred once per rendered cascade)
+    int ShadowFilter = SHADOW_FILTER_PCF;
+    float ESMExponent = 40.f;
+    GLuint CompareSampler = 0;
+    GLuint MomentsMap = 0; // RG32F texture array (one layer per cascade)
+    GLuint MomentsTempTextures[2] = {};
+    GLuint MomentsFBO = 0;
+    unsigned int MomentsResolution = 256;
+    bool CascadeFiltered[CASCADE_COUNT] = {};
+    GL::program* MomentsProgram = nullptr;
+    GL::program* BlurProgram = nullptr;
+
+    // GPU time of the shadow passes (render + prefilter) and of the lit tavern pass, per filter, and of the point shadow updates
+    GLuint TimerQueries[3] = {};
+    bool TimerQueryPending[3] = {};
+    int TimerQueryFilters[3] = {};
+    double ShadowPassTimes[SHADOW_FILTER_COUNT] = {}; // ms
+    double LookupTimes[SHADOW_FILTER_COUNT] = {};     // ms
+    double PointShadowTime = 0.0;                     // ms
+
+    // Point light shadows: 6 perspective faces per light packed in one depth atlas,
+    // dirty faces are re-rendered by importance within a per-frame face budget
+    int PointShadowQuality = 1; // Low, medium, high (face resolution)
+    int PointShadowFaceBudget = 6;
+    bool PointShadowRoundRobin = false; // Also refresh clean faces with the remaining budget
+    int PointShadowFaceResolution = 0;
+    int PointShadowTilesPerRow = 0;
+    GLuint PointShadowFBO = 0;
+    GLuint PointShadowAtlas = 0;
+    point_shadow PointShadows[MAX_POINT_SHADOWS] = {};
+    int PointShadowCount = 0;
+    int PointShadowRoundRobinFace = 0;
+    mat4 PointShadowModelMatrix = {};
+    int RenderedPointShadowFaces = 0; // This frame
 
     tavern_scene TavernScene;
+    tavern_renderer TavernRenderer;
 
     bool Wireframe = false;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 
+#include <chrono>
 #include <vector>
 
 #include <imgui.h>
@@ -50,16 +51,23 @@ in vec3 vPos;
 // Uniforms
 uniform samplerCube uSkybox;
 uniform vec3 uCameraPos;
-uniform bool uRefractive;
+uniform int uMode; // 0: reflective, 1: refractive, 2: diffuse (SH)
+uniform vec3 uSH[9];
 
 // Shader outputs
 out vec4 oColor;
 
 void main()
 {
+    if (uMode == 2)
+    {
+        oColor = vec4(sh_irradiance(uSH, normalize(vNormal)), 1.0);
+        return;
+    }
+
     vec3 I = normalize(vPos - uCameraPos);
     vec3 R;
-    if (uRefractive)
+    if (uMode == 1)
     {
         float ratio = 1.00 / 2.42;
         R = refract(I, normalize(vNormal), ratio);
@@ -104,11 +112,11 @@ void main()
     oColor = texture(skybox, vUV);
 })GLSL";
 
-demo_skybox::demo_skybox()
+demo_skybox::demo_skybox(GL::cache& GLCache)
 {
-    // Create render pipeline
-    this->Program = GL::CreateProgram(gVertexShaderStr, gFragmentShaderStr);
-    this->SkyboxProgram = GL::CreateProgram(gVertexShaderSkybox, gFragmentShaderSkybox);
+    // Create render pipeline (light shading injected for sh_irradiance)
+    this->Program.Create(gVertexShaderStr, gFragmentShaderStr, true);
+    this->SkyboxProgram.Create(gVertexShaderSkybox, gFragmentShaderSkybox);
 
     // Gen mesh
     {
@@ -193,7 +201,21 @@ demo_skybox::demo_skybox()
         "media/skybox/front.jpg",
         "media/skybox/back.jpg"
     };
-    cubemapTexture = loadCubemap(faces);
+    auto ProjectionStart = std::chrono::high_resolution_clock::now();
+    cubemapTexture = GLCache.LoadCubemap(faces, 0, &cubemapSH);
+    projectionTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - ProjectionStart).count();
+
+    // Sphere to show the diffuse ambient
+    {
+        GLuint SphereBuffer = GLCache.LoadObj("media/sphere.obj", 1.f, &sphereVertexCount);
+        glGenVertexArrays(1, &sphereVAO);
+        glBindVertexArray(sphereVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, SphereBuffer);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)OFFSETOF(vertex_full, Position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)OFFSETOF(vertex_full, Normal));
+    }
 
     //// Gen texture
     //{
@@ -218,27 +240,25 @@ demo_skybox::~demo_skybox()
 {
     // Cleanup GL
     //glDeleteTextures(1, &Texture);
-    glDeleteTextures(1, &cubemapTexture);
     glDeleteBuffers(1, &VertexBuffer);
     glDeleteVertexArrays(1, &VAO);
     glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteProgram(Program);
-    glDeleteProgram(SkyboxProgram);
+    glDeleteVertexArrays(1, &sphereVAO);
 }
 
-static void DrawCube(GLuint Program, mat4 ViewProj, mat4 Model, v3 cameraPos, bool refractive)
+static void DrawMesh(GL::program& Program, mat4 ViewProj, mat4 Model, v3 cameraPos, int mode, int vertexCount)
 {
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uViewProj"), 1, GL_FALSE, ViewProj.e);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uModel"), 1, GL_FALSE, Model.e);
-    glUniform3f(glGetUniformLocation(Program, "uCameraPos"), cameraPos.x, cameraPos.y, cameraPos.z);
-    glUniform1i(glGetUniformLocation(Program, "uRefractive"), refractive);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    Program.SetMat4("uViewProj", ViewProj);
+    Program.SetMat4("uModel", Model);
+    Program.SetVec3("uCameraPos", cameraPos);
+    Program.SetInt("uMode", mode);
+    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
 }
 
-static void DrawSkybox(GLuint Program, mat4 ViewProj)
+static void DrawSkybox(GL::program& Program, mat4 ViewProj)
 {
     glDepthFunc(GL_LEQUAL);
-    glUniformMatrix4fv(glGetUniformLocation(Program, "uViewProj"), 1, GL_FALSE, ViewProj.e);
+    Program.SetMat4("uViewProj", ViewProj);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glDepthFunc(GL_LESS);
 }
@@ -262,14 +282,15 @@ void demo_skybox::Update(const platform_io& IO)
     mat4 view = ViewMatrix;
     view.c[3].xyz = v3{ 0, 0, 0 };
 
-    glUseProgram(SkyboxProgram);
+    SkyboxProgram.Use();
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
     glBindVertexArray(skyboxVAO);
     DrawSkybox(SkyboxProgram, ProjectionMatrix * view);
     
     // Use shader and send data
-    glUseProgram(Program);
-    glUniform1f(glGetUniformLocation(Program, "uTime"), (float)IO.Time);
+    Program.Use();
+    Program.SetFloat("uTime", (float)IO.Time);
+    GL::UniformSH(Program, "uSH", *cubemapSH);
     
     //glBindTexture(GL_TEXTURE_2D, Texture);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
@@ -282,27 +303,17 @@ void demo_skybox::Update(const platform_io& IO)
     v3 ObjectPosition = { 0.f, 0.f, -3.f };
     {
         mat4 ModelMatrix = Mat4::Translate(ObjectPosition);
-        DrawCube(Program, ProjectionMatrix * ViewMatrix, ModelMatrix, Camera.Position, refractive);
+        DrawMesh(Program, ProjectionMatrix * ViewMatrix, ModelMatrix, Camera.Position, mode, VertexCount);
     }
 
-    DisplayDebugUI();
-}
-
-unsigned int demo_skybox::loadCubemap(std::vector<std::string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    GL::UploadCubemapTexture(faces);
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    // Sphere
+    {
+        glBindVertexArray(sphereVAO);
+        mat4 ModelMatrix = Mat4::Translate({ 2.5f, 0.f, -3.f });
+        DrawMesh(Program, ProjectionMatrix * ViewMatrix, ModelMatrix, Camera.Position, mode, sphereVertexCount);
+    }
 
-    return textureID;
+    DisplayDebugUI();
 }
 
 void demo_skybox::DisplayDebugUI()
@@ -310,7 +321,14 @@ void demo_skybox::DisplayDebugUI()
     if (ImGui::TreeNodeEx("demo_skybox", ImGuiTreeNodeFlags_Framed))
     {
         // Debug display
-        ImGui::Checkbox("Refractive", &refractive);
+        ImGui::RadioButton("Reflective", &mode, 0); ImGui::SameLine();
+        ImGui::RadioButton("Refractive", &mode, 1); ImGui::SameLine();
+        ImGui::RadioButton("Diffuse (SH)", &mode, 2);
+
+        // Diffuse ambient, 9 coefficients evaluated in the shader (no texture fetch)
+        ImGui::Text("SH projection: %.2f ms", projectionTime);
+        for (int i = 0; i < 9; ++i)
+            ImGui::Text("L%d: %.3f %.3f %.3f", i, cubemapSH->Coefs[i].x, cubemapSH->Coefs[i].y, cubemapSH->Coefs[i].z);
         ImGui::TreePop();
     }
 }
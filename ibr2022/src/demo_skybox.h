@@ -3,16 +3,16 @@
 #include "demo.h"
 
 #include "opengl_headers.h"
+#include "opengl_helpers.h"
 
 #include "camera.h"
 
 class demo_skybox : public demo
 {
 public:
-    demo_skybox();
+    demo_skybox(GL::cache& GLCache);
     virtual ~demo_skybox();
     virtual void Update(const platform_io& IO);
-    unsigned int loadCubemap(std::vector<std::string> faces);
     void DisplayDebugUI();
 
 private:
@@ -20,14 +20,18 @@ private:
     camera Camera = {};
 
     // GL objects needed by this demo
-    GLuint Program = 0;
-    GLuint SkyboxProgram = 0;
+    GL::program Program;
+    GL::program SkyboxProgram;
     GLuint Texture = 0;
     GLuint cubemapTexture;
+    const GL::sh9* cubemapSH = nullptr; // Diffuse ambient (owned by GLCache)
+    double projectionTime = 0.0;        // ms (first load only)
 
     GLuint VAO = 0;
     GLuint skyboxVAO = 0;
     GLuint VertexBuffer = 0;
     int VertexCount = 0;
-    bool refractive = false;
+    GLuint sphereVAO = 0;
+    int sphereVertexCount = 0;
+    int mode = 0; // 0: reflective, 1: refractive, 2: diffuse (SH)
 };
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include <vector>
+
+#include <imgui.h>
+
+#include "opengl_helpers.h"
+#include "opengl_helpers_atlas.h"
+#include "maths.h"
+#include "mesh.h"
+
+#include "demo_skybox_atlas.h"
+
+// Vertex format
+// ==================================================
+struct vertex
+{
+    v3 Position;
+    v2 UV;
+};
+
+struct vertex_atlas
+{
+    v3 Position;
+    v2 AtlasUV;  // UV remapped inside the 2D atlas
+    v3 ArrayUVW; // UV + layer inside the texture array
+};
+
+// Shaders
+// ==================================================
+static const char* gVertexShaderStr = R"GLSL(
+// Attributes
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec2 aAtlasUV;
+layout(location = 2) in vec3 aArrayUVW;
+
+// Uniforms
+uniform mat4 uViewProj;
+
+// Varyings
+out vec2 vAtlasUV;
+out vec3 vArrayUVW;
+
+void main()
+{
+    vAtlasUV = aAtlasUV;
+    vArrayUVW = aArrayUVW;
+    gl_Position = uViewProj * vec4(aPosition, 1.0);
+})GLSL";
+
+static const char* gFragmentShaderStr = R"GLSL(
+// Varyings
+in vec2 vAtlasUV;
+in vec3 vArrayUVW;
+
+// Uniforms
+#ifdef USE_TEXTURE_ARRAY
+uniform sampler2DArray uSkyboxTexture;
+#else
+uniform sampler2D uSkyboxTexture;
+#endif
+
+// Shader outputs
+out vec4 oColor;
+
+void main()
+{
+#ifdef USE_TEXTURE_ARRAY
+    oColor = texture(uSkyboxTexture, vArrayUVW);
+#else
+    oColor = texture(uSkyboxTexture, vAtlasUV);
+#endif
+})GLSL";
+
+demo_skybox_atlas::demo_skybox_atlas(GL::cache& GLCache, GL::debug& GLDebug)
+    : GLCache(GLCache), DemoBase(GLCache, GLDebug)
+{
+    // Create shaders (same source, with and without texture array)
+    {
+        this->AtlasProgram = GLCache.LoadProgram(gVertexShaderStr, gFragmentShaderStr);
+        this->ArrayProgram = GLCache.LoadProgram(gVertexShaderStr, gFragmentShaderStr, "#define USE_TEXTURE_ARRAY\n");
+    }
+
+    // Pack skybox faces (same order than Mesh::BuildInvertedCube)
+    std::vector<GL::atlas_region> AtlasRegions;
+    std::vector<GL::atlas_region> ArrayRegions;
+    {
+        const char* Faces[6] = {
+            "media/Sky_NightTime01FT.png",
+            "media/Sky_NightTime01BK.png",
+            "media/Sky_NightTime01RT.png",
+            "media/Sky_NightTime01LF.png",
+            "media/Sky_NightTime01UP.png",
+            "media/Sky_NightTime01DN.png",
+        };
+
+        GL::atlas_builder AtlasBuilder;
+        for (int i = 0; i < 6; ++i)
+            AtlasBuilder.AddImage(Faces[i], IMG_FLIP);
+
+        int FaceWidth, FaceHeight;
+        AtlasBuilder.GetImageSize(0, &FaceWidth, &FaceHeight);
+
+        // 2D atlas: 3x2 faces with a 4 texels gutter, sized to the packed faces (no unused texels)
+        const int Gutter = 4;
+        this->AtlasWidth = 3 * GL::atlas_builder::GetPaddedSize(FaceWidth, Gutter);
+        this->AtlasHeight = 2 * GL::atlas_builder::GetPaddedSize(FaceHeight, Gutter);
+        glGenTextures(1, &AtlasTexture);
+        glBindTexture(GL_TEXTURE_2D, AtlasTexture);
+        AtlasBuilder.Upload2D(AtlasWidth, AtlasHeight, Gutter, true, AtlasRegions);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // Texture array: one face per layer, no gutter needed (clamp to edge)
+        glGenTextures(1, &ArrayTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ArrayTexture);
+        AtlasBuilder.UploadArray(FaceWidth, FaceHeight, 0, true, ArrayRegions);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // Gen mesh (remap face UVs into the packed regions)
+    {
+        vertex_descriptor Descriptor = {};
+        Descriptor.Stride = sizeof(vertex);
+        Descriptor.HasUV = true;
+        Descriptor.PositionOffset = OFFSETOF(vertex, Position);
+        Descriptor.UVOffset = OFFSETOF(vertex, UV);
+
+        vertex Cube[36];
+        this->VertexCount = 36;
+        Mesh::BuildInvertedCube(Cube, Cube + this->VertexCount, Descriptor);
+
+        vertex_atlas Vertices[36];
+        for (int i = 0; i < this->VertexCount; ++i)
+        {
+            const GL::atlas_region& AtlasRegion = AtlasRegions[i / 6];
+            const GL::atlas_region& ArrayRegion = ArrayRegions[i / 6];
+            v2 UV = Cube[i].UV;
+
+            Vertices[i].Position = Cube[i].Position;
+            Vertices[i].AtlasUV.x = Math::Lerp(AtlasRegion.UVMin.x, AtlasRegion.UVMax.x, UV.x);
+            Vertices[i].AtlasUV.y = Math::Lerp(AtlasRegion.UVMin.y, AtlasRegion.UVMax.y, UV.y);
+            Vertices[i].ArrayUVW.x = Math::Lerp(ArrayRegion.UVMin.x, ArrayRegion.UVMax.x, UV.x);
+            Vertices[i].ArrayUVW.y = Math::Lerp(ArrayRegion.UVMin.y, ArrayRegion.UVMax.y, UV.y);
+            Vertices[i].ArrayUVW.z = (float)ArrayRegion.Layer;
+        }
+
+        glGenBuffers(1, &this->VertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, this->VertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, this->VertexCount * sizeof(vertex_atlas), Vertices, GL_STATIC_DRAW);
+    }
+
+    // Create a vertex array
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->VertexBuffer);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_atlas), (void*)OFFSETOF(vertex_atlas, Position));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_atlas), (void*)OFFSETOF(vertex_atlas, AtlasUV));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_atlas), (void*)OFFSETOF(vertex_atlas, ArrayUVW));
+}
+
+demo_skybox_atlas::~demo_skybox_atlas()
+{
+    // Cleanup GL
+    glDeleteTextures(1, &AtlasTexture);
+    glDeleteTextures(1, &ArrayTexture);
+    glDeleteBuffers(1, &VertexBuffer);
+    glDeleteVertexArrays(1, &VAO);
+    GLCache.ReleaseProgram(AtlasProgram);
+    GLCache.ReleaseProgram(ArrayProgram);
+}
+
+void demo_skybox_atlas::Update(const platform_io& IO)
+{
+    Camera = CameraUpdateFreefly(Camera, IO.CameraInputs);
+
+    const float AspectRatio = (float)IO.WindowWidth / (float)IO.WindowHeight;
+    glViewport(0, 0, IO.WindowWidth, IO.WindowHeight);
+
+    mat4 ProjectionMatrix = Mat4::Perspective(Math::ToRadians(60.f), AspectRatio, 0.1f, 100.f);
+    mat4 ViewMatrix = CameraGetInverseMatrix(Camera);
+
+    // Clear screen
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Render skybox (remove camera translation, no depth write)
+    {
+        mat4 SkyboxViewMatrix = ViewMatrix;
+        SkyboxViewMatrix.c[3].xyz = v3{ 0.f, 0.f, 0.f };
+
+        GL::program& Program = UseTextureArray ? *ArrayProgram : *AtlasProgram;
+        Program.Use();
+        Program.SetMat4("uViewProj", ProjectionMatrix * SkyboxViewMatrix);
+
+        // Single bind + single draw for the 6 faces
+        if (UseTextureArray)
+            glBindTexture(GL_TEXTURE_2D_ARRAY, ArrayTexture);
+        else
+            glBindTexture(GL_TEXTURE_2D, AtlasTexture);
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(VAO);
+        glDrawArrays(GL_TRIANGLES, 0, VertexCount);
+        glDepthMask(GL_TRUE);
+    }
+
+    // Render tavern
+    DemoBase.RenderTavern(ProjectionMatrix, ViewMatrix, Mat4::Identity());
+
+    // Display debug UI
+    this->DisplayDebugUI();
+}
+
+void demo_skybox_atlas::DisplayDebugUI()
+{
+    if (ImGui::TreeNodeEx("demo_skybox_atlas", ImGuiTreeNodeFlags_Framed))
+    {
+        ImGui::Checkbox("Use texture array", &UseTextureArray);
+        if (ImGui::TreeNodeEx("2D atlas"))
+        {
+            ImGui::Text("Size: %dx%d", AtlasWidth, AtlasHeight);
+            ImGui::Image((ImTextureID)(size_t)AtlasTexture, { 256.f, 256.f * AtlasHeight / AtlasWidth }, ImVec2(0, 1), ImVec2(1, 0));
+            ImGui::TreePop();
+        }
+        ImGui::TreePop();
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "demo.h"
+
+#include "opengl_headers.h"
+
+#include "camera.h"
+#include "demo_base.h"
+
+// Skybox drawn with a single texture bind and a single draw call
+// The 6 faces are packed by GL::atlas_builder, either in a 2D atlas or in a 2D texture array
+class demo_skybox_atlas : public demo
+{
+public:
+    demo_skybox_atlas(GL::cache& GLCache, GL::debug& GLDebug);
+    virtual ~demo_skybox_atlas();
+    virtual void Update(const platform_io& IO);
+
+    void DisplayDebugUI();
+
+private:
+    GL::cache& GLCache;
+    demo_base DemoBase;
+
+    // 3d camera
+    camera Camera = {};
+
+    // GL objects needed by this demo
+    GL::program* AtlasProgram = nullptr; // From GLCache
+    GL::program* ArrayProgram = nullptr;
+    GLuint VAO = 0;
+    GLuint VertexBuffer = 0;
+    int VertexCount = 0;
+
+    // Textures
+    GLuint AtlasTexture = 0; // GL_TEXTURE_2D
+    GLuint ArrayTexture = 0; // GL_TEXTURE_2D_ARRAY
+    int AtlasWidth = 0;
+    int AtlasHeight = 0;
+
+    bool UseTextureArray = false;
+};
@@ -0,0 +1,70 @@
+#include "maths.h"
+
+#include "job_pool.h"
+
+job_pool::job_pool(int WorkerCount)
+{
+    if (WorkerCount < 0)
+        WorkerCount = Math::Max((int)std::thread::hardware_concurrency() - 1, 0);
+
+    for (int i = 0; i < WorkerCount; ++i)
+        Workers.emplace_back(&job_pool::WorkerMain, this);
+}
+
+job_pool::~job_pool()
+{
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Quit = true;
+    }
+    WorkAvailable.notify_all();
+    for (std::thread& Worker : Workers)
+        Worker.join();
+}
+
+void job_pool::Run(int JobCount, const std::function<void(int)>& Job)
+{
+    if (JobCount <= 0)
+        return;
+
+    std::unique_lock<std::mutex> Lock(Mutex);
+    this->Job = &Job;
+    this->JobCount = JobCount;
+    NextJob = 0;
+    PendingJobs = JobCount;
+    WorkAvailable.notify_all();
+
+    // Take jobs too, then wait for the ones still running on the workers
+    while (NextJob < this->JobCount)
+    {
+        int Index = NextJob++;
+        Lock.unlock();
+        Job(Index);
+        Lock.lock();
+        --PendingJobs;
+    }
+    WorkDone.wait(Lock, [this]() { return PendingJobs == 0; });
+
+    this->Job = nullptr;
+    this->JobCount = 0;
+    NextJob = 0;
+}
+
+void job_pool::WorkerMain()
+{
+    std::unique_lock<std::mutex> Lock(Mutex);
+    while (true)
+    {
+        WorkAvailable.wait(Lock, [this]() { return Quit || NextJob < JobCount; });
+        if (Quit)
+            return;
+
+        int Index = NextJob++;
+        const std::function<void(int)>& CurrentJob = *Job;
+        Lock.unlock();
+        CurrentJob(Index);
+        Lock.lock();
+        if (--PendingJobs == 0)
+            WorkDone.notify_all();
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for per-frame parallel loops (no thread creation per call)
+// Run blocks the calling thread, which also takes jobs
+class job_pool
+{
+public:
+    job_pool(int WorkerCount = -1); // -1: hardware concurrency - 1 (the calling thread is the last one)
+    ~job_pool();
+
+    int GetThreadCount() const { return (int)Workers.size() + 1; }
+
+    // Calls Job(0) ... Job(JobCount - 1), returns once all of them are done
+    void Run(int JobCount, const std::function<void(int)>& Job);
+
+private:
+    void WorkerMain();
+
+    std::vector<std::thread> Workers;
+    std::mutex Mutex;
+    std::condition_variable WorkAvailable;
+    std::condition_variable WorkDone;
+
+    // Current Run (protected by Mutex)
+    const std::function<void(int)>* Job = nullptr;
+    int JobCount = 0;
+    int NextJob = 0;
+    int PendingJobs = 0;
+    bool Quit = false;
+};
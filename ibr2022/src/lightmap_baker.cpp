@@ -0,0 +1,826 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#include <stb_image.h>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../externals/imgui/imstb_rectpack.h"
+
+#include "maths.h"
+
+#include "lightmap_baker.h"
+
+static const int LIGHTMAP_CACHE_VERSION = 3;
+static const int BVH_LEAF_SIZE = 4;
+static const float CHART_MIN_NORMAL_DOT = 0.95f; // ~18 degrees from the chart seed
+static const int CHART_MAX_TRIANGLES = 1024;     // Bounds the work of one chart (progress and load balancing)
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+static void HashBytes(uint64_t& Hash, const void* Data, size_t Size)
+{
+    for (size_t i = 0; i < Size; ++i)
+    {
+        Hash ^= ((const uint8_t*)Data)[i];
+        Hash *= FNV_PRIME;
+    }
+}
+
+// xorshift32, one state per chart so that bakes are deterministic whatever the thread count
+static float RandomFloat(uint32_t& State)
+{
+    State ^= State << 13;
+    State ^= State >> 17;
+    State ^= State << 5;
+    return (State >> 8) * (1.f / 16777216.f);
+}
+
+static v3 SampleCosineHemisphere(v3 Normal, uint32_t& State)
+{
+    float Phi = Math::TwoPi() * RandomFloat(State);
+    float R2 = RandomFloat(State);
+    float R = sqrtf(R2);
+
+    v3 Tangent = Vec3::Normalize(Vec3::Cross(fabsf(Normal.x) > 0.9f ? v3{ 0.f, 1.f, 0.f } : v3{ 1.f, 0.f, 0.f }, Normal));
+    v3 Bitangent = Vec3::Cross(Normal, Tangent);
+    return Tangent * (R * cosf(Phi)) + Bitangent * (R * sinf(Phi)) + Normal * sqrtf(Math::Max(1.f - R2, 0.f));
+}
+
+static bool IntersectBox(v3 Min, v3 Max, v3 Origin, v3 InvDirection, float MaxDistance)
+{
+    float TMin = 0.f;
+    float TMax = MaxDistance;
+    for (int i = 0; i < 3; ++i)
+    {
+        float T0 = (Min.e[i] - Origin.e[i]) * InvDirection.e[i];
+        float T1 = (Max.e[i] - Origin.e[i]) * InvDirection.e[i];
+        TMin = Math::Max(TMin, Math::Min(T0, T1));
+        TMax = Math::Min(TMax, Math::Max(T0, T1));
+    }
+    return TMin <= TMax;
+}
+
+lightmap_baker::~lightmap_baker()
+{
+    Cancel();
+}
+
+// Point of triangle ABC closest to P, as the barycentrics of B and C, returns the squared distance
+static float ClosestTrianglePoint(v2 P, v2 A, v2 B, v2 C, float* UOut, float* VOut)
+{
+    v2 AB = B - A;
+    v2 AC = C - A;
+    v2 AP = P - A;
+    float Denominator = AB.x * AC.y - AC.x * AB.y;
+    if (fabsf(Denominator) > 1e-8f)
+    {
+        float U = (AP.x * AC.y - AC.x * AP.y) / Denominator;
+        float V = (AB.x * AP.y - AP.x * AB.y) / Denominator;
+        if (U >= 0.f && V >= 0.f && U + V <= 1.f)
+        {
+            *UOut = U;
+            *VOut = V;
+            return 0.f;
+        }
+    }
+
+    // Outside (or degenerate): closest point of the edges
+    const v2 Starts[3] = { A, B, C };
+    const v2 StartUVs[3] = { { 0.f, 0.f }, { 1.f, 0.f }, { 0.f, 1.f } };
+    float BestDistance2 = INFINITY;
+    for (int i = 0; i < 3; ++i)
+    {
+        v2 Start = Starts[i];
+        v2 Edge = Starts[(i + 1) % 3] - Start;
+        v2 ToPoint = P - Start;
+        float EdgeLength2 = Edge.x * Edge.x + Edge.y * Edge.y;
+        float T = (EdgeLength2 > 0.f) ? Math::Clamp((ToPoint.x * Edge.x + ToPoint.y * Edge.y) / EdgeLength2, 0.f, 1.f) : 0.f;
+        v2 Delta = { ToPoint.x - Edge.x * T, ToPoint.y - Edge.y * T };
+        float Distance2 = Delta.x * Delta.x + Delta.y * Delta.y;
+        if (Distance2 < BestDistance2)
+        {
+            v2 StartUV = StartUVs[i];
+            v2 EndUV = StartUVs[(i + 1) % 3];
+            BestDistance2 = Distance2;
+            *UOut = StartUV.x + (EndUV.x - StartUV.x) * T;
+            *VOut = StartUV.y + (EndUV.y - StartUV.y) * T;
+        }
+    }
+    return BestDistance2;
+}
+
+bool lightmap_baker::Start(const std::vector<vertex_full>& Vertices, const std::vector<GL::light>& Lights, const char* AlbedoFilename, int ImageFlags, v3 AlbedoScale, const settings& Settings, int ThreadCount)
+{
+    Cancel();
+
+    this->Lights = Lights;
+    this->AlbedoScale = AlbedoScale;
+    this->Settings = Settings;
+    Resolution = Settings.Resolution;
+
+    // Triangles
+    int TriangleCount = (int)Vertices.size() / 3;
+    Triangles.resize(TriangleCount);
+    v3 SceneMin = { INFINITY, INFINITY, INFINITY };
+    v3 SceneMax = { -INFINITY, -INFINITY, -INFINITY };
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        const vertex_full* V = &Vertices[3 * i];
+        triangle& Triangle = Triangles[i];
+        Triangle.P0 = V[0].Position;
+        Triangle.E1 = V[1].Position - V[0].Position;
+        Triangle.E2 = V[2].Position - V[0].Position;
+        Triangle.N0 = V[0].Normal;
+        Triangle.N1 = V[1].Normal;
+        Triangle.N2 = V[2].Normal;
+        Triangle.UV0 = V[0].UV;
+        Triangle.UV1 = V[1].UV;
+        Triangle.UV2 = V[2].UV;
+        v3 Cross = Vec3::Cross(Triangle.E1, Triangle.E2);
+        float Length = Vec3::Length(Cross);
+        Triangle.Normal = (Length > 0.f) ? Cross * (1.f / Length) : v3{ 0.f, 1.f, 0.f };
+
+        for (int j = 0; j < 3; ++j)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                SceneMin.e[k] = Math::Min(SceneMin.e[k], V[j].Position.e[k]);
+                SceneMax.e[k] = Math::Max(SceneMax.e[k], V[j].Position.e[k]);
+            }
+        }
+    }
+    RayEpsilon = (TriangleCount > 0) ? Vec3::Length(SceneMax - SceneMin) * 1e-4f : 0.f;
+
+    // Charts: adjacent triangles with close normals, laid flat on the plane of their first triangle
+    std::vector<v2> FlatPoints;
+    std::vector<v2> FlatSizes;
+    BuildCharts(Vertices, RayEpsilon, &FlatPoints, &FlatSizes);
+    int ChartCount = (int)Charts.size();
+    float TotalArea = 0.f;
+    for (v2 Size : FlatSizes)
+        TotalArea += Size.x * Size.y;
+
+    // Pack with a uniform texel density, lowered until everything fits
+    std::vector<stbrp_rect> Rects(ChartCount);
+    std::vector<stbrp_node> PackNodes(Resolution);
+    int Gutter = Settings.Gutter;
+    float Scale = (TotalArea > 0.f) ? sqrtf(0.6f * Resolution * Resolution / TotalArea) : 1.f;
+    bool Packed = false;
+    for (int Attempt = 0; Attempt < 16 && !Packed; ++Attempt, Scale *= 0.85f)
+    {
+        bool Fits = true;
+        for (int i = 0; i < ChartCount; ++i)
+        {
+            int Width = Math::Max((int)ceilf(FlatSizes[i].x * Scale), 1) + 2 * Gutter;
+            int Height = Math::Max((int)ceilf(FlatSizes[i].y * Scale), 1) + 2 * Gutter;
+            Fits = Fits && Width <= Resolution && Height <= Resolution;
+            Rects[i].id = i;
+            Rects[i].w = (stbrp_coord)Math::Min(Width, Resolution + 1);
+            Rects[i].h = (stbrp_coord)Math::Min(Height, Resolution + 1);
+        }
+        if (!Fits)
+            continue;
+
+        stbrp_context Context;
+        stbrp_init_target(&Context, Resolution, Resolution, PackNodes.data(), (int)PackNodes.size());
+        Packed = stbrp_pack_rects(&Context, Rects.data(), ChartCount) != 0;
+        if (!Packed)
+            continue;
+
+        TrianglePoints.resize(3 * TriangleCount);
+        for (const stbrp_rect& Rect : Rects)
+        {
+            chart& Chart = Charts[Rect.id];
+            Chart.X = Rect.x;
+            Chart.Y = Rect.y;
+            Chart.Width = Rect.w;
+            Chart.Height = Rect.h;
+            for (int i = Chart.FirstTriangle; i < Chart.FirstTriangle + Chart.TriangleCount; ++i)
+            {
+                int TriangleIndex = ChartTriangles[i];
+                for (int j = 0; j < 3; ++j)
+                {
+                    v2 Point = FlatPoints[3 * TriangleIndex + j];
+                    TrianglePoints[3 * TriangleIndex + j] = { Rect.x + Gutter + Point.x * Scale, Rect.y + Gutter + Point.y * Scale };
+                }
+            }
+        }
+    }
+
+    if (!Packed)
+    {
+        fprintf(stderr, "Lightmap: %d charts do not fit in %dx%d\n", ChartCount, Resolution, Resolution);
+        Charts.clear();
+        return false;
+    }
+
+    LightmapUVs.resize(Vertices.size());
+    for (int i = 0; i < 3 * TriangleCount; ++i)
+        LightmapUVs[i] = { TrianglePoints[i].x / Resolution, TrianglePoints[i].y / Resolution };
+    Texels.assign(Resolution * Resolution, v4{ 0.f, 0.f, 0.f, 0.f });
+
+    // Albedo (read on the CPU, the bounce uses the same texture than the shader)
+    {
+        stbi_set_flip_vertically_on_load((ImageFlags & IMG_FLIP) ? 1 : 0);
+        int Channels;
+        uint8_t* Pixels = stbi_load(AlbedoFilename, &AlbedoWidth, &AlbedoHeight, &Channels, STBI_rgb_alpha);
+        if (Pixels)
+        {
+            Albedo.assign(Pixels, Pixels + AlbedoWidth * AlbedoHeight * 4);
+            stbi_image_free(Pixels);
+        }
+        else
+        {
+            fprintf(stderr, "Lightmap: albedo loading failed on '%s'\n", AlbedoFilename);
+            Albedo.clear();
+        }
+        stbi_set_flip_vertically_on_load(0); // Always reset to default value
+    }
+
+    BuildBVH();
+
+    // Workers pick charts one at a time
+    StartTime = std::chrono::high_resolution_clock::now();
+    NextChart = 0;
+    DoneCharts = 0;
+    Canceled = false;
+    if (ThreadCount <= 0)
+        ThreadCount = Math::Max((int)std::thread::hardware_concurrency(), 1);
+    for (int i = 0; i < ThreadCount; ++i)
+        Threads.emplace_back(&lightmap_baker::WorkerLoop, this);
+
+    return true;
+}
+
+void lightmap_baker::Cancel()
+{
+    Canceled = true;
+    for (std::thread& Thread : Threads)
+        Thread.join();
+    Threads.clear();
+}
+
+float lightmap_baker::GetProgress() const
+{
+    return Charts.empty() ? 0.f : (float)DoneCharts / (float)Charts.size();
+}
+
+bool lightmap_baker::Poll()
+{
+    if (Threads.empty() || DoneCharts < (int)Charts.size())
+        return false;
+
+    for (std::thread& Thread : Threads)
+        Thread.join();
+    Threads.clear();
+
+    BakeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - StartTime).count();
+    return true;
+}
+
+void lightmap_baker::BuildBVH()
+{
+    int TriangleCount = (int)Triangles.size();
+    std::vector<v3> Centroids(TriangleCount);
+    TriangleIndices.resize(TriangleCount);
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        const triangle& Triangle = Triangles[i];
+        Centroids[i] = Triangle.P0 + (Triangle.E1 + Triangle.E2) * (1.f / 3.f);
+        TriangleIndices[i] = i;
+    }
+
+    // Median split on the largest centroid axis (nodes are built from an explicit stack)
+    struct build_task
+    {
+        int Node;
+        int First;
+        int Count;
+    };
+    std::vector<build_task> Tasks;
+
+    Nodes.clear();
+    Nodes.reserve(2 * TriangleCount / BVH_LEAF_SIZE + 1);
+    Nodes.push_back({});
+    Tasks.push_back({ 0, 0, TriangleCount });
+    while (!Tasks.empty())
+    {
+        build_task Task = Tasks.back();
+        Tasks.pop_back();
+
+        v3 Min = { INFINITY, INFINITY, INFINITY };
+        v3 Max = { -INFINITY, -INFINITY, -INFINITY };
+        v3 CentroidMin = Min;
+        v3 CentroidMax = Max;
+        for (int i = Task.First; i < Task.First + Task.Count; ++i)
+        {
+            const triangle& Triangle = Triangles[TriangleIndices[i]];
+            v3 Points[3] = { Triangle.P0, Triangle.P0 + Triangle.E1, Triangle.P0 + Triangle.E2 };
+            for (int k = 0; k < 3; ++k)
+            {
+                for (const v3& Point : Points)
+                {
+                    Min.e[k] = Math::Min(Min.e[k], Point.e[k]);
+                    Max.e[k] = Math::Max(Max.e[k], Point.e[k]);
+                }
+                CentroidMin.e[k] = Math::Min(CentroidMin.e[k], Centroids[TriangleIndices[i]].e[k]);
+                CentroidMax.e[k] = Math::Max(CentroidMax.e[k], Centroids[TriangleIndices[i]].e[k]);
+            }
+        }
+
+        bvh_node& Node = Nodes[Task.Node];
+        Node.Min = Min;
+        Node.Max = Max;
+        if (Task.Count <= BVH_LEAF_SIZE)
+        {
+            Node.First = Task.First;
+            Node.Count = Task.Count;
+            continue;
+        }
+
+        v3 Extent = CentroidMax - CentroidMin;
+        int Axis = (Extent.x > Extent.y && Extent.x > Extent.z) ? 0 : (Extent.y > Extent.z ? 1 : 2);
+        int Half = Task.Count / 2;
+        int* First = TriangleIndices.data() + Task.First;
+        std::nth_element(First, First + Half, First + Task.Count, [&](int A, int B) { return Centroids[A].e[Axis] < Centroids[B].e[Axis]; });
+
+        int Left = (int)Nodes.size();
+        Node.First = Left;
+        Node.Count = 0;
+        Nodes.push_back({});
+        Nodes.push_back({});
+        Tasks.push_back({ Left, Task.First, Half });
+        Tasks.push_back({ Left + 1, Task.First + Half, Task.Count - Half });
+    }
+}
+
+bool lightmap_baker::Trace(v3 Origin, v3 Direction, float MaxDistance, bool AnyHit, hit* HitOut) const
+{
+    if (Nodes.empty())
+        return false;
+
+    v3 InvDirection = { 1.f / Direction.x, 1.f / Direction.y, 1.f / Direction.z };
+    hit Closest = { -1, MaxDistance, 0.f, 0.f };
+
+    int Stack[64];
+    int StackSize = 0;
+    Stack[StackSize++] = 0;
+    while (StackSize > 0)
+    {
+        const bvh_node& Node = Nodes[Stack[--StackSize]];
+        if (!IntersectBox(Node.Min, Node.Max, Origin, InvDirection, Closest.T))
+            continue;
+
+        if (Node.Count == 0)
+        {
+            Stack[StackSize++] = Node.First;
+            Stack[StackSize++] = Node.First + 1;
+            continue;
+        }
+
+        // Moller-Trumbore, both faces
+        for (int i = Node.First; i < Node.First + Node.Count; ++i)
+        {
+            const triangle& Triangle = Triangles[TriangleIndices[i]];
+            v3 P = Vec3::Cross(Direction, Triangle.E2);
+            float Determinant = Vec3::Dot(Triangle.E1, P);
+            if (fabsf(Determinant) < 1e-12f)
+                continue;
+
+            float InvDeterminant = 1.f / Determinant;
+            v3 S = Origin - Triangle.P0;
+            float U = Vec3::Dot(S, P) * InvDeterminant;
+            if (U < 0.f || U > 1.f)
+                continue;
+
+            v3 Q = Vec3::Cross(S, Triangle.E1);
+            float V = Vec3::Dot(Direction, Q) * InvDeterminant;
+            if (V < 0.f || U + V > 1.f)
+                continue;
+
+            float T = Vec3::Dot(Triangle.E2, Q) * InvDeterminant;
+            if (T <= 0.f || T >= Closest.T)
+                continue;
+
+            if (AnyHit)
+                return true;
+            Closest = { TriangleIndices[i], T, U, V };
+        }
+    }
+
+    if (Closest.Triangle < 0)
+        return false;
+    if (HitOut)
+        *HitOut = Closest;
+    return true;
+}
+
+// Diffuse part of light_shade with shadow rays (ambient is not shadowed, like in the shader)
+v3 lightmap_baker::ShadeDirect(v3 Position, v3 Normal, float* AmbientOut) const
+{
+    v3 Result = {};
+    float Ambient = 0.f;
+    for (const GL::light& Light : Lights)
+    {
+        if (!Light.Enabled)
+            continue;
+
+        v3 LightDirection;
+        float Distance = INFINITY;
+        float Attenuation = 1.f;
+        if (Light.Position.w > 0.f)
+        {
+            v3 ToLight = Light.Position.xyz / Light.Position.w - Position;
+            float Slope = Light.Attenuation.y + Light.Attenuation.z * Light.Attenuation.z;
+            float Reach = 1.f / GL::LIGHT_ATTENUATION_CUTOFF - Light.Attenuation.x;
+            float Distance2 = Vec3::Dot(ToLight, ToLight);
+            if (Reach <= 0.f || Distance2 * Slope * Slope > Reach * Reach)
+                continue;
+
+            Distance = sqrtf(Distance2);
+            LightDirection = ToLight * (1.f / Math::Max(Distance, 1e-6f));
+            Attenuation = 1.f / (Light.Attenuation.x + Slope * Distance);
+        }
+        else
+        {
+            LightDirection = Vec3::Normalize(Light.Position.xyz);
+        }
+
+        Ambient += Attenuation * (Light.Ambient.x + Light.Ambient.y + Light.Ambient.z) / 3.f;
+
+        float NdotL = Vec3::Dot(Normal, LightDirection);
+        if (NdotL <= 0.f || Trace(Position, LightDirection, Distance, true, nullptr))
+            continue;
+        Result += Light.Diffuse * (Attenuation * NdotL);
+    }
+
+    if (AmbientOut)
+        *AmbientOut = Ambient;
+    return Result;
+}
+
+v3 lightmap_baker::SampleAlbedo(v2 UV) const
+{
+    if (Albedo.empty())
+        return AlbedoScale;
+
+    // Nearest texel, repeat
+    int X = (int)((UV.x - floorf(UV.x)) * AlbedoWidth) % AlbedoWidth;
+    int Y = (int)((UV.y - floorf(UV.y)) * AlbedoHeight) % AlbedoHeight;
+    const uint8_t* Texel = &Albedo[(Y * AlbedoWidth + X) * 4];
+    return { AlbedoScale.x * Texel[0] / 255.f, AlbedoScale.y * Texel[1] / 255.f, AlbedoScale.z * Texel[2] / 255.f };
+}
+
+void lightmap_baker::BuildCharts(const std::vector<vertex_full>& Vertices, float WeldDistance, std::vector<v2>* FlatPoints, std::vector<v2>* FlatSizes)
+{
+    int TriangleCount = (int)Triangles.size();
+
+    // Weld the positions on a grid so that triangles sharing an edge share its vertex ids
+    struct weld_key
+    {
+        int64_t X, Y, Z;
+        int Vertex;
+    };
+    std::vector<weld_key> WeldKeys(3 * TriangleCount);
+    float InvWeldDistance = (WeldDistance > 0.f) ? 1.f / WeldDistance : 1.f;
+    for (int i = 0; i < 3 * TriangleCount; ++i)
+    {
+        v3 Position = Vertices[i].Position * InvWeldDistance;
+        WeldKeys[i] = { (int64_t)llroundf(Position.x), (int64_t)llroundf(Position.y), (int64_t)llroundf(Position.z), i };
+    }
+    std::sort(WeldKeys.begin(), WeldKeys.end(), [](const weld_key& A, const weld_key& B)
+    {
+        if (A.X != B.X) return A.X < B.X;
+        if (A.Y != B.Y) return A.Y < B.Y;
+        return A.Z < B.Z;
+    });
+
+    std::vector<uint32_t> VertexIds(3 * TriangleCount);
+    uint32_t VertexId = 0;
+    for (int i = 0; i < 3 * TriangleCount; ++i)
+    {
+        const weld_key& Key = WeldKeys[i];
+        if (i > 0 && (Key.X != WeldKeys[i - 1].X || Key.Y != WeldKeys[i - 1].Y || Key.Z != WeldKeys[i - 1].Z))
+            ++VertexId;
+        VertexIds[Key.Vertex] = VertexId;
+    }
+
+    // Edges sorted by their welded vertices, triangles with a common edge are neighbours
+    struct edge
+    {
+        uint64_t Key;
+        int Triangle;
+    };
+    std::vector<edge> Edges;
+    Edges.reserve(3 * TriangleCount);
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            uint32_t A = VertexIds[3 * i + j];
+            uint32_t B = VertexIds[3 * i + (j + 1) % 3];
+            if (A != B)
+                Edges.push_back({ ((uint64_t)Math::Min(A, B) << 32) | Math::Max(A, B), i });
+        }
+    }
+    std::sort(Edges.begin(), Edges.end(), [](const edge& A, const edge& B) { return A.Key < B.Key; });
+
+    std::vector<std::vector<int>> Neighbours(TriangleCount);
+    for (size_t Begin = 0, End; Begin < Edges.size(); Begin = End)
+    {
+        for (End = Begin + 1; End < Edges.size() && Edges[End].Key == Edges[Begin].Key; ++End)
+            ;
+        for (size_t i = Begin; i < End; ++i)
+        {
+            for (size_t j = i + 1; j < End; ++j)
+            {
+                Neighbours[Edges[i].Triangle].push_back(Edges[j].Triangle);
+                Neighbours[Edges[j].Triangle].push_back(Edges[i].Triangle);
+            }
+        }
+    }
+
+    // Flood fill from each unassigned triangle, ChartTriangles is the queue
+    std::vector<int> TriangleCharts(TriangleCount, -1);
+    Charts.clear();
+    ChartTriangles.clear();
+    ChartTriangles.reserve(TriangleCount);
+    FlatPoints->resize(3 * TriangleCount);
+    FlatSizes->clear();
+    for (int Seed = 0; Seed < TriangleCount; ++Seed)
+    {
+        if (TriangleCharts[Seed] != -1)
+            continue;
+
+        int ChartIndex = (int)Charts.size();
+        chart Chart = {};
+        Chart.FirstTriangle = (int)ChartTriangles.size();
+        v3 ChartNormal = Triangles[Seed].Normal;
+        TriangleCharts[Seed] = ChartIndex;
+        ChartTriangles.push_back(Seed);
+        for (int i = Chart.FirstTriangle; i < (int)ChartTriangles.size(); ++i)
+        {
+            for (int Neighbour : Neighbours[ChartTriangles[i]])
+            {
+                if ((int)ChartTriangles.size() - Chart.FirstTriangle >= CHART_MAX_TRIANGLES)
+                    break;
+                if (TriangleCharts[Neighbour] != -1 || Vec3::Dot(Triangles[Neighbour].Normal, ChartNormal) < CHART_MIN_NORMAL_DOT)
+                    continue;
+                TriangleCharts[Neighbour] = ChartIndex;
+                ChartTriangles.push_back(Neighbour);
+            }
+        }
+        Chart.TriangleCount = (int)ChartTriangles.size() - Chart.FirstTriangle;
+
+        // Project on the seed plane (same winding as the triangles), then move the chart to the origin
+        v3 Tangent = Vec3::Normalize(Vec3::Cross(fabsf(ChartNormal.x) > 0.9f ? v3{ 0.f, 1.f, 0.f } : v3{ 1.f, 0.f, 0.f }, ChartNormal));
+        v3 Bitangent = Vec3::Cross(ChartNormal, Tangent);
+        v2 Min = { INFINITY, INFINITY };
+        v2 Max = { -INFINITY, -INFINITY };
+        for (int i = Chart.FirstTriangle; i < (int)ChartTriangles.size(); ++i)
+        {
+            int TriangleIndex = ChartTriangles[i];
+            for (int j = 0; j < 3; ++j)
+            {
+                v3 Position = Vertices[3 * TriangleIndex + j].Position;
+                v2 Point = { Vec3::Dot(Position, Tangent), Vec3::Dot(Position, Bitangent) };
+                (*FlatPoints)[3 * TriangleIndex + j] = Point;
+                Min = { Math::Min(Min.x, Point.x), Math::Min(Min.y, Point.y) };
+                Max = { Math::Max(Max.x, Point.x), Math::Max(Max.y, Point.y) };
+            }
+        }
+        for (int i = Chart.FirstTriangle; i < (int)ChartTriangles.size(); ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                v2& Point = (*FlatPoints)[3 * ChartTriangles[i] + j];
+                Point = Point - Min;
+            }
+        }
+
+        Charts.push_back(Chart);
+        FlatSizes->push_back(Max - Min);
+    }
+}
+
+void lightmap_baker::BakeChart(int ChartIndex)
+{
+    const chart& Chart = Charts[ChartIndex];
+    uint32_t RandomState = (uint32_t)ChartIndex * 2654435761u + 1u;
+
+    // Closest triangle point of each texel center, 0 inside the triangles
+    // Gutter texels take the nearest triangle point up to Gutter + 1 texels away (bilinear reach), the others stay black
+    struct texel_sample
+    {
+        float Distance2;
+        int Triangle;
+        float U, V;
+    };
+    std::vector<texel_sample> Samples(Chart.Width * Chart.Height, texel_sample{ INFINITY, -1, 0.f, 0.f });
+    float MaxDistance = Settings.Gutter + 1.f;
+    for (int i = Chart.FirstTriangle; i < Chart.FirstTriangle + Chart.TriangleCount; ++i)
+    {
+        int TriangleIndex = ChartTriangles[i];
+        const v2* Points = &TrianglePoints[3 * TriangleIndex];
+        int MinX = Math::Max((int)floorf(Math::Min(Math::Min(Points[0].x, Points[1].x), Points[2].x) - MaxDistance), Chart.X);
+        int MinY = Math::Max((int)floorf(Math::Min(Math::Min(Points[0].y, Points[1].y), Points[2].y) - MaxDistance), Chart.Y);
+        int MaxX = Math::Min((int)ceilf(Math::Max(Math::Max(Points[0].x, Points[1].x), Points[2].x) + MaxDistance), Chart.X + Chart.Width);
+        int MaxY = Math::Min((int)ceilf(Math::Max(Math::Max(Points[0].y, Points[1].y), Points[2].y) + MaxDistance), Chart.Y + Chart.Height);
+        for (int Y = MinY; Y < MaxY; ++Y)
+        {
+            for (int X = MinX; X < MaxX; ++X)
+            {
+                texel_sample& Sample = Samples[(Y - Chart.Y) * Chart.Width + (X - Chart.X)];
+                if (Sample.Distance2 == 0.f)
+                    continue;
+
+                float U, V;
+                float Distance2 = ClosestTrianglePoint({ X + 0.5f, Y + 0.5f }, Points[0], Points[1], Points[2], &U, &V);
+                if (Distance2 < Sample.Distance2 && Distance2 <= MaxDistance * MaxDistance)
+                    Sample = { Distance2, TriangleIndex, U, V };
+            }
+        }
+    }
+
+    for (int Y = Chart.Y; Y < Chart.Y + Chart.Height; ++Y)
+    {
+        for (int X = Chart.X; X < Chart.X + Chart.Width; ++X)
+        {
+            const texel_sample& Sample = Samples[(Y - Chart.Y) * Chart.Width + (X - Chart.X)];
+            if (Sample.Triangle < 0)
+                continue;
+
+            const triangle& Triangle = Triangles[Sample.Triangle];
+            float U = Sample.U;
+            float V = Sample.V;
+            float W = 1.f - U - V;
+
+            v3 Position = Triangle.P0 + Triangle.E1 * U + Triangle.E2 * V;
+            v3 Normal = Triangle.N0 * W + Triangle.N1 * U + Triangle.N2 * V;
+            float NormalLength = Vec3::Length(Normal);
+            Normal = (NormalLength > 0.f) ? Normal * (1.f / NormalLength) : Triangle.Normal;
+            v3 GeometricNormal = (Vec3::Dot(Triangle.Normal, Normal) < 0.f) ? -Triangle.Normal : Triangle.Normal;
+            v3 Origin = Position + GeometricNormal * RayEpsilon;
+
+            float Ambient;
+            v3 Direct = ShadeDirect(Origin, Normal, &Ambient);
+
+            // One bounce: cosine weighted rays, the pdf cancels the cosine and pi of the lambertian
+            v3 Indirect = {};
+            for (int Sample = 0; Sample < Settings.SampleCount; ++Sample)
+            {
+                v3 Direction = SampleCosineHemisphere(Normal, RandomState);
+                hit Hit;
+                if (!Trace(Origin, Direction, INFINITY, false, &Hit))
+                    continue;
+
+                const triangle& HitTriangle = Triangles[Hit.Triangle];
+                v3 HitNormal = (Vec3::Dot(HitTriangle.Normal, Direction) > 0.f) ? -HitTriangle.Normal : HitTriangle.Normal;
+                v3 HitPosition = Origin + Direction * Hit.T + HitNormal * RayEpsilon;
+                float HitW = 1.f - Hit.U - Hit.V;
+                v2 HitUV = {
+                    HitTriangle.UV0.x * HitW + HitTriangle.UV1.x * Hit.U + HitTriangle.UV2.x * Hit.V,
+                    HitTriangle.UV0.y * HitW + HitTriangle.UV1.y * Hit.U + HitTriangle.UV2.y * Hit.V,
+                };
+
+                v3 Albedo = SampleAlbedo(HitUV);
+                v3 Irradiance = ShadeDirect(HitPosition, HitNormal, nullptr);
+                Indirect += v3{ Albedo.x * Irradiance.x, Albedo.y * Irradiance.y, Albedo.z * Irradiance.z };
+            }
+            if (Settings.SampleCount > 0)
+                Indirect *= 1.f / Settings.SampleCount;
+
+            Texels[Y * Resolution + X] = Vec4::vec4(Direct + Indirect, Ambient);
+        }
+    }
+}
+
+void lightmap_baker::WorkerLoop()
+{
+    for (;;)
+    {
+        int ChartIndex = NextChart++;
+        if (Canceled || ChartIndex >= (int)Charts.size())
+            return;
+
+        BakeChart(ChartIndex);
+        ++DoneCharts;
+    }
+}
+
+uint64_t lightmap_baker::HashSources(const std::vector<vertex_full>& Vertices, const char* AlbedoFilename, int ImageFlags, v3 AlbedoScale)
+{
+    uint64_t Hash = FNV_OFFSET_BASIS;
+    for (const vertex_full& Vertex : Vertices)
+    {
+        HashBytes(Hash, &Vertex.Position, sizeof(Vertex.Position));
+        HashBytes(Hash, &Vertex.Normal, sizeof(Vertex.Normal));
+        HashBytes(Hash, &Vertex.UV, sizeof(Vertex.UV));
+    }
+
+    // Albedo file identified by its name, size and modification time
+    HashBytes(Hash, AlbedoFilename, strlen(AlbedoFilename) + 1);
+    struct stat FileStat;
+    if (stat(AlbedoFilename, &FileStat) == 0)
+    {
+        int64_t Size = (int64_t)FileStat.st_size;
+        int64_t ModificationTime = (int64_t)FileStat.st_mtime;
+        HashBytes(Hash, &Size, sizeof(Size));
+        HashBytes(Hash, &ModificationTime, sizeof(ModificationTime));
+    }
+    HashBytes(Hash, &ImageFlags, sizeof(ImageFlags));
+    HashBytes(Hash, &AlbedoScale, sizeof(AlbedoScale));
+    return Hash;
+}
+
+uint64_t lightmap_baker::ComputeKey(uint64_t SourceHash, const std::vector<GL::light>& Lights, const settings& Settings)
+{
+    uint64_t Hash = FNV_OFFSET_BASIS;
+    HashBytes(Hash, &LIGHTMAP_CACHE_VERSION, sizeof(LIGHTMAP_CACHE_VERSION));
+    HashBytes(Hash, &SourceHash, sizeof(SourceHash));
+    HashBytes(Hash, &Settings.Resolution, sizeof(Settings.Resolution));
+    HashBytes(Hash, &Settings.SampleCount, sizeof(Settings.SampleCount));
+    HashBytes(Hash, &Settings.Gutter, sizeof(Settings.Gutter));
+
+    // Members only (padding is not initialized)
+    for (const GL::light& Light : Lights)
+    {
+        HashBytes(Hash, &Light.Enabled, sizeof(Light.Enabled));
+        HashBytes(Hash, &Light.Position, sizeof(Light.Position));
+        HashBytes(Hash, &Light.Ambient, sizeof(Light.Ambient));
+        HashBytes(Hash, &Light.Diffuse, sizeof(Light.Diffuse));
+        HashBytes(Hash, &Light.Attenuation, sizeof(Light.Attenuation));
+    }
+    return Hash;
+}
+
+bool lightmap_baker::LoadFromCache(const char* Filename, uint64_t Key, int ExpectedResolution, int ExpectedVertexCount)
+{
+    std::string CachedFile = Filename;
+    CachedFile += ".lightmap.cache";
+
+    FILE* File = fopen(CachedFile.c_str(), "rb");
+    if (File == nullptr)
+        return false;
+
+    uint64_t CachedKey = 0;
+    int CachedResolution = 0;
+    int VertexCount = 0;
+    bool Valid =
+           fread(&CachedKey, sizeof(uint64_t), 1, File) == 1
+        && fread(&CachedResolution, sizeof(int), 1, File) == 1
+        && fread(&VertexCount, sizeof(int), 1, File) == 1
+        && CachedKey == Key
+        && CachedResolution == ExpectedResolution
+        && VertexCount == ExpectedVertexCount;
+
+    // Read into temporaries, the current results stay valid if the file is truncated
+    std::vector<v2> CachedUVs;
+    std::vector<v4> CachedTexels;
+    if (Valid)
+    {
+        CachedUVs.resize(VertexCount);
+        CachedTexels.resize((size_t)CachedResolution * CachedResolution);
+        Valid = fread(CachedUVs.data(), sizeof(v2), CachedUVs.size(), File) == CachedUVs.size()
+            && fread(CachedTexels.data(), sizeof(v4), CachedTexels.size(), File) == CachedTexels.size();
+    }
+    fclose(File);
+
+    if (!Valid)
+        return false;
+
+    Resolution = CachedResolution;
+    LightmapUVs.swap(CachedUVs);
+    Texels.swap(CachedTexels);
+    BakeTime = 0.0;
+
+    printf("Loaded from cache: %s (lightmap)\n", Filename);
+
+    return true;
+}
+
+void lightmap_baker::SaveToCache(const char* Filename, uint64_t Key) const
+{
+    std::string CachedFile = Filename;
+    CachedFile += ".lightmap.cache";
+
+    FILE* File = fopen(CachedFile.c_str(), "wb");
+    if (File == nullptr)
+        return;
+
+    int VertexCount = (int)LightmapUVs.size();
+    fwrite(&Key, sizeof(uint64_t), 1, File);
+    fwrite(&Resolution, sizeof(int), 1, File);
+    fwrite(&VertexCount, sizeof(int), 1, File);
+    fwrite(LightmapUVs.data(), sizeof(v2), LightmapUVs.size(), File);
+    fwrite(Texels.data(), sizeof(v4), Texels.size(), File);
+    fclose(File);
+
+    printf("Saved to cache: %s (lightmap)\n", Filename);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+#include "mesh.h"
+#include "opengl_helpers.h"
+
+// CPU lightmap baker for static triangle lists
+// Adjacent triangles with close normals are grouped in flat charts packed in the lightmap atlas (stb_rectpack), then the texels are path traced
+// on all cores against a BVH of the mesh: direct diffuse light of the baked lights (with shadow rays) + one bounce
+// Lighting follows light_shade (same attenuation and cutoff), baked lights then only cost a texture fetch
+class lightmap_baker
+{
+public:
+    struct settings
+    {
+        int Resolution = 512;
+        int SampleCount = 32; // Indirect rays per texel
+        int Gutter = 1;       // Texels around each chart (filled with the nearest triangle point)
+    };
+
+    ~lightmap_baker();
+
+    // Pack the charts and start the worker threads (ThreadCount 0: hardware concurrency)
+    // Albedo is read from AlbedoFilename with the mesh UVs for the bounce, multiplied by AlbedoScale
+    // Returns false if the charts do not fit in the lightmap
+    bool Start(const std::vector<vertex_full>& Vertices, const std::vector<GL::light>& Lights, const char* AlbedoFilename, int ImageFlags, v3 AlbedoScale, const settings& Settings, int ThreadCount = 0);
+    void Cancel();
+    bool IsRunning() const { return !Threads.empty(); }
+    float GetProgress() const;
+    bool Poll(); // True once, when the workers are done (results are then valid)
+
+    // Identify a bake, stored in the cache file
+    // SourceHash covers the inputs that rarely change (mesh positions, normals and UVs, albedo file and scale)
+    static uint64_t HashSources(const std::vector<vertex_full>& Vertices, const char* AlbedoFilename, int ImageFlags, v3 AlbedoScale);
+    static uint64_t ComputeKey(uint64_t SourceHash, const std::vector<GL::light>& Lights, const settings& Settings);
+    // Rejects the file if the key, the resolution or the vertex count differ, or if it is truncated
+    bool LoadFromCache(const char* Filename, uint64_t Key, int ExpectedResolution, int ExpectedVertexCount);
+    void SaveToCache(const char* Filename, uint64_t Key) const;
+
+    // Results
+    std::vector<v2> LightmapUVs; // One per vertex
+    std::vector<v4> Texels;      // rgb: diffuse light (direct + indirect), a: ambient (average of the lights ambient colors)
+    int Resolution = 0;
+    double BakeTime = 0.0;       // ms (0 when loaded from cache)
+
+private:
+    struct triangle
+    {
+        v3 P0, E1, E2;    // Vertex 0 and edges
+        v3 N0, N1, N2;    // Vertex normals
+        v2 UV0, UV1, UV2; // Albedo UVs
+        v3 Normal;        // Geometric normal
+    };
+
+    struct bvh_node
+    {
+        v3 Min;
+        int First; // Interior: left child (right is First + 1), leaf: first index in TriangleIndices
+        v3 Max;
+        int Count; // 0 for interior nodes
+    };
+
+    struct chart
+    {
+        int X, Y, Width, Height; // Texels
+        int FirstTriangle;       // In ChartTriangles
+        int TriangleCount;
+    };
+
+    struct hit
+    {
+        int Triangle;
+        float T, U, V;
+    };
+
+    void BuildBVH();
+    bool Trace(v3 Origin, v3 Direction, float MaxDistance, bool AnyHit, hit* HitOut) const;
+    v3 ShadeDirect(v3 Position, v3 Normal, float* AmbientOut) const;
+    v3 SampleAlbedo(v2 UV) const;
+    void BuildCharts(const std::vector<vertex_full>& Vertices, float WeldDistance, std::vector<v2>* FlatPoints, std::vector<v2>* FlatSizes);
+    void BakeChart(int ChartIndex);
+    void WorkerLoop();
+
+    std::vector<triangle> Triangles;
+    std::vector<int> TriangleIndices;
+    std::vector<bvh_node> Nodes;
+    std::vector<chart> Charts;
+    std::vector<int> ChartTriangles; // Triangle indices grouped by chart
+    std::vector<v2> TrianglePoints;  // Triangle vertices in texels (3 per triangle)
+    std::vector<GL::light> Lights;
+    std::vector<uint8_t> Albedo; // RGBA8
+    int AlbedoWidth = 0;
+    int AlbedoHeight = 0;
+    v3 AlbedoScale = {};
+    settings Settings;
+    float RayEpsilon = 0.f;
+
+    std::vector<std::thread> Threads;
+    std::atomic<int> NextChart{ 0 };
+    std::atomic<int> DoneCharts{ 0 };
+    std::atomic<bool> Canceled{ false };
+    std::chrono::high_resolution_clock::time_point StartTime;
+};
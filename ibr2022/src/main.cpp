@@ -31,6 +31,9 @@
 #include "demo_shadowmap.h"
 #include "demo_skybox.h"
 #include "demo_postprocess.h"
+#include "demo_skybox_atlas.h"
+#include "demo_clustered.h"
+#include "demo_lighting.h"
 
 #if 0
 // Run on laptop high perf GPU
@@ -252,11 +255,14 @@ int main(int argc, char* argv[])
             std::make_unique<demo_instancing>(),
             std::make_unique<demo_shadowmap>(GLCache, GLDebug),
             std::make_unique<demo_postprocess>(GLCache, GLDebug),
-            std::make_unique<demo_skybox>(),
+            std::make_unique<demo_skybox>(GLCache),
             std::make_unique<demo_pg_skybox>(GLCache, GLDebug),
             std::make_unique<demo_pg_billboard>(GLCache, GLDebug),
             std::make_unique<demo_pg_billboard2>(),
             std::make_unique<demo_pg_postprocess>(App.IO, GLCache, GLDebug),
+            std::make_unique<demo_skybox_atlas>(GLCache, GLDebug),
+            std::make_unique<demo_clustered>(GLCache, GLDebug),
+            std::make_unique<demo_lighting>(GLCache, GLDebug),
             //std::make_unique<demo_pg_fbx>(GLDebug.Wireframe, GLCache),
             // TODO(demo): Add other demos here
         };
@@ -341,6 +341,18 @@ namespace Mat4
         return Mat4::Frustum(-Right, Right, -Top, Top, Near, Far);
     }
 
+    // Shifts the projected image by Offset (NDC units, 2 / Width is one pixel), used for sub-pixel jitter
+    inline mat4 Jitter(const mat4& Projection, v2 Offset)
+    {
+        mat4 R = Projection;
+        for (int i = 0; i < 4; ++i)
+        {
+            R.c[i].x += Offset.x * Projection.c[i].w;
+            R.c[i].y += Offset.y * Projection.c[i].w;
+        }
+        return R;
+    }
+
     inline mat4 LookAt(v3 Eye, v3 At, v3 Up)
     {
         v3 ZAxis = Vec3::Normalize(At - Eye);
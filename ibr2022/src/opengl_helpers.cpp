@@ -1,12 +1,23 @@
 
 #include <cassert>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <map>
 
 #include <stb_image.h>
 
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
 #include "platform.h"
+#include "maths.h"
 #include "mesh.h"
 
 #include "opengl_helpers.h"
@@ -14,42 +25,91 @@
 
 using namespace GL;
 
-static const char* ShaderStructsDefinitionsStr = R"GLSL(
-#line 19
-// Light structure
-struct light
-{
-	bool enabled;
-    vec4 position;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    vec3 attenuation;
+// Extensions not exposed by glad (GL 3.3 core), loaded by LoadExtensions() on the first program creation
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR           0x91B1
+
+typedef void (APIENTRYP gl_get_program_binary_proc)(GLuint Program, GLsizei BufSize, GLsizei* Length, GLenum* BinaryFormat, void* Binary);
+typedef void (APIENTRYP gl_program_binary_proc)(GLuint Program, GLenum BinaryFormat, const void* Binary, GLsizei Length);
+typedef void (APIENTRYP gl_program_parameteri_proc)(GLuint Program, GLenum PName, GLint Value);
+typedef void (APIENTRYP gl_max_shader_compiler_threads_proc)(GLuint Count);
+
+static struct
+{
+	bool Loaded;
+
+	// GL_ARB_get_program_binary (core in 4.1)
+	bool ProgramBinary;
+	gl_get_program_binary_proc GetProgramBinary;
+	gl_program_binary_proc LoadProgramBinary;
+	gl_program_parameteri_proc ProgramParameteri;
+
+	// GL_KHR_parallel_shader_compile (or ARB variant, same enums)
+	bool ParallelShaderCompile;
+	gl_max_shader_compiler_threads_proc MaxShaderCompilerThreads;
+
+	// Vendor/renderer/version strings (binaries are only valid for the same driver)
+	std::string Driver;
+} gExtensions = {};
+
+// Programs submitted by CreateProgramAsync, status not queried yet
+struct pending_program
+{
+	GLuint Program;
+	GLuint VertexShader;
+	GLuint FragmentShader;
+	uint64_t Hash;
 };
+static std::vector<pending_program> gPendingPrograms;
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
 
+// Light/material structs are generated from LightDataLayout and MaterialLayout
+static const char* LightShadeResultStr = R"GLSL(
 struct light_shade_result
 {
 	vec3 ambient;
 	vec3 diffuse;
 	vec3 specular;
 };
+)GLSL";
 
-struct material
+static const char* ShaderDefaultsStr = R"GLSL(
+// Packed light accessors (see GL::PackLight)
+bool light_enabled(light light) { return (light.ambient >> 24u) != 0u; }
+vec3 light_color(uint color) { return vec3(color & 0xFFu, (color >> 8u) & 0xFFu, (color >> 16u) & 0xFFu) / 255.0; }
+float unpack_half(uint h) // unpackHalf2x16 needs glsl 4.20 (no inf/nan, see PackHalf)
 {
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	vec3 emission;
-	float shininess;
-};
+    float magnitude = ((h & 0x7C00u) == 0u) ? float(h & 0x3FFu) * exp2(-24.0) : float(0x400u | (h & 0x3FFu)) * exp2(float((h >> 10u) & 0x1Fu) - 25.0);
+    return (h & 0x8000u) != 0u ? -magnitude : magnitude;
+}
+vec3 light_attenuation(light light)
+{
+    uint quadratic = (light.diffuse >> 24u) | ((light.specular >> 24u) << 8u);
+    return vec3(unpack_half(light.attenuation & 0xFFFFu), unpack_half(light.attenuation >> 16u), unpack_half(quadratic));
+}
+
+// Diffuse ambient from order 2 spherical harmonics (see GL::ProjectCubemapSH)
+vec3 sh_irradiance(vec3 sh[9], vec3 n)
+{
+    return sh[0] * 0.282095
+         + (sh[1] * n.y + sh[2] * n.z + sh[3] * n.x) * 0.488603
+         + (sh[4] * (n.x * n.y) + sh[5] * (n.y * n.z) + sh[7] * (n.x * n.z)) * 1.092548
+         + sh[6] * (0.315392 * (3.0 * n.z * n.z - 1.0))
+         + sh[8] * (0.546274 * (n.x * n.x - n.y * n.y));
+}
+
 // Default light
 light gDefaultLight = light(
-	true,
     vec4(1.0, 2.5, 0.0, 1.0),
-    vec3(0.2, 0.2, 0.2),
-    vec3(0.8, 0.8, 0.8),
-    vec3(0.9, 0.9, 0.9),
-    vec3(1.0, 0.0, 0.0));
+    0xFF333333u, // (0.2, 0.2, 0.2), enabled
+    0x00CCCCCCu, // (0.8, 0.8, 0.8)
+    0x00E6E6E6u, // (0.9, 0.9, 0.9)
+    0x00003C00u); // (1.0, 0.0, 0.0)
 
 // Default material
 uniform material gDefaultMaterial = material(
@@ -60,9 +120,36 @@ uniform material gDefaultMaterial = material(
     32.0);
 )GLSL";
 
+static const std::string& ShaderStructsDefinitions()
+{
+	char CutoffDefine[64];
+	snprintf(CutoffDefine, ARRAY_SIZE(CutoffDefine), "\n#define LIGHT_ATTENUATION_CUTOFF %.9f\n", LIGHT_ATTENUATION_CUTOFF);
+
+	static const std::string Str = CutoffDefine
+		+ std::string("\n// Light structure\n")
+		+ Std140::GenerateStruct("light", LightDataLayout)
+		+ LightShadeResultStr
+		+ Std140::GenerateStruct("material", MaterialLayout)
+		+ ShaderDefaultsStr;
+	return Str;
+}
+
+// Per-frame/per-view data (same layout than GL::frame_data)
+static const char* FrameBlockStr = R"GLSL(
+layout(std140) uniform uFrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec4 viewPosition; // World space
+    vec4 viewport;     // x, y, width, height
+    float time;
+    float deltaTime;
+} uFrame;
+)GLSL";
+
 // Light shader function
 static const char* PhongLightingStr = R"GLSL(
-#line 66
 // =================================
 // PHONG SHADER START ===============
 
@@ -70,18 +157,25 @@ static const char* PhongLightingStr = R"GLSL(
 light_shade_result light_shade(light light, float shininess, vec3 eyePosition, vec3 position, vec3 normal)
 {
 	light_shade_result r = light_shade_result(vec3(0.0), vec3(0.0), vec3(0.0));
-	if (!light.enabled)
+	if (!light_enabled(light))
 		return r;
 
     vec3 lightDir;
     float lightAttenuation = 1.0;
     if (light.position.w > 0.0)
     {
-        // Point light
+        // Point light, skipped beyond its influence radius before paying for sqrt/normalize (same radius than GL::GetLightRadius)
         vec3 lightPosFromVertexPos = (light.position.xyz / light.position.w) - position;
-        lightDir = normalize(lightPosFromVertexPos);
-        float dist = length(lightPosFromVertexPos);
-        lightAttenuation = 1.0 / (light.attenuation[0] + light.attenuation[1]*dist + light.attenuation[2]*light.attenuation[2]*dist);
+        vec3 attenuation = light_attenuation(light);
+        float slope = attenuation[1] + attenuation[2]*attenuation[2];
+        float reach = 1.0 / LIGHT_ATTENUATION_CUTOFF - attenuation[0];
+        float dist2 = dot(lightPosFromVertexPos, lightPosFromVertexPos);
+        if (reach <= 0.0 || dist2 * slope * slope > reach * reach)
+            return r;
+
+        float dist = sqrt(dist2);
+        lightDir = lightPosFromVertexPos / max(dist, 1e-6);
+        lightAttenuation = 1.0 / (attenuation[0] + slope*dist);
     }
     else
     {
@@ -89,16 +183,13 @@ light_shade_result light_shade(light light, float shininess, vec3 eyePosition, v
         lightDir = normalize(light.position.xyz);
     }
 
-    if (lightAttenuation < 0.001)
-        return r;
-
     vec3 eyeDir  = normalize(eyePosition - position);
 	vec3 reflectDir = reflect(-lightDir, normal);
 	float specAngle = max(dot(reflectDir, eyeDir), 0.0);
 
-    r.ambient  = lightAttenuation * light.ambient;
-    r.diffuse  = lightAttenuation * light.diffuse  * max(dot(normal, lightDir), 0.0);
-    r.specular = lightAttenuation * light.specular * (pow(specAngle, shininess / 4.0));
+    r.ambient  = lightAttenuation * light_color(light.ambient);
+    r.diffuse  = lightAttenuation * light_color(light.diffuse)  * max(dot(normal, lightDir), 0.0);
+    r.specular = lightAttenuation * light_color(light.specular) * (pow(specAngle, shininess / 4.0));
 	r.specular = clamp(r.specular, 0.0, 1.0);
 
 	return r;
@@ -107,28 +198,123 @@ light_shade_result light_shade(light light, float shininess, vec3 eyePosition, v
 // =================================
 )GLSL";
 
+// Write "<Prefix>.<Member>" in Name (the prefix is already written, PrefixLength includes the '.')
+static const char* MemberName(char* Name, size_t NameSize, size_t PrefixLength, const char* Member)
+{
+	snprintf(Name + PrefixLength, NameSize - PrefixLength, "%s", Member);
+	return Name;
+}
+
+static uint32_t PackUnorm8(float Value)
+{
+	return (uint32_t)(Math::Clamp(Value, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+static uint32_t PackColor(const v3& Color, uint32_t Alpha)
+{
+	return PackUnorm8(Color.r) | (PackUnorm8(Color.g) << 8) | (PackUnorm8(Color.b) << 16) | ((Alpha & 0xFFu) << 24);
+}
+
+// Half float with round to nearest, out of range values (and inf/nan) are clamped to the largest half
+static uint32_t PackHalf(float Value)
+{
+	uint32_t Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+	uint32_t Sign = (Bits >> 16) & 0x8000u;
+	uint32_t Magnitude = Bits & 0x7FFFFFFFu;
+
+	if (Magnitude >= 0x477FF000u) // Rounds above 65504
+		return Sign | 0x7BFFu;
+	if (Magnitude < 0x38800000u) // Under 2^-14: denormal, in 2^-24 steps
+		return Sign | (uint32_t)(fabsf(Value) * 16777216.f + 0.5f);
+
+	// Rebias the exponent (127 -> 15) and round the mantissa to 10 bits (a carry goes into the exponent)
+	return Sign | ((Magnitude - 0x38000000u + 0x1000u) >> 13);
+}
+
+static uint32_t PackHalf2x16(float X, float Y)
+{
+	return PackHalf(X) | (PackHalf(Y) << 16);
+}
+
+light_data GL::PackLight(const light& Light)
+{
+	light_data Result;
+	Result.Position    = Light.Position;
+	// Attenuation as half floats (small coefficients keep their precision), the quadratic one goes in the color alphas
+	uint32_t Quadratic = PackHalf(Light.Attenuation.e[2]);
+	Result.Ambient     = PackColor(Light.Ambient, Light.Enabled != 0 ? 0xFFu : 0u);
+	Result.Diffuse     = PackColor(Light.Diffuse, Quadratic);
+	Result.Specular    = PackColor(Light.Specular, Quadratic >> 8);
+	Result.Attenuation = PackHalf2x16(Light.Attenuation.e[0], Light.Attenuation.e[1]);
+	return Result;
+}
+
+float GL::GetLightRadius(const light& Light, float Cutoff)
+{
+	// Directional lights are not attenuated (light_shade only treats position.w > 0 as a point light)
+	if (Light.Position.w <= 0.f)
+		return INFINITY;
+
+	// light_shade: 1 / (c + l*d + q*q*d) < Cutoff
+	float Slope = Light.Attenuation.e[1] + Light.Attenuation.e[2] * Light.Attenuation.e[2];
+	float Reach = 1.f / Cutoff - Light.Attenuation.e[0];
+	if (Reach <= 0.f)
+		return 0.f;
+	if (Slope <= 0.f)
+		return INFINITY;
+
+	return Reach / Slope;
+}
+
+void GL::UniformLight(program& Program, const char* LightUniformName, const light& Light)
+{
+	Program.Use();
+	char Name[255];
+	size_t PrefixLength = snprintf(Name, ARRAY_SIZE(Name), "%s.", LightUniformName);
+
+	light_data Data = PackLight(Light);
+	Program.SetVec4(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "position"), Data.Position);
+	Program.SetUint(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "ambient"), Data.Ambient);
+	Program.SetUint(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "diffuse"), Data.Diffuse);
+	Program.SetUint(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "specular"), Data.Specular);
+	Program.SetUint(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "attenuation"), Data.Attenuation);
+}
+
+void GL::UniformMaterial(program& Program, const char* MaterialUniformName, const material& Material)
+{
+	Program.Use();
+	char Name[255];
+	size_t PrefixLength = snprintf(Name, ARRAY_SIZE(Name), "%s.", MaterialUniformName);
+
+	Program.SetVec3(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "ambient"), Material.Ambient);
+	Program.SetVec3(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "diffuse"), Material.Diffuse);
+	Program.SetVec3(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "specular"), Material.Specular);
+	Program.SetVec3(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "emission"), Material.Emission);
+	Program.SetFloat(MemberName(Name, ARRAY_SIZE(Name), PrefixLength, "shininess"), Material.Shininess);
+}
+
 void GL::UniformLight(GLuint Program, const char* LightUniformName, const light& Light)
 {
 	glUseProgram(Program);
 	char UniformMemberName[255];
 
-	sprintf(UniformMemberName, "%s.enabled", LightUniformName);
-	glUniform1i(glGetUniformLocation(Program, UniformMemberName), Light.Enabled);
+	light_data Data = PackLight(Light);
 
-	sprintf(UniformMemberName, "%s.viewPosition", LightUniformName);
-	glUniform4fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.Position.e);
+	sprintf(UniformMemberName, "%s.position", LightUniformName);
+	glUniform4fv(glGetUniformLocation(Program, UniformMemberName), 1, Data.Position.e);
 
 	sprintf(UniformMemberName, "%s.ambient", LightUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.Ambient.e);
+	glUniform1ui(glGetUniformLocation(Program, UniformMemberName), Data.Ambient);
 
 	sprintf(UniformMemberName, "%s.diffuse", LightUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.Diffuse.e);
+	glUniform1ui(glGetUniformLocation(Program, UniformMemberName), Data.Diffuse);
 
 	sprintf(UniformMemberName, "%s.specular", LightUniformName);
-	glUniform3fv(glGetUniformLocation(Program, UniformMemberName), 1, Light.Specular.e);
+	glUniform1ui(glGetUniformLocation(Program, UniformMemberName), Data.Specular);
 
 	sprintf(UniformMemberName, "%s.attenuation", LightUniformName);
-	glUniform1fv(glGetUniformLocation(Program, UniformMemberName), 3, Light.Attenuation.e);
+	glUniform1ui(glGetUniformLocation(Program, UniformMemberName), Data.Attenuation);
 }
 
 void GL::UniformMaterial(GLuint Program, const char* MaterialUniformName, const material& Material)
@@ -152,25 +338,233 @@ void GL::UniformMaterial(GLuint Program, const char* MaterialUniformName, const
 	glUniform1f(glGetUniformLocation(Program, UniformMemberName), Material.Shininess);
 }
 
-GLuint GL::CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading)
+// FNV-1a
+static uint64_t HashString(uint64_t Hash, const char* String)
 {
-	GLuint Shader = glCreateShader(ShaderType);
+	for (const char* C = String; *C; ++C)
+	{
+		Hash ^= (uint8_t)*C;
+		Hash *= FNV_PRIME;
+	}
+	return Hash;
+}
 
-	std::vector<const char*> Sources;
-	Sources.reserve(4);
+// Final source strings sent to the driver (version + injected code + user strings)
+// InjectLightShading adds the frame block to every stage, and the light structs/functions to the fragment shader
+static void AssembleShaderSources(std::vector<const char*>& Sources, GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading)
+{
+	Sources.reserve(5 + ShaderStrsCount);
 	Sources.push_back("#version 330 core\n");
 
 	if (InjectLightShading)
+		Sources.push_back(FrameBlockStr);
+
+	if (InjectLightShading && ShaderType == GL_FRAGMENT_SHADER)
 	{
-		Sources.push_back(ShaderStructsDefinitionsStr);
+		Sources.push_back(ShaderStructsDefinitions().c_str());
 		Sources.push_back(PhongLightingStr);
 	}
 	for (int i = 0; i < ShaderStrsCount; ++i)
 		Sources.push_back(ShaderStrs[i]);
+}
+
+static uint64_t HashProgramSources(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading)
+{
+	std::vector<const char*> VSSources;
+	std::vector<const char*> FSSources;
+	AssembleShaderSources(VSSources, GL_VERTEX_SHADER, VSStringsCount, VSStrings, InjectLightShading);
+	AssembleShaderSources(FSSources, GL_FRAGMENT_SHADER, FSStringsCount, FSStrings, InjectLightShading);
+
+	uint64_t Hash = FNV_OFFSET_BASIS;
+	for (const char* Source : VSSources)
+		Hash = HashString(Hash, Source);
+	Hash = HashString(Hash, "\n// FRAGMENT SHADER\n");
+	for (const char* Source : FSSources)
+		Hash = HashString(Hash, Source);
+	return Hash;
+}
+
+// Binaries get their own directory, one file per source hash (a driver update overwrites them)
+static const char* PROGRAM_CACHE_DIRECTORY = "media/program_cache";
+
+static std::string GetProgramCacheFilename(uint64_t ProgramHash)
+{
+	char Filename[64];
+	snprintf(Filename, ARRAY_SIZE(Filename), "%s/%016llx.cache", PROGRAM_CACHE_DIRECTORY, (unsigned long long)ProgramHash);
+	return Filename;
+}
+
+// Fails silently if the directory already exists
+static void CreateProgramCacheDirectory()
+{
+#if defined(_WIN32)
+	_mkdir(PROGRAM_CACHE_DIRECTORY);
+#else
+	mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+#endif
+}
+
+// Uniform block bindings are reset by each link (no layout(binding) in glsl 330)
+static void BindInjectedBlocks(GLuint Program)
+{
+	GLuint FrameBlockIndex = glGetUniformBlockIndex(Program, "uFrameBlock");
+	if (FrameBlockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(Program, FrameBlockIndex, FRAME_BLOCK_BINDING_POINT);
+}
+
+// Returns 0 if the binary is missing or rejected by the driver
+static GLuint LoadProgramBinaryFromCache(uint64_t ProgramHash)
+{
+	if (!gExtensions.ProgramBinary)
+		return 0;
+
+	std::string CachedFile = GetProgramCacheFilename(ProgramHash);
+	FILE* File = fopen(CachedFile.c_str(), "rb");
+	if (File == nullptr)
+		return 0;
+
+	fseek(File, 0, SEEK_END);
+	long FileSize = ftell(File);
+	fseek(File, 0, SEEK_SET);
+
+	// Header: source hash, driver string, binary format and length
+	// Hash and driver must match, and the length must match the rest of the file, otherwise the file is stale or corrupted
+	uint64_t FileHash = 0;
+	uint32_t DriverLength = 0;
+	std::string Driver;
+	GLenum BinaryFormat = 0;
+	GLint BinaryLength = 0;
+	bool Valid = fread(&FileHash, sizeof(uint64_t), 1, File) == 1
+		&& FileHash == ProgramHash
+		&& fread(&DriverLength, sizeof(uint32_t), 1, File) == 1
+		&& DriverLength == gExtensions.Driver.size();
+	if (Valid)
+	{
+		Driver.resize(DriverLength);
+		Valid = fread(&Driver[0], 1, DriverLength, File) == DriverLength
+			&& Driver == gExtensions.Driver
+			&& fread(&BinaryFormat, sizeof(GLenum), 1, File) == 1
+			&& fread(&BinaryLength, sizeof(GLint), 1, File) == 1
+			&& BinaryLength > 0
+			&& BinaryLength <= FileSize - ftell(File);
+	}
+
+	std::vector<uint8_t> Binary;
+	if (Valid)
+	{
+		Binary.resize(BinaryLength);
+		Valid = fread(Binary.data(), 1, BinaryLength, File) == (size_t)BinaryLength;
+	}
+	fclose(File);
+
+	if (!Valid)
+	{
+		remove(CachedFile.c_str());
+		return 0;
+	}
+
+	GLuint Program = glCreateProgram();
+	gExtensions.LoadProgramBinary(Program, BinaryFormat, Binary.data(), BinaryLength);
+
+	GLint LinkStatus;
+	glGetProgramiv(Program, GL_LINK_STATUS, &LinkStatus);
+	if (LinkStatus == GL_FALSE)
+	{
+		glDeleteProgram(Program);
+		return 0;
+	}
+
+	BindInjectedBlocks(Program);
+	return Program;
+}
+
+static void SaveProgramBinaryToCache(GLuint Program, uint64_t ProgramHash)
+{
+	if (!gExtensions.ProgramBinary)
+		return;
+
+	GLint BinaryLength = 0;
+	glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &BinaryLength);
+	if (BinaryLength == 0)
+		return;
+
+	GLenum BinaryFormat = 0;
+	std::vector<uint8_t> Binary(BinaryLength);
+	gExtensions.GetProgramBinary(Program, BinaryLength, nullptr, &BinaryFormat, Binary.data());
+
+	CreateProgramCacheDirectory();
+	std::string CachedFile = GetProgramCacheFilename(ProgramHash);
+	FILE* File = fopen(CachedFile.c_str(), "wb");
+	if (File == nullptr)
+		return;
+
+	uint32_t DriverLength = (uint32_t)gExtensions.Driver.size();
+	fwrite(&ProgramHash, sizeof(uint64_t), 1, File);
+	fwrite(&DriverLength, sizeof(uint32_t), 1, File);
+	fwrite(gExtensions.Driver.data(), 1, DriverLength, File);
+	fwrite(&BinaryFormat, sizeof(GLenum), 1, File);
+	fwrite(&BinaryLength, sizeof(GLint), 1, File);
+	fwrite(Binary.data(), 1, BinaryLength, File);
+	fclose(File);
+}
+
+// Needs the current context (glfwGetProcAddress)
+static void LoadExtensions()
+{
+	gExtensions = {};
+	gExtensions.Loaded = true;
+
+	GLint ExtensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &ExtensionCount);
+	bool HasProgramBinaryExtension = (GLVersion.major > 4) || (GLVersion.major == 4 && GLVersion.minor >= 1);
+	const char* ParallelCompileFunctionName = nullptr;
+	for (int i = 0; i < ExtensionCount; ++i)
+	{
+		const char* Extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (strcmp(Extension, "GL_ARB_get_program_binary") == 0)
+			HasProgramBinaryExtension = true;
+		else if (strcmp(Extension, "GL_KHR_parallel_shader_compile") == 0)
+			ParallelCompileFunctionName = "glMaxShaderCompilerThreadsKHR";
+		else if (strcmp(Extension, "GL_ARB_parallel_shader_compile") == 0 && ParallelCompileFunctionName == nullptr)
+			ParallelCompileFunctionName = "glMaxShaderCompilerThreadsARB";
+	}
+
+	// Some drivers expose the extension without any binary format
+	GLint ProgramBinaryFormatCount = 0;
+	if (HasProgramBinaryExtension)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &ProgramBinaryFormatCount);
+
+	gExtensions.GetProgramBinary  = (gl_get_program_binary_proc)glfwGetProcAddress("glGetProgramBinary");
+	gExtensions.LoadProgramBinary = (gl_program_binary_proc)glfwGetProcAddress("glProgramBinary");
+	gExtensions.ProgramParameteri = (gl_program_parameteri_proc)glfwGetProcAddress("glProgramParameteri");
+	gExtensions.ProgramBinary = ProgramBinaryFormatCount > 0
+		&& gExtensions.GetProgramBinary && gExtensions.LoadProgramBinary && gExtensions.ProgramParameteri;
+
+	// Let the driver choose how many compiler threads to use
+	if (ParallelCompileFunctionName)
+		gExtensions.MaxShaderCompilerThreads = (gl_max_shader_compiler_threads_proc)glfwGetProcAddress(ParallelCompileFunctionName);
+	gExtensions.ParallelShaderCompile = (gExtensions.MaxShaderCompilerThreads != nullptr);
+	if (gExtensions.ParallelShaderCompile)
+		gExtensions.MaxShaderCompilerThreads(0xFFFFFFFF);
+
+	gExtensions.Driver = std::string((const char*)glGetString(GL_VENDOR)) + "\n" + (const char*)glGetString(GL_RENDERER) + "\n" + (const char*)glGetString(GL_VERSION);
+}
+
+static GLuint SubmitShader(GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading)
+{
+	GLuint Shader = glCreateShader(ShaderType);
+
+	std::vector<const char*> Sources;
+	AssembleShaderSources(Sources, ShaderType, ShaderStrsCount, ShaderStrs, InjectLightShading);
 
 	glShaderSource(Shader, (GLsizei)Sources.size(), &Sources[0], nullptr);
 	glCompileShader(Shader);
 
+	return Shader;
+}
+
+static void CheckShaderCompileStatus(GLuint Shader)
+{
 	GLint CompileStatus;
 	glGetShaderiv(Shader, GL_COMPILE_STATUS, &CompileStatus);
 	if (CompileStatus == GL_FALSE)
@@ -179,6 +573,45 @@ GLuint GL::CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char**
 		glGetShaderInfoLog(Shader, ARRAY_SIZE(Infolog), nullptr, Infolog);
 		fprintf(stderr, "Shader error: %s\n", Infolog);
 	}
+}
+
+// Without KHR_parallel_shader_compile, querying the status blocks until the link is done
+static bool IsPendingProgramCompleted(const pending_program& Pending)
+{
+	if (!gExtensions.ParallelShaderCompile)
+		return true;
+
+	GLint Completed = GL_FALSE;
+	glGetProgramiv(Pending.Program, GL_COMPLETION_STATUS_KHR, &Completed);
+	return Completed == GL_TRUE;
+}
+
+static void FinishPendingProgram(const pending_program& Pending)
+{
+	CheckShaderCompileStatus(Pending.VertexShader);
+	CheckShaderCompileStatus(Pending.FragmentShader);
+	glDeleteShader(Pending.VertexShader);
+	glDeleteShader(Pending.FragmentShader);
+
+	GLint LinkStatus;
+	glGetProgramiv(Pending.Program, GL_LINK_STATUS, &LinkStatus);
+	if (LinkStatus == GL_FALSE)
+	{
+		char Infolog[1024];
+		glGetProgramInfoLog(Pending.Program, ARRAY_SIZE(Infolog), nullptr, Infolog);
+		fprintf(stderr, "Program link error: %s\n", Infolog);
+	}
+	else
+	{
+		BindInjectedBlocks(Pending.Program);
+		SaveProgramBinaryToCache(Pending.Program, Pending.Hash);
+	}
+}
+
+GLuint GL::CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading)
+{
+	GLuint Shader = SubmitShader(ShaderType, ShaderStrsCount, ShaderStrs, InjectLightShading);
+	CheckShaderCompileStatus(Shader);
 
 	return Shader;
 }
@@ -188,20 +621,97 @@ GLuint GL::CompileShader(GLenum ShaderType, const char* ShaderStr, bool InjectLi
 	return GL::CompileShaderEx(ShaderType, 1, &ShaderStr, InjectLightShading);
 }
 
-GLuint GL::CreateProgramEx(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading)
+GLuint GL::CreateProgramAsync(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading)
 {
-	GLuint Program = glCreateProgram();
+	if (!gExtensions.Loaded)
+		LoadExtensions();
+
+	// Use the binary linked by a previous launch if the sources and the driver did not change
+	uint64_t ProgramHash = HashProgramSources(VSStringsCount, VSStrings, FSStringsCount, FSStrings, InjectLightShading);
+	GLuint Program = LoadProgramBinaryFromCache(ProgramHash);
+	if (Program)
+		return Program;
+
+	Program = glCreateProgram();
+	if (gExtensions.ProgramBinary)
+		gExtensions.ProgramParameteri(Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	// Submit compiles and link without querying any status (the driver can work in background)
+	pending_program Pending = {};
+	Pending.Program = Program;
+	Pending.VertexShader = SubmitShader(GL_VERTEX_SHADER, VSStringsCount, VSStrings, InjectLightShading);
+	Pending.FragmentShader = SubmitShader(GL_FRAGMENT_SHADER, FSStringsCount, FSStrings, InjectLightShading);
+	Pending.Hash = ProgramHash;
+
+	glAttachShader(Program, Pending.VertexShader);
+	glAttachShader(Program, Pending.FragmentShader);
+	glLinkProgram(Program);
 
-	GLuint VertexShader = GL::CompileShaderEx(GL_VERTEX_SHADER, VSStringsCount, VSStrings);
-	GLuint FragmentShader = GL::CompileShaderEx(GL_FRAGMENT_SHADER, FSStringsCount, FSStrings, InjectLightShading);
+	gPendingPrograms.push_back(Pending);
 
-	glAttachShader(Program, VertexShader);
-	glAttachShader(Program, FragmentShader);
+	return Program;
+}
 
-	glLinkProgram(Program);
+bool GL::IsProgramReady(GLuint Program, bool Wait)
+{
+	for (size_t i = 0; i < gPendingPrograms.size(); ++i)
+	{
+		if (gPendingPrograms[i].Program != Program)
+			continue;
 
-	glDeleteShader(VertexShader);
-	glDeleteShader(FragmentShader);
+		// Link status queries in FinishPendingProgram block until the link is done
+		if (!Wait && !IsPendingProgramCompleted(gPendingPrograms[i]))
+			return false;
+
+		FinishPendingProgram(gPendingPrograms[i]);
+		gPendingPrograms.erase(gPendingPrograms.begin() + i);
+		return true;
+	}
+
+	return true;
+}
+
+void GL::DeleteProgram(GLuint Program)
+{
+	// Pending shaders are only attached to this program, drop them without reporting errors
+	for (size_t i = 0; i < gPendingPrograms.size(); ++i)
+	{
+		if (gPendingPrograms[i].Program == Program)
+		{
+			glDeleteShader(gPendingPrograms[i].VertexShader);
+			glDeleteShader(gPendingPrograms[i].FragmentShader);
+			gPendingPrograms.erase(gPendingPrograms.begin() + i);
+			break;
+		}
+	}
+
+	glDeleteProgram(Program);
+}
+
+int GL::UpdatePendingPrograms()
+{
+	for (size_t i = 0; i < gPendingPrograms.size(); )
+	{
+		if (IsPendingProgramCompleted(gPendingPrograms[i]))
+		{
+			FinishPendingProgram(gPendingPrograms[i]);
+			gPendingPrograms.erase(gPendingPrograms.begin() + i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	return (int)gPendingPrograms.size();
+}
+
+GLuint GL::CreateProgramEx(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading)
+{
+	GLuint Program = GL::CreateProgramAsync(VSStringsCount, VSStrings, FSStringsCount, FSStrings, InjectLightShading);
+
+	// Blocking version: wait for this program only
+	GL::IsProgramReady(Program, true);
 
 	return Program;
 }
@@ -213,7 +723,41 @@ GLuint GL::CreateProgram(const char* VSString, const char* FSString, bool Inject
 
 const char* GL::GetShaderStructsDefinitions()
 {
-	return ShaderStructsDefinitionsStr;
+	return ShaderStructsDefinitions().c_str();
+}
+
+frame_block::frame_block()
+{
+	glGenBuffers(1, &Buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, Buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_data), nullptr, GL_DYNAMIC_DRAW);
+}
+
+frame_block::~frame_block()
+{
+	glDeleteBuffers(1, &Buffer);
+}
+
+void frame_block::SetTime(double Time, double DeltaTime)
+{
+	Data.Time = (float)Time;
+	Data.DeltaTime = (float)DeltaTime;
+}
+
+void frame_block::SetView(const mat4& Projection, const mat4& View)
+{
+	Data.View = View;
+	Data.Projection = Projection;
+	Data.ViewProj = Projection * View;
+	Data.ViewPosition = Mat4::Inverse(View).c[3];
+
+	GLint Viewport[4];
+	glGetIntegerv(GL_VIEWPORT, Viewport);
+	Data.Viewport = { (float)Viewport[0], (float)Viewport[1], (float)Viewport[2], (float)Viewport[3] };
+
+	glBindBuffer(GL_UNIFORM_BUFFER, Buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame_data), &Data);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING_POINT, Buffer);
 }
 
 void GL::UploadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
@@ -280,7 +824,7 @@ void GL::UploadTexture(const char* Filename, int ImageFlags, int* WidthOut, int*
     stbi_set_flip_vertically_on_load(0); // Always reset to default value
 }
 
-void GL::UploadCubemapTexture(std::vector<std::string> Filename, int ImageFlags, int* WidthOut, int* HeightOut)
+void GL::UploadCubemapTexture(std::vector<std::string> Filename, int ImageFlags, int* WidthOut, int* HeightOut, sh9* SHOut)
 {
 	// Flip
 	stbi_set_flip_vertically_on_load((ImageFlags & IMG_FLIP) ? 1 : 0);
@@ -333,6 +877,10 @@ void GL::UploadCubemapTexture(std::vector<std::string> Filename, int ImageFlags,
 		GL_RGBA
 	};
 
+	// Diffuse ambient
+	if (SHOut)
+		*SHOut = ProjectCubemapSH(Images.data(), Width, Height, Channels);
+
 	// Uploading
 	for (int i = 0; i < 6; i++)
 	{
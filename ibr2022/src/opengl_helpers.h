@@ -3,6 +3,9 @@
 #include "opengl_headers.h"
 #include "types.h"
 #include "opengl_helpers_cache.h"
+#include "opengl_helpers_program.h"
+#include "opengl_helpers_sh.h"
+#include "opengl_helpers_std140.h"
 #include "opengl_helpers_wireframe.h"
 
 enum image_flags
@@ -17,7 +20,7 @@ enum image_flags
 
 namespace GL
 {
-    // Same memory layout than 'struct light' in glsl shader
+    // Light as edited on the CPU (layout kept for code built against it), packed with PackLight before upload
     struct light
     {
         alignas(16) int Enabled;
@@ -28,16 +31,88 @@ namespace GL
         alignas(16) v3 Attenuation;
     };
 
-    // Same memory layout than 'struct material' in glsl shader
-    struct alignas(16) material
+    // Packed light, 'struct light' in glsl shader (32 bytes instead of 96 per light in uniform blocks)
+    struct light_data
     {
-        v4 Ambient;
-        v4 Diffuse;
-        v4 Specular;
-        v4 Emission;
+        v4 Position;
+        uint32_t Ambient;     // RGBA8, alpha is the enabled flag
+        uint32_t Diffuse;     // RGB8, alpha: low byte of the quadratic attenuation (half float)
+        uint32_t Specular;    // RGB8, alpha: high byte of the quadratic attenuation (half float)
+        uint32_t Attenuation; // 2x half float (constant, linear)
+    };
+
+    constexpr Std140::member LightDataLayout[] =
+    {
+        STD140_MEMBER(light_data, Position,    "position",    "w = 0: directional light"),
+        STD140_MEMBER(light_data, Ambient,     "ambient",     "RGBA8, alpha: enabled"),
+        STD140_MEMBER(light_data, Diffuse,     "diffuse",     "RGB8, alpha: quadratic attenuation low byte"),
+        STD140_MEMBER(light_data, Specular,    "specular",    "RGB8, alpha: quadratic attenuation high byte"),
+        STD140_MEMBER(light_data, Attenuation, "attenuation", "2x half (constant, linear)"),
+    };
+    static_assert(Std140::Matches(LightDataLayout, sizeof(light_data)), "light_data does not match 'struct light' std140 layout");
+
+    light_data PackLight(const light& Light);
+
+    // light_shade skips a light once its attenuation drops under this value (below 8 bits precision for a unit intensity)
+    const float LIGHT_ATTENUATION_CUTOFF = 1.f / 256.f;
+
+    // Distance where the light_shade attenuation drops under Cutoff (infinite for directional lights)
+    float GetLightRadius(const light& Light, float Cutoff = LIGHT_ATTENUATION_CUTOFF);
+
+    // 'struct material' in glsl shader
+    struct material
+    {
+        v3 Ambient;
+        float Padding0;
+        v3 Diffuse;
+        float Padding1;
+        v3 Specular;
+        float Padding2;
+        v3 Emission;
         float Shininess;
     };
 
+    constexpr Std140::member MaterialLayout[] =
+    {
+        STD140_MEMBER(material, Ambient,   "ambient",   ""),
+        STD140_MEMBER(material, Diffuse,   "diffuse",   ""),
+        STD140_MEMBER(material, Specular,  "specular",  ""),
+        STD140_MEMBER(material, Emission,  "emission",  ""),
+        STD140_MEMBER(material, Shininess, "shininess", ""),
+    };
+    static_assert(Std140::Matches(MaterialLayout, sizeof(material)), "material does not match 'struct material' std140 layout");
+
+    // Uniform block injected by InjectLightShading (uFrame in glsl), bound automatically to this binding point
+    const GLuint FRAME_BLOCK_BINDING_POINT = 1;
+
+    // Same memory layout than 'uFrameBlock' in glsl shader (std140)
+    struct frame_data
+    {
+        mat4 View;
+        mat4 Projection;
+        mat4 ViewProj;
+        v4 ViewPosition; // World space
+        v4 Viewport;     // x, y, width, height
+        float Time;
+        float DeltaTime;
+        float Padding[2];
+    };
+
+    // Per-frame/per-view uniform buffer, uploaded once per view instead of setting matrices in each program
+    class frame_block
+    {
+    public:
+        frame_block();
+        ~frame_block();
+
+        void SetTime(double Time, double DeltaTime);
+        // Upload a view (viewport is read from GL state) and bind the buffer to FRAME_BLOCK_BINDING_POINT
+        void SetView(const mat4& Projection, const mat4& View);
+
+        GLuint Buffer = 0;
+        frame_data Data = {};
+    };
+
     class debug
     {
     public:
@@ -54,14 +129,27 @@ namespace GL
         GL::wireframe_renderer Wireframe;
     };
 
+    void UniformLight(program& Program, const char* LightUniformName, const light& Light);
+    void UniformMaterial(program& Program, const char* MaterialUniformName, const material& Material);
+    // Raw program versions (no location cache)
     void UniformLight(GLuint Program, const char* LightUniformName, const light& Light);
     void UniformMaterial(GLuint Program, const char* MaterialUniformName, const material& Material);
     GLuint CompileShader(GLenum ShaderType, const char* ShaderStr, bool InjectLightShading = false);
     GLuint CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char** ShaderStrs, bool InjectLightShading = false);
     GLuint CreateProgram(const char* VSString, const char* FSString, bool InjectLightShading = false);
     GLuint CreateProgramEx(int VSStringsCount, const char** VSStrings, int FSStringCount, const char** FSString, bool InjectLightShading = false);
+
+    // Non-blocking program creation: compiles and link are submitted to the driver but no status is queried,
+    // errors are reported (and the binary cached) once the program is polled by IsProgramReady/UpdatePendingPrograms
+    // Using the program before it is ready is valid GL but blocks until the link is done
+    GLuint CreateProgramAsync(int VSStringsCount, const char** VSStrings, int FSStringCount, const char** FSString, bool InjectLightShading = false);
+    bool IsProgramReady(GLuint Program, bool Wait = false); // Wait: block until the link is done (always returns true)
+    void DeleteProgram(GLuint Program); // glDeleteProgram, also drops the program from the pending list if still compiling
+    int UpdatePendingPrograms(); // Polled by GL::program::IsReady, returns the number of programs still compiling
+
     const char* GetShaderStructsDefinitions();
     void UploadTexture(const char* Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
-    void UploadCubemapTexture(std::vector<std::string> Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
+    // SHOut: diffuse ambient projected from the faces while they are in RAM (see ProjectCubemapSH)
+    void UploadCubemapTexture(std::vector<std::string> Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr, sh9* SHOut = nullptr);
     void UploadCheckerboardTexture(int Width, int Height, int SquareSize);
 }
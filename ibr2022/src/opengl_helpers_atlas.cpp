@@ -0,0 +1,212 @@
+#include <cstdio>
+#include <cstring>
+
+#include <stb_image.h>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../externals/imgui/imstb_rectpack.h"
+
+#include "maths.h"
+
+#include "opengl_helpers.h"
+
+#include "opengl_helpers_atlas.h"
+
+using namespace GL;
+
+// Images are packed on a grid of power of two cells at least as large as the gutter,
+// the mip chain is clamped so that a cell never shrinks below one texel
+static int GetGridAlignment(int Gutter)
+{
+	int Alignment = 1;
+	while (Alignment < Gutter)
+		Alignment *= 2;
+	return Alignment;
+}
+
+static int GetMaxMipLevel(int Alignment)
+{
+	int Level = 0;
+	while ((1 << Level) < Alignment)
+		++Level;
+	return Level;
+}
+
+int atlas_builder::AddImage(const char* Filename, int ImageFlags)
+{
+	stbi_set_flip_vertically_on_load((ImageFlags & IMG_FLIP) ? 1 : 0);
+
+	int Width, Height;
+	uint8_t* Pixels = stbi_load(Filename, &Width, &Height, nullptr, STBI_rgb_alpha);
+	stbi_set_flip_vertically_on_load(0); // Always reset to default value
+	if (Pixels == nullptr)
+	{
+		fprintf(stderr, "Image loading failed on '%s'\n", Filename);
+		return -1;
+	}
+
+	int Index = this->AddImage(Pixels, Width, Height);
+	stbi_image_free(Pixels);
+	return Index;
+}
+
+int atlas_builder::AddImage(const uint8_t* RGBAPixels, int Width, int Height)
+{
+	image Image;
+	Image.Width = Width;
+	Image.Height = Height;
+	Image.Pixels.assign(RGBAPixels, RGBAPixels + Width * Height * 4);
+	Images.push_back(std::move(Image));
+	return (int)Images.size() - 1;
+}
+
+void atlas_builder::GetImageSize(int Index, int* WidthOut, int* HeightOut) const
+{
+	if (WidthOut)  *WidthOut  = Images[Index].Width;
+	if (HeightOut) *HeightOut = Images[Index].Height;
+}
+
+void atlas_builder::Clear()
+{
+	Images.clear();
+}
+
+int atlas_builder::GetPaddedSize(int Size, int Gutter)
+{
+	int Alignment = GetGridAlignment(Gutter);
+	return (Size + 2 * Gutter + Alignment - 1) / Alignment * Alignment;
+}
+
+int atlas_builder::Pack(int LayerWidth, int LayerHeight, int Gutter, int MaxLayers, std::vector<placement>& PlacementsOut) const
+{
+	int Alignment = GetGridAlignment(Gutter);
+	int GridWidth = LayerWidth / Alignment;
+	int GridHeight = LayerHeight / Alignment;
+
+	// Rects are expressed in grid cells
+	std::vector<stbrp_rect> Remaining(Images.size());
+	for (int i = 0; i < (int)Images.size(); ++i)
+	{
+		Remaining[i] = {};
+		Remaining[i].id = i;
+		Remaining[i].w = (stbrp_coord)((Images[i].Width  + 2 * Gutter + Alignment - 1) / Alignment);
+		Remaining[i].h = (stbrp_coord)((Images[i].Height + 2 * Gutter + Alignment - 1) / Alignment);
+	}
+
+	PlacementsOut.resize(Images.size());
+	std::vector<stbrp_node> Nodes(GridWidth);
+
+	int LayerCount = 0;
+	while (!Remaining.empty())
+	{
+		if (LayerCount == MaxLayers)
+			return 0;
+
+		stbrp_context Context;
+		stbrp_init_target(&Context, GridWidth, GridHeight, Nodes.data(), (int)Nodes.size());
+		stbrp_pack_rects(&Context, Remaining.data(), (int)Remaining.size());
+
+		std::vector<stbrp_rect> NotPacked;
+		for (const stbrp_rect& Rect : Remaining)
+		{
+			if (Rect.was_packed)
+				PlacementsOut[Rect.id] = { Rect.x * Alignment, Rect.y * Alignment, LayerCount };
+			else
+				NotPacked.push_back(Rect);
+		}
+
+		// Nothing fits in an empty layer, an image is too big
+		if (NotPacked.size() == Remaining.size())
+			return 0;
+
+		Remaining.swap(NotPacked);
+		LayerCount++;
+	}
+
+	return LayerCount;
+}
+
+void atlas_builder::Blit(uint8_t* Dst, int DstWidth, const image& Image, const placement& Placement, int Gutter) const
+{
+	// Copy image and extend its borders into the gutter (clamp to edge)
+	for (int y = -Gutter; y < Image.Height + Gutter; ++y)
+	{
+		int SrcY = Math::Clamp(y, 0, Image.Height - 1);
+		uint8_t* DstRow = Dst + ((Placement.Y + Gutter + y) * DstWidth + Placement.X + Gutter) * 4;
+		const uint8_t* SrcRow = &Image.Pixels[SrcY * Image.Width * 4];
+		for (int x = -Gutter; x < Image.Width + Gutter; ++x)
+		{
+			int SrcX = Math::Clamp(x, 0, Image.Width - 1);
+			memcpy(DstRow + x * 4, SrcRow + SrcX * 4, 4);
+		}
+	}
+}
+
+void atlas_builder::FillRegions(int LayerWidth, int LayerHeight, int Gutter, const std::vector<placement>& Placements, std::vector<atlas_region>& RegionsOut) const
+{
+	RegionsOut.resize(Images.size());
+	for (int i = 0; i < (int)Images.size(); ++i)
+	{
+		const placement& Placement = Placements[i];
+		float MinX = (float)(Placement.X + Gutter);
+		float MinY = (float)(Placement.Y + Gutter);
+		RegionsOut[i].UVMin = { MinX / LayerWidth, MinY / LayerHeight };
+		RegionsOut[i].UVMax = { (MinX + Images[i].Width) / LayerWidth, (MinY + Images[i].Height) / LayerHeight };
+		RegionsOut[i].Layer = Placement.Layer;
+	}
+}
+
+bool atlas_builder::Upload2D(int AtlasWidth, int AtlasHeight, int Gutter, bool GenMipmaps, std::vector<atlas_region>& RegionsOut)
+{
+	std::vector<placement> Placements;
+	if (this->Pack(AtlasWidth, AtlasHeight, Gutter, 1, Placements) == 0)
+	{
+		fprintf(stderr, "Atlas packing failed (%d images in %dx%d)\n", (int)Images.size(), AtlasWidth, AtlasHeight);
+		return false;
+	}
+
+	std::vector<uint8_t> Texels(AtlasWidth * AtlasHeight * 4, 0);
+	for (int i = 0; i < (int)Images.size(); ++i)
+		this->Blit(&Texels[0], AtlasWidth, Images[i], Placements[i], Gutter);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, AtlasWidth, AtlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &Texels[0]);
+	if (GenMipmaps)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GetMaxMipLevel(GetGridAlignment(Gutter)));
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	this->FillRegions(AtlasWidth, AtlasHeight, Gutter, Placements, RegionsOut);
+	return true;
+}
+
+int atlas_builder::UploadArray(int LayerWidth, int LayerHeight, int Gutter, bool GenMipmaps, std::vector<atlas_region>& RegionsOut)
+{
+	std::vector<placement> Placements;
+	int LayerCount = this->Pack(LayerWidth, LayerHeight, Gutter, INT32_MAX, Placements);
+	if (LayerCount == 0)
+	{
+		fprintf(stderr, "Atlas packing failed (%d images in %dx%d layers)\n", (int)Images.size(), LayerWidth, LayerHeight);
+		return 0;
+	}
+
+	int LayerSize = LayerWidth * LayerHeight * 4;
+	std::vector<uint8_t> Texels(LayerSize * LayerCount, 0);
+	for (int i = 0; i < (int)Images.size(); ++i)
+		this->Blit(&Texels[Placements[i].Layer * LayerSize], LayerWidth, Images[i], Placements[i], Gutter);
+
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, LayerWidth, LayerHeight, LayerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, &Texels[0]);
+	if (GenMipmaps)
+	{
+		// One image per layer: nothing to bleed into, keep the full mip chain
+		int MaxLevel = GetMaxMipLevel(GetGridAlignment(Gutter));
+		if (LayerCount == (int)Images.size())
+			MaxLevel = GetMaxMipLevel(Math::Max(LayerWidth, LayerHeight));
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, MaxLevel);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+
+	this->FillRegions(LayerWidth, LayerHeight, Gutter, Placements, RegionsOut);
+	return LayerCount;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "opengl_headers.h"
+#include "types.h"
+
+namespace GL
+{
+	// Location of a packed image inside an atlas
+	struct atlas_region
+	{
+		v2 UVMin;
+		v2 UVMax;
+		int Layer; // Texture array layer (always 0 for 2D atlases)
+	};
+
+	// Packs many small images into a shared 2D texture or 2D texture array (using stb_rectpack)
+	// Every image is surrounded by a gutter of replicated border texels and aligned on a gutter sized grid,
+	// so bilinear filtering and the first mip levels never bleed between neighbours
+	class atlas_builder
+	{
+	public:
+		// Returns the image index (used to index the regions returned by Upload2D/UploadArray)
+		int AddImage(const char* Filename, int ImageFlags = 0);
+		int AddImage(const uint8_t* RGBAPixels, int Width, int Height);
+		void GetImageSize(int Index, int* WidthOut, int* HeightOut) const;
+		void Clear();
+
+		// Space taken by an image side with its gutters, rounded up to the packing grid (to size atlases exactly)
+		static int GetPaddedSize(int Size, int Gutter);
+
+		// Upload into the currently bound GL_TEXTURE_2D, returns false if the images do not fit
+		bool Upload2D(int AtlasWidth, int AtlasHeight, int Gutter, bool GenMipmaps, std::vector<atlas_region>& RegionsOut);
+
+		// Upload into the currently bound GL_TEXTURE_2D_ARRAY, returns the layer count (0 if an image is bigger than a layer)
+		int UploadArray(int LayerWidth, int LayerHeight, int Gutter, bool GenMipmaps, std::vector<atlas_region>& RegionsOut);
+
+	private:
+		struct image
+		{
+			std::vector<uint8_t> Pixels; // RGBA8
+			int Width;
+			int Height;
+		};
+
+		struct placement
+		{
+			int X;
+			int Y;
+			int Layer;
+		};
+
+		int Pack(int LayerWidth, int LayerHeight, int Gutter, int MaxLayers, std::vector<placement>& PlacementsOut) const;
+		void Blit(uint8_t* Dst, int DstWidth, const image& Image, const placement& Placement, int Gutter) const;
+		void FillRegions(int LayerWidth, int LayerHeight, int Gutter, const std::vector<placement>& Placements, std::vector<atlas_region>& RegionsOut) const;
+
+		std::vector<image> Images;
+	};
+}
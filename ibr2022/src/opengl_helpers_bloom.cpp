@@ -0,0 +1,212 @@
+#include "maths.h"
+
+#include "opengl_helpers_bloom.h"
+
+using namespace GL;
+
+#pragma region bloom_shaders
+// Fullscreen triangle
+static const char* gVertexShaderStr = R"GLSL(
+out vec2 vUV;
+
+void main()
+{
+    vUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+})GLSL";
+
+// 13 taps downsample (box filters of 4 texels on 5 overlapping blocks), PREFILTER adds the Karis average and the threshold
+static const char* gFragmentDownsampleShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uSource;
+uniform float uThreshold;
+uniform float uKnee;
+
+out vec4 oColor;
+
+#if defined(PREFILTER)
+// Weight by inverse luma, a single very bright texel cannot flicker the whole bloom
+vec3 karis_average(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    vec4 sum = vec4(0.0);
+    vec3 samples[4] = vec3[](a, b, c, d);
+    for (int i = 0; i < 4; ++i)
+    {
+        float weight = 1.0 / (1.0 + dot(samples[i], vec3(0.2126, 0.7152, 0.0722)));
+        sum += vec4(samples[i] * weight, weight);
+    }
+    return sum.rgb / sum.a;
+}
+#endif
+
+vec3 block(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+#if defined(PREFILTER)
+    return karis_average(a, b, c, d);
+#else
+    return (a + b + c + d) * 0.25;
+#endif
+}
+
+void main()
+{
+    vec2 t = 1.0 / vec2(textureSize(uSource, 0));
+    vec3 a = texture(uSource, vUV + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(uSource, vUV + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(uSource, vUV + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(uSource, vUV + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(uSource, vUV).rgb;
+    vec3 f = texture(uSource, vUV + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(uSource, vUV + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(uSource, vUV + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(uSource, vUV + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(uSource, vUV + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(uSource, vUV + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(uSource, vUV + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(uSource, vUV + t * vec2( 1.0, -1.0)).rgb;
+
+    vec3 color = block(j, k, l, m) * 0.5
+               + (block(a, b, d, e) + block(b, c, e, f) + block(d, e, g, h) + block(e, f, h, i)) * 0.125;
+
+#if defined(PREFILTER)
+    // Soft threshold (quadratic knee)
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - uThreshold + uKnee, 0.0, 2.0 * uKnee);
+    soft = soft * soft / (4.0 * uKnee + 1e-5);
+    color *= max(soft, brightness - uThreshold) / max(brightness, 1e-5);
+#endif
+
+    oColor = vec4(color, 1.0);
+})GLSL";
+
+// 3x3 tent upsample of the smaller level, added to the current level
+static const char* gFragmentUpsampleShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uSource;
+uniform sampler2D uCurrent;
+uniform float uRadius;
+
+out vec4 oColor;
+
+void main()
+{
+    vec2 t = uRadius / vec2(textureSize(uSource, 0));
+    vec3 sum = texture(uSource, vUV).rgb * 4.0;
+    sum += (texture(uSource, vUV + vec2(-t.x, 0.0)).rgb + texture(uSource, vUV + vec2(t.x, 0.0)).rgb
+          + texture(uSource, vUV + vec2(0.0, -t.y)).rgb + texture(uSource, vUV + vec2(0.0, t.y)).rgb) * 2.0;
+    sum += texture(uSource, vUV - t).rgb + texture(uSource, vUV + t).rgb
+         + texture(uSource, vUV + vec2(-t.x, t.y)).rgb + texture(uSource, vUV + vec2(t.x, -t.y)).rgb;
+
+    oColor = vec4(texture(uCurrent, vUV).rgb + sum / 16.0, 1.0);
+})GLSL";
+#pragma endregion bloom_shaders
+
+bloom::bloom()
+{
+	const char* PrefilterStrings[2] = { "#define PREFILTER\n", gFragmentDownsampleShaderStr };
+	PrefilterProgram.Create(1, &gVertexShaderStr, 2, PrefilterStrings);
+	DownsampleProgram.Create(gVertexShaderStr, gFragmentDownsampleShaderStr);
+	UpsampleProgram.Create(gVertexShaderStr, gFragmentUpsampleShaderStr);
+	glGenVertexArrays(1, &EmptyVAO);
+}
+
+bloom::~bloom()
+{
+	glDeleteVertexArrays(1, &EmptyVAO);
+}
+
+render_graph::resource bloom::AddPasses(render_graph& Graph, render_graph::resource Source)
+{
+	PassCount = 0;
+	UsedLevelCount = 0;
+	if (!PrefilterProgram.IsReady() || !DownsampleProgram.IsReady() || !UpsampleProgram.IsReady())
+		return -1;
+
+	// Level 0 is half resolution, stop before levels get smaller than a few texels
+	render_target_desc SourceDesc = Graph.GetDesc(Source);
+	render_graph::resource Levels[MAX_LEVELS];
+	int Widths[MAX_LEVELS];
+	int Heights[MAX_LEVELS];
+	int Width = SourceDesc.Width;
+	int Height = SourceDesc.Height;
+	int MaxLevels = Math::Clamp(LevelCount, 1, MAX_LEVELS);
+	while (UsedLevelCount < MaxLevels && Width >= 8 && Height >= 8)
+	{
+		Width /= 2;
+		Height /= 2;
+		Widths[UsedLevelCount] = Width;
+		Heights[UsedLevelCount] = Height;
+		UsedLevelCount++;
+	}
+	if (UsedLevelCount == 0)
+		return -1;
+
+	GLuint VAO = EmptyVAO;
+	float PassThreshold = Threshold;
+	float PassKnee = Math::Max(Knee, 0.f);
+	float PassRadius = Radius;
+
+	// Downsample chain
+	render_graph::resource Current = Source;
+	for (int i = 0; i < UsedLevelCount; ++i)
+	{
+		program* Program = (i == 0) ? &PrefilterProgram : &DownsampleProgram;
+		render_graph::resource Input = Current;
+		render_graph::resource Output = Graph.Create("Bloom downsample", { Widths[i], Heights[i], GL_R11F_G11F_B10F });
+		int Pass = Graph.AddPass("Bloom downsample", [=](render_graph& PassGraph)
+		{
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			Program->Use();
+			Program->SetInt("uSource", 0);
+			Program->SetFloat("uThreshold", PassThreshold);
+			Program->SetFloat("uKnee", PassKnee);
+			PassGraph.BindFramebuffer(Output);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Input));
+			glBindVertexArray(VAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		});
+		Graph.Read(Pass, Input);
+		Graph.Write(Pass, Output);
+		PassCount++;
+
+		Levels[i] = Output;
+		Current = Output;
+	}
+
+	// Upsample chain: each level = its downsample + tent(smaller level)
+	for (int i = UsedLevelCount - 2; i >= 0; --i)
+	{
+		render_graph::resource Smaller = Current;
+		render_graph::resource Level = Levels[i];
+		render_graph::resource Output = Graph.Create("Bloom upsample", { Widths[i], Heights[i], GL_R11F_G11F_B10F });
+		program* Program = &UpsampleProgram;
+		int Pass = Graph.AddPass("Bloom upsample", [=](render_graph& PassGraph)
+		{
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			Program->Use();
+			Program->SetInt("uSource", 0);
+			Program->SetInt("uCurrent", 1);
+			Program->SetFloat("uRadius", PassRadius);
+			PassGraph.BindFramebuffer(Output);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Level));
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Smaller));
+			glBindVertexArray(VAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		});
+		Graph.Read(Pass, Smaller);
+		Graph.Read(Pass, Level);
+		Graph.Write(Pass, Output);
+		PassCount++;
+
+		Current = Output;
+	}
+
+	return Current;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "opengl_headers.h"
+#include "opengl_helpers_program.h"
+#include "opengl_helpers_render_graph.h"
+
+namespace GL
+{
+	// Bloom passes added to a render graph, all targets R11F_G11F_B10F:
+	//  - prefilter: 13 taps downsample (Karis average against fireflies) + soft threshold into a half resolution target
+	//  - downsample chain: LevelCount - 1 more 13 taps downsamples
+	//  - upsample chain: 3x3 tent upsample of the smaller level added to each level, back to half resolution
+	// The result is added to the scene by the uber post-process (POSTPROCESS_BLOOM)
+	class bloom
+	{
+	public:
+		static const int MAX_LEVELS = 8;
+
+		bloom();
+		~bloom();
+
+		// Returns the half resolution bloom, -1 while the programs compile
+		render_graph::resource AddPasses(render_graph& Graph, render_graph::resource Source);
+
+		float Threshold = 1.f; // Linear brightness where bloom starts
+		float Knee = 0.5f;     // Soft transition below the threshold
+		float Radius = 1.f;    // Upsample tent radius (texels of the smaller level)
+		int LevelCount = 6;
+
+		// Stats of the last AddPasses
+		int PassCount = 0;
+		int UsedLevelCount = 0; // Can be less than LevelCount for small sources
+
+	private:
+		program PrefilterProgram;
+		program DownsampleProgram;
+		program UpsampleProgram;
+		GLuint EmptyVAO = 0;
+	};
+}
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "maths.h"
+
+#include "opengl_helpers_blur.h"
+
+using namespace GL;
+
+#pragma region blur_shaders
+// Fullscreen triangle
+static const char* gVertexShaderStr = R"GLSL(
+out vec2 vUV;
+
+void main()
+{
+    vUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+})GLSL";
+
+// 1D pass, taps at vUV + uStep * uOffsets[i]
+static const char* gFragmentSeparableShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uSource;
+uniform vec2 uStep;
+uniform int uTapCount;
+uniform float uOffsets[31];
+uniform float uWeights[31];
+
+out vec4 oColor;
+
+void main()
+{
+    vec4 result = vec4(0.0);
+    for (int i = 0; i < uTapCount; ++i)
+        result += texture(uSource, vUV + uStep * uOffsets[i]) * uWeights[i];
+    oColor = result;
+})GLSL";
+
+// Generic 3x3 kernel (uKernel[column][row]: column is the y offset from +uOffset to -uOffset, row the x offset)
+static const char* gFragmentKernelShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uSource;
+uniform float uOffset;
+uniform mat3 uKernel;
+
+out vec4 oColor;
+
+void main()
+{
+    vec3 result = vec3(0.0);
+    for (int i = 0; i < 9; ++i)
+    {
+        vec2 offset = vec2(float(i % 3) - 1.0, 1.0 - float(i / 3)) * uOffset;
+        result += texture(uSource, vUV + offset).rgb * uKernel[i / 3][i % 3];
+    }
+    oColor = vec4(result, 1.0);
+})GLSL";
+
+// Dual Kawase filter: 5 taps downsample, 8 taps upsample
+static const char* gFragmentDownsampleShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uSource;
+
+out vec4 oColor;
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(uSource, 0));
+    vec4 sum = texture(uSource, vUV) * 4.0;
+    sum += texture(uSource, vUV - texel);
+    sum += texture(uSource, vUV + texel);
+    sum += texture(uSource, vUV + vec2(texel.x, -texel.y));
+    sum += texture(uSource, vUV - vec2(texel.x, -texel.y));
+    oColor = sum / 8.0;
+})GLSL";
+
+static const char* gFragmentUpsampleShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uSource;
+
+out vec4 oColor;
+
+void main()
+{
+    vec2 halfTexel = 0.5 / vec2(textureSize(uSource, 0));
+    vec4 sum = texture(uSource, vUV + vec2(-halfTexel.x * 2.0, 0.0));
+    sum += texture(uSource, vUV + vec2(-halfTexel.x, halfTexel.y)) * 2.0;
+    sum += texture(uSource, vUV + vec2(0.0, halfTexel.y * 2.0));
+    sum += texture(uSource, vUV + vec2(halfTexel.x, halfTexel.y)) * 2.0;
+    sum += texture(uSource, vUV + vec2(halfTexel.x * 2.0, 0.0));
+    sum += texture(uSource, vUV + vec2(halfTexel.x, -halfTexel.y)) * 2.0;
+    sum += texture(uSource, vUV + vec2(0.0, -halfTexel.y * 2.0));
+    sum += texture(uSource, vUV + vec2(-halfTexel.x, -halfTexel.y)) * 2.0;
+    oColor = sum / 12.0;
+})GLSL";
+#pragma endregion blur_shaders
+
+bool GL::FactorSeparableKernel(const mat3& Kernel, v3* ColumnOut, v3* RowOut, float Epsilon)
+{
+	// Pivot on the largest weight
+	int PivotColumn = 0;
+	int PivotRow = 0;
+	for (int c = 0; c < 3; ++c)
+	{
+		for (int r = 0; r < 3; ++r)
+		{
+			if (fabsf(Kernel.c[c].e[r]) > fabsf(Kernel.c[PivotColumn].e[PivotRow]))
+			{
+				PivotColumn = c;
+				PivotRow = r;
+			}
+		}
+	}
+
+	float Pivot = Kernel.c[PivotColumn].e[PivotRow];
+	if (Pivot == 0.f)
+		return false;
+
+	v3 Column = { Kernel.c[0].e[PivotRow], Kernel.c[1].e[PivotRow], Kernel.c[2].e[PivotRow] };
+	v3 Row = Kernel.c[PivotColumn] * (1.f / Pivot);
+	for (int c = 0; c < 3; ++c)
+	{
+		for (int r = 0; r < 3; ++r)
+		{
+			if (fabsf(Kernel.c[c].e[r] - Column.e[c] * Row.e[r]) > Epsilon * fabsf(Pivot))
+				return false;
+		}
+	}
+
+	*ColumnOut = Column;
+	*RowOut = Row;
+	return true;
+}
+
+// Weights = Weights * Kernel (3 taps), returns the new tap count
+static int Convolve(float* Weights, int Count, const float* Kernel)
+{
+	float Result[blur::MAX_TAPS] = {};
+	for (int i = 0; i < Count; ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+			Result[i + k] += Weights[i] * Kernel[k];
+	}
+	for (int i = 0; i < Count + 2; ++i)
+		Weights[i] = Result[i];
+	return Count + 2;
+}
+
+blur::blur()
+{
+	SeparableProgram.Create(gVertexShaderStr, gFragmentSeparableShaderStr);
+	KernelProgram.Create(gVertexShaderStr, gFragmentKernelShaderStr);
+	DownsampleProgram.Create(gVertexShaderStr, gFragmentDownsampleShaderStr);
+	UpsampleProgram.Create(gVertexShaderStr, gFragmentUpsampleShaderStr);
+	glGenVertexArrays(1, &EmptyVAO);
+}
+
+blur::~blur()
+{
+	glDeleteVertexArrays(1, &EmptyVAO);
+}
+
+render_graph::resource blur::AddPass(render_graph& Graph, const char* Name, program* Program, render_graph::resource Source, int Width, int Height, const uniform_setter& SetUniforms)
+{
+	render_graph::resource Destination = Graph.Create(Name, { Width, Height, GL_RGBA16F });
+	GLuint VAO = EmptyVAO;
+	int Pass = Graph.AddPass(Name, [=](render_graph& PassGraph)
+	{
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+
+		Program->Use();
+		Program->SetInt("uSource", 0);
+		if (SetUniforms)
+			SetUniforms(*Program);
+		PassGraph.BindFramebuffer(Destination);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Source));
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	});
+	Graph.Read(Pass, Source);
+	Graph.Write(Pass, Destination);
+	PassCount++;
+	return Destination;
+}
+
+render_graph::resource blur::SeparablePass(render_graph& Graph, render_graph::resource Source, v2 Step, int TapCount, const float* Offsets, const float* Weights)
+{
+	std::array<float, MAX_TAPS> PassOffsets;
+	std::array<float, MAX_TAPS> PassWeights;
+	std::copy(Offsets, Offsets + TapCount, PassOffsets.begin());
+	std::copy(Weights, Weights + TapCount, PassWeights.begin());
+
+	render_target_desc Desc = Graph.GetDesc(Source);
+	TapsPerPixel += TapCount;
+	return this->AddPass(Graph, "Blur separable", &SeparableProgram, Source, Desc.Width, Desc.Height, [=](program& Program)
+	{
+		Program.SetVec2("uStep", Step);
+		Program.SetInt("uTapCount", TapCount);
+		Program.SetFloatArray("uOffsets", PassOffsets.data(), TapCount);
+		Program.SetFloatArray("uWeights", PassWeights.data(), TapCount);
+	});
+}
+
+render_graph::resource blur::ApplyKernel(render_graph& Graph, render_graph::resource Source, const mat3& Kernel, float Offset, int Iterations)
+{
+	PassCount = 0;
+	TapsPerPixel = 0.f;
+	PyramidLevels = 0;
+	if (Iterations <= 0 || !SeparableProgram.IsReady() || !KernelProgram.IsReady())
+		return Source;
+
+	v3 Column;
+	v3 Row;
+	Separable = FactorSeparableKernel(Kernel, &Column, &Row);
+
+	render_graph::resource Current = Source;
+	if (!Separable)
+	{
+		// Full 3x3 passes
+		render_target_desc Desc = Graph.GetDesc(Source);
+		int Width = Desc.Width;
+		int Height = Desc.Height;
+		for (int i = 0; i < Iterations; ++i)
+		{
+			Current = this->AddPass(Graph, "Blur 3x3", &KernelProgram, Current, Width, Height, [=](program& Program)
+			{
+				Program.SetFloat("uOffset", Offset);
+				Program.SetMat3("uKernel", Kernel);
+			});
+			TapsPerPixel += 9.f;
+		}
+	}
+	else
+	{
+		// 1D weights ordered from -Offset to +Offset (kernel columns go from +Offset to -Offset)
+		float RowWeights[3] = { Row.x, Row.y, Row.z };
+		float ColumnWeights[3] = { Column.z, Column.y, Column.x };
+
+		// N iterations of a 3 taps kernel are one 2N+1 taps kernel
+		while (Iterations > 0)
+		{
+			int Count = Math::Min(Iterations, (MAX_TAPS - 1) / 2);
+			Iterations -= Count;
+
+			float WeightsX[MAX_TAPS] = { 1.f };
+			float WeightsY[MAX_TAPS] = { 1.f };
+			float Offsets[MAX_TAPS];
+			int TapCount = 1;
+			for (int i = 0; i < Count; ++i)
+			{
+				Convolve(WeightsX, TapCount, RowWeights);
+				TapCount = Convolve(WeightsY, TapCount, ColumnWeights);
+			}
+			for (int i = 0; i < TapCount; ++i)
+				Offsets[i] = (float)(i - Count);
+
+			Current = this->SeparablePass(Graph, Current, { Offset, 0.f }, TapCount, Offsets, WeightsX);
+			Current = this->SeparablePass(Graph, Current, { 0.f, Offset }, TapCount, Offsets, WeightsY);
+		}
+	}
+
+	return Current;
+}
+
+render_graph::resource blur::Gaussian(render_graph& Graph, render_graph::resource Source, float Sigma)
+{
+	PassCount = 0;
+	TapsPerPixel = 0.f;
+	PyramidLevels = 0;
+	Separable = true;
+	if (Sigma <= 0.f || !SeparableProgram.IsReady() || !DownsampleProgram.IsReady() || !UpsampleProgram.IsReady())
+		return Source;
+
+	render_target_desc Desc = Graph.GetDesc(Source);
+	int Width = Desc.Width;
+	int Height = Desc.Height;
+
+	if (Sigma > MaxSeparableSigma)
+	{
+		// Each pyramid level roughly doubles the radius
+		PyramidLevels = Math::Clamp((int)ceilf(log2f(Sigma / MaxSeparableSigma)) + 1, 1, MaxPyramidLevels);
+		return this->DualKawase(Graph, Source, Width, Height, PyramidLevels);
+	}
+
+	// Gaussian weights (one side, normalized on both sides)
+	int Radius = Math::Min((int)ceilf(3.f * Sigma), MAX_TAPS - 1);
+	float Gaussian[MAX_TAPS + 1] = {};
+	float Total = 0.f;
+	for (int i = 0; i <= Radius; ++i)
+	{
+		Gaussian[i] = expf(-(float)(i * i) / (2.f * Sigma * Sigma));
+		Total += (i == 0) ? Gaussian[i] : 2.f * Gaussian[i];
+	}
+
+	// Linear sampling: two neighbour texels are fetched by one bilinear tap between them
+	float Offsets[MAX_TAPS];
+	float Weights[MAX_TAPS];
+	int TapCount = 0;
+	Offsets[TapCount] = 0.f;
+	Weights[TapCount++] = Gaussian[0] / Total;
+	for (int i = 1; i <= Radius; i += 2)
+	{
+		float Weight = Gaussian[i] + Gaussian[i + 1];
+		float Offset = (i * Gaussian[i] + (i + 1) * Gaussian[i + 1]) / Weight;
+		Offsets[TapCount] = Offset;
+		Weights[TapCount++] = Weight / Total;
+		Offsets[TapCount] = -Offset;
+		Weights[TapCount++] = Weight / Total;
+	}
+
+	render_graph::resource Horizontal = this->SeparablePass(Graph, Source, { 1.f / Width, 0.f }, TapCount, Offsets, Weights);
+	return this->SeparablePass(Graph, Horizontal, { 0.f, 1.f / Height }, TapCount, Offsets, Weights);
+}
+
+render_graph::resource blur::DualKawase(render_graph& Graph, render_graph::resource Source, int Width, int Height, int Levels)
+{
+	// Level sizes (level 0 is the source size)
+	int Widths[16];
+	int Heights[16];
+	Widths[0] = Width;
+	Heights[0] = Height;
+	for (int i = 1; i <= Levels; ++i)
+	{
+		Widths[i] = Math::Max(Widths[i - 1] / 2, 1);
+		Heights[i] = Math::Max(Heights[i - 1] / 2, 1);
+	}
+
+	render_graph::resource Current = Source;
+	for (int i = 1; i <= Levels; ++i)
+	{
+		Current = this->AddPass(Graph, "Blur downsample", &DownsampleProgram, Current, Widths[i], Heights[i], nullptr);
+		TapsPerPixel += 5.f / (float)(1 << (2 * i));
+	}
+
+	// Back up, the last pass writes a full resolution target
+	for (int i = Levels - 1; i >= 0; --i)
+	{
+		Current = this->AddPass(Graph, "Blur upsample", &UpsampleProgram, Current, Widths[i], Heights[i], nullptr);
+		TapsPerPixel += 8.f / (float)(1 << (2 * i));
+	}
+	return Current;
+}
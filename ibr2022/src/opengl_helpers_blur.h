@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+
+#include "opengl_headers.h"
+#include "types.h"
+#include "opengl_helpers_program.h"
+#include "opengl_helpers_render_graph.h"
+
+namespace GL
+{
+	// Kernel = Column * Row^T (weight of tap (x, y) is Kernel.c[y].e[x], y from +offset to -offset like in the 3x3 shader)
+	bool FactorSeparableKernel(const mat3& Kernel, v3* ColumnOut, v3* RowOut, float Epsilon = 1e-4f);
+
+	// Blur passes added to a render graph (fullscreen triangles into RGBA16F transient targets of the source size)
+	// Returns the blurred resource (Source when there is nothing to do)
+	class blur
+	{
+	public:
+		static const int MAX_TAPS = 31;
+
+		blur();
+		~blur();
+
+		// Kernel (3x3, taps Offset apart in UV) applied Iterations times
+		// Separable kernels are factored and their iterations merged into 1D passes of up to MAX_TAPS taps
+		render_graph::resource ApplyKernel(render_graph& Graph, render_graph::resource Source, const mat3& Kernel, float Offset, int Iterations);
+
+		// Gaussian blur, Sigma in pixels: separable passes with linear sampling (2 texels per tap) up to MaxSeparableSigma,
+		// dual Kawase downsample/upsample pyramid above (approximate gaussian, cost roughly constant whatever the radius)
+		render_graph::resource Gaussian(render_graph& Graph, render_graph::resource Source, float Sigma);
+
+		float MaxSeparableSigma = 4.f;
+		int MaxPyramidLevels = 6;
+
+		// Stats of the last blur
+		int PassCount = 0;
+		float TapsPerPixel = 0.f; // Texture fetches per full resolution pixel
+		bool Separable = false;   // Last kernel was factored
+		int PyramidLevels = 0;    // 0 when the last gaussian was separable
+
+	private:
+		typedef std::function<void(program&)> uniform_setter;
+
+		render_graph::resource AddPass(render_graph& Graph, const char* Name, program* Program, render_graph::resource Source, int Width, int Height, const uniform_setter& SetUniforms);
+		render_graph::resource SeparablePass(render_graph& Graph, render_graph::resource Source, v2 Step, int TapCount, const float* Offsets, const float* Weights);
+		render_graph::resource DualKawase(render_graph& Graph, render_graph::resource Source, int Width, int Height, int Levels);
+
+		program SeparableProgram;
+		program KernelProgram;
+		program DownsampleProgram;
+		program UpsampleProgram;
+		GLuint EmptyVAO = 0;
+	};
+}
@@ -1,4 +1,7 @@
 
+#include <algorithm>
+#include <cstring>
+
 #include "opengl_helpers.h"
 
 #include "opengl_helpers_cache.h"
@@ -12,6 +15,18 @@ GL::cache::~cache()
 	for (const auto& KeyValue : this->TextureMap)
 		glDeleteTextures(1, &KeyValue.second.TextureID);
 
+	for (const auto& KeyValue : this->CubemapMap)
+		glDeleteTextures(1, &KeyValue.second.TextureID);
+
+	// Unpacked materials use textures from TextureMap
+	for (const auto& KeyValue : this->PackedMaterialMap)
+	{
+		if (KeyValue.second.ShaderDefines.empty())
+			continue;
+		glDeleteTextures(1, &KeyValue.second.DiffuseTexture);
+		glDeleteTextures(1, &KeyValue.second.EmissiveTexture);
+	}
+
 	for (const auto& KeyValue : this->VertexBufferMap)
 		glDeleteBuffers(1, &KeyValue.second.VertexBuffer);
 }
@@ -68,3 +83,131 @@ GLuint GL::cache::LoadTexture(const char* Filename, int ImageFlags, int* WidthOu
 
 	return Texture;
 }
+
+GLuint GL::cache::LoadCubemap(const std::vector<std::string>& Filenames, int ImageFlags, const sh9** SHOut)
+{
+	std::string Key;
+	for (const std::string& Filename : Filenames)
+		Key += Filename + "+";
+
+	auto Found = this->CubemapMap.find(Key);
+	if (Found == this->CubemapMap.end())
+	{
+		cubemap Cubemap = {};
+		glGenTextures(1, &Cubemap.TextureID);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, Cubemap.TextureID);
+		GL::UploadCubemapTexture(Filenames, ImageFlags, nullptr, nullptr, &Cubemap.SH);
+
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, (ImageFlags & IMG_GEN_MIPMAPS) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+		Found = this->CubemapMap.emplace(Key, Cubemap).first;
+	}
+
+	if (SHOut)
+		*SHOut = &Found->second.SH;
+	return Found->second.TextureID;
+}
+
+const GL::packed_material& GL::cache::LoadPackedMaterial(const char* DiffuseFilename, const char* EmissiveFilename, int ImageFlags)
+{
+	std::string Key = std::string(DiffuseFilename) + "+" + EmissiveFilename;
+
+	auto Found = this->PackedMaterialMap.find(Key);
+	if (Found != this->PackedMaterialMap.end())
+		return Found->second;
+
+	packed_material& Material = this->PackedMaterialMap[Key];
+	if (!GL::PackMaterialTextures(DiffuseFilename, EmissiveFilename, ImageFlags, &Material))
+	{
+		Material = packed_material();
+		Material.DiffuseTexture = this->LoadTexture(DiffuseFilename, ImageFlags);
+		Material.EmissiveTexture = this->LoadTexture(EmissiveFilename, ImageFlags);
+	}
+
+	return Material;
+}
+
+// One define per line, sorted so that the same set always gives the same key
+static std::string NormalizeDefines(const char* Defines)
+{
+	std::vector<std::string> Lines;
+	for (const char* Line = Defines; *Line; )
+	{
+		const char* LineEnd = strchr(Line, '\n');
+		if (LineEnd == nullptr)
+			LineEnd = Line + strlen(Line);
+		if (LineEnd != Line)
+			Lines.push_back(std::string(Line, LineEnd));
+		Line = (*LineEnd == '\n') ? LineEnd + 1 : LineEnd;
+	}
+	std::sort(Lines.begin(), Lines.end());
+	Lines.erase(std::unique(Lines.begin(), Lines.end()), Lines.end());
+
+	std::string Result;
+	for (const std::string& Line : Lines)
+		Result += Line + "\n";
+	return Result;
+}
+
+// FNV-1a of both stages (same sources loaded from different strings give the same key)
+static uint64_t HashSources(const char* VSString, const char* FSString)
+{
+	uint64_t Hash = 0xcbf29ce484222325ull;
+	for (const char* String : { VSString, "\n// FRAGMENT SHADER\n", FSString })
+	{
+		for (const char* C = String; *C; ++C)
+		{
+			Hash ^= (uint8_t)*C;
+			Hash *= 0x100000001b3ull;
+		}
+	}
+	return Hash;
+}
+
+GL::program* GL::cache::LoadProgram(const char* VSString, const char* FSString, const char* Defines, bool InjectLightShading)
+{
+	program_identifier ProgramIdentifier = { HashSources(VSString, FSString), NormalizeDefines(Defines), InjectLightShading };
+
+	auto Found = this->ProgramMap.find(ProgramIdentifier);
+	if (Found != this->ProgramMap.end())
+	{
+		// Poll the background compiles (precompiled variants are finished here if nobody waited for them yet)
+		Found->second.Program->IsReady();
+		Found->second.RefCount++;
+		return Found->second.Program.get();
+	}
+
+	// Defines are prepended to both stages
+	const char* VSStrings[2] = { ProgramIdentifier.Defines.c_str(), VSString };
+	const char* FSStrings[2] = { ProgramIdentifier.Defines.c_str(), FSString };
+	shared_program& SharedProgram = this->ProgramMap[ProgramIdentifier];
+	SharedProgram.Program.reset(new program());
+	SharedProgram.Program->Create(2, VSStrings, 2, FSStrings, InjectLightShading);
+	SharedProgram.RefCount = 1;
+
+	return SharedProgram.Program.get();
+}
+
+void GL::cache::ReleaseProgram(program* Program)
+{
+	for (auto It = this->ProgramMap.begin(); It != this->ProgramMap.end(); ++It)
+	{
+		if (It->second.Program.get() != Program)
+			continue;
+
+		if (--It->second.RefCount == 0)
+			this->ProgramMap.erase(It);
+		return;
+	}
+}
+
+void GL::cache::PrecompilePrograms(const char* VSString, const char* FSString, int DefinesCount, const char** Defines, bool InjectLightShading)
+{
+	// The cache keeps one reference to each variant
+	for (int i = 0; i < DefinesCount; ++i)
+		this->LoadProgram(VSString, FSString, Defines[i], InjectLightShading);
+}
@@ -3,9 +3,14 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 
 #include "opengl_headers.h"
 #include "mesh.h"
+#include "opengl_helpers_texture_pack.h"
+#include "opengl_helpers_program.h"
+#include "opengl_helpers_sh.h"
+#include "opengl_helpers_render_graph.h"
 
 namespace GL
 {
@@ -16,6 +21,20 @@ namespace GL
         ~cache();
         GLuint LoadObj(const char* Filename, float Scale, int* VertexCountOut);
         GLuint LoadTexture(const char* Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
+        // Diffuse/emissive pair merged by GL::PackMaterialTextures (falls back to 2 textures if they cannot be merged)
+        // Cubemap (6 faces: +X, -X, +Y, -Y, +Z, -Z), SHOut receives its diffuse ambient, projected once on load
+        GLuint LoadCubemap(const std::vector<std::string>& Filenames, int ImageFlags = 0, const sh9** SHOut = nullptr);
+        const packed_material& LoadPackedMaterial(const char* DiffuseFilename, const char* EmissiveFilename, int ImageFlags = 0);
+
+        // Shared program (compiled in background), reference counted
+        // Variants are identified by the hash of the sources contents + the set of defines ("#define X\n" lines, in any order)
+        program* LoadProgram(const char* VSString, const char* FSString, const char* Defines = "", bool InjectLightShading = false);
+        void ReleaseProgram(program* Program);
+        // Submit variants before they are needed (kept alive until the cache is destroyed)
+        void PrecompilePrograms(const char* VSString, const char* FSString, int DefinesCount, const char** Defines, bool InjectLightShading = false);
+
+        // Transient render targets of the render graphs, reused across frames and demos
+        render_target_pool RenderTargets;
 
 	private:
 		struct mesh
@@ -42,8 +61,37 @@ namespace GL
 			int Height;
 		};
 
+		struct cubemap
+		{
+			GLuint TextureID;
+			sh9 SH;
+		};
+
+		struct program_identifier
+		{
+			uint64_t SourcesHash; // Vertex and fragment shader strings
+			std::string Defines;  // Sorted define lines
+			bool InjectLightShading;
+
+			bool operator<(const program_identifier& Other) const
+			{
+				if (SourcesHash != Other.SourcesHash) return SourcesHash < Other.SourcesHash;
+				if (InjectLightShading != Other.InjectLightShading) return InjectLightShading < Other.InjectLightShading;
+				return Defines < Other.Defines;
+			}
+		};
+
+		struct shared_program
+		{
+			std::unique_ptr<program> Program;
+			int RefCount;
+		};
+
 		std::vector<vertex_full> TmpBuffer;
 		std::map<std::string, mesh> VertexBufferMap;
 		std::map<texture_identifier, texture> TextureMap;
+		std::map<std::string, cubemap> CubemapMap;
+		std::map<std::string, packed_material> PackedMaterialMap;
+		std::map<program_identifier, shared_program> ProgramMap;
 	};
 }
@@ -0,0 +1,249 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "opengl_helpers_color_grading.h"
+
+using namespace GL;
+
+static float Saturate(float X)
+{
+	return Math::Clamp(X, 0.f, 1.f);
+}
+
+static v3 RGBToHSL(v3 Color)
+{
+	float Max = Math::Max(Color.x, Math::Max(Color.y, Color.z));
+	float Min = Math::Min(Color.x, Math::Min(Color.y, Color.z));
+	float Lightness = 0.5f * (Max + Min);
+	float Delta = Max - Min;
+	if (Delta <= 0.f)
+		return { 0.f, 0.f, Lightness };
+
+	float Saturation = Delta / (1.f - fabsf(2.f * Lightness - 1.f));
+	float Hue;
+	if (Max == Color.x)
+		Hue = fmodf((Color.y - Color.z) / Delta + 6.f, 6.f);
+	else if (Max == Color.y)
+		Hue = (Color.z - Color.x) / Delta + 2.f;
+	else
+		Hue = (Color.x - Color.y) / Delta + 4.f;
+	return { Hue * 60.f, Saturation, Lightness };
+}
+
+static v3 HSLToRGB(v3 HSL)
+{
+	float Chroma = (1.f - fabsf(2.f * HSL.z - 1.f)) * HSL.y;
+	float H = HSL.x / 60.f;
+	float X = Chroma * (1.f - fabsf(fmodf(H, 2.f) - 1.f));
+	v3 Color;
+	if      (H < 1.f) Color = { Chroma, X, 0.f };
+	else if (H < 2.f) Color = { X, Chroma, 0.f };
+	else if (H < 3.f) Color = { 0.f, Chroma, X };
+	else if (H < 4.f) Color = { 0.f, X, Chroma };
+	else if (H < 5.f) Color = { X, 0.f, Chroma };
+	else              Color = { Chroma, 0.f, X };
+	float M = HSL.z - 0.5f * Chroma;
+	return { Color.x + M, Color.y + M, Color.z + M };
+}
+
+// Monotone cubic through the control points (Fritsch-Carlson tangents), no overshoot between points
+static float EvaluateCurve(const std::vector<v2>& Points, float X)
+{
+	int Count = (int)Points.size();
+	if (Count == 0)
+		return X;
+	if (Count == 1 || X <= Points[0].x)
+		return Points[0].y;
+	if (X >= Points[Count - 1].x)
+		return Points[Count - 1].y;
+
+	int i = 0;
+	while (X > Points[i + 1].x)
+		i++;
+
+	auto Slope = [&](int k) { return (Points[k + 1].y - Points[k].y) / Math::Max(Points[k + 1].x - Points[k].x, 1e-6f); };
+	auto Tangent = [&](int k)
+	{
+		if (k == 0)
+			return Slope(0);
+		if (k == Count - 1)
+			return Slope(Count - 2);
+		float Left = Slope(k - 1);
+		float Right = Slope(k);
+		if (Left * Right <= 0.f)
+			return 0.f;
+		// Weighted harmonic mean of the neighbour slopes
+		float H0 = Math::Max(Points[k].x - Points[k - 1].x, 1e-6f);
+		float H1 = Math::Max(Points[k + 1].x - Points[k].x, 1e-6f);
+		return 3.f * (H0 + H1) / ((2.f * H1 + H0) / Left + (H1 + 2.f * H0) / Right);
+	};
+
+	float Width = Math::Max(Points[i + 1].x - Points[i].x, 1e-6f);
+	float T = (X - Points[i].x) / Width;
+	float T2 = T * T;
+	float T3 = T2 * T;
+	return (2.f * T3 - 3.f * T2 + 1.f) * Points[i].y
+		+ (T3 - 2.f * T2 + T) * Width * Tangent(i)
+		+ (-2.f * T3 + 3.f * T2) * Points[i + 1].y
+		+ (T3 - T2) * Width * Tangent(i + 1);
+}
+
+v3 GL::ApplyColorOperations(const std::vector<color_operation>& Chain, v3 Color)
+{
+	for (const color_operation& Operation : Chain)
+	{
+		switch (Operation.Type)
+		{
+		case color_operation::MATRIX:
+		{
+			v4 Result = Operation.Matrix * v4{ Color.x, Color.y, Color.z, 1.f };
+			Color = { Result.x, Result.y, Result.z };
+			break;
+		}
+
+		case color_operation::HSL:
+		{
+			v3 HSL = RGBToHSL({ Saturate(Color.x), Saturate(Color.y), Saturate(Color.z) });
+			HSL.x = fmodf(HSL.x + Operation.HueShift + 360.f, 360.f);
+			HSL.y = Saturate(HSL.y * Operation.Saturation);
+			HSL.z = Saturate(HSL.z + Operation.Lightness);
+			Color = HSLToRGB(HSL);
+			break;
+		}
+
+		case color_operation::CURVES:
+			for (int c = 0; c < 3; ++c)
+				Color.e[c] = EvaluateCurve(Operation.Curves[1 + c], EvaluateCurve(Operation.Curves[0], Saturate(Color.e[c])));
+			break;
+		}
+	}
+	return { Saturate(Color.x), Saturate(Color.y), Saturate(Color.z) };
+}
+
+static void BakeRows(const std::vector<color_operation>* Chain, int Size, int FirstRow, int EndRow, v3* Texels)
+{
+	float Scale = 1.f / (Size - 1);
+	for (int Row = FirstRow; Row < EndRow; ++Row)
+	{
+		int G = Row % Size;
+		int B = Row / Size;
+		for (int R = 0; R < Size; ++R)
+			Texels[(size_t)Row * Size + R] = ApplyColorOperations(*Chain, { R * Scale, G * Scale, B * Scale });
+	}
+}
+
+void GL::BakeColorLUT(const std::vector<color_operation>& Chain, int Size, std::vector<v3>* TexelsOut, int ThreadCount)
+{
+	if (ThreadCount <= 0)
+		ThreadCount = Math::Max((int)std::thread::hardware_concurrency(), 1);
+
+	int RowCount = Size * Size;
+	ThreadCount = Math::Min(ThreadCount, RowCount);
+	TexelsOut->resize((size_t)RowCount * Size);
+
+	// Split rows between threads, the calling thread takes the first range
+	std::vector<std::thread> Threads;
+	for (int i = 1; i < ThreadCount; ++i)
+		Threads.emplace_back(BakeRows, &Chain, Size, RowCount * i / ThreadCount, RowCount * (i + 1) / ThreadCount, TexelsOut->data());
+	BakeRows(&Chain, Size, 0, RowCount / ThreadCount, TexelsOut->data());
+	for (std::thread& Thread : Threads)
+		Thread.join();
+}
+
+static const int CUBE_LUT_MAX_SIZE = 256; // Limit of the .cube format
+
+bool GL::LoadCubeLUT(const char* Filename, int* SizeOut, std::vector<v3>* TexelsOut, std::string* TitleOut)
+{
+	FILE* File = fopen(Filename, "r");
+	if (File == nullptr)
+	{
+		fprintf(stderr, "Cannot open LUT '%s'\n", Filename);
+		return false;
+	}
+
+	int Size = 0;
+	std::vector<v3> Texels;
+	char Line[512];
+	bool Valid = true;
+	while (Valid && fgets(Line, sizeof(Line), File))
+	{
+		char Title[256];
+		v3 Min;
+		v3 Max;
+		v3 Texel;
+		if (Line[0] == '#' || Line[0] == '\n' || Line[0] == '\r')
+			continue;
+		else if (sscanf(Line, "LUT_3D_SIZE %d", &Size) == 1)
+		{
+			Valid = (Size >= 2 && Size <= CUBE_LUT_MAX_SIZE);
+			if (Valid)
+				Texels.reserve((size_t)Size * Size * Size);
+		}
+		else if (strncmp(Line, "LUT_1D_SIZE", 11) == 0)
+			Valid = false;
+		else if (sscanf(Line, "TITLE \"%255[^\"]\"", Title) == 1)
+		{
+			if (TitleOut)
+				*TitleOut = Title;
+		}
+		else if (sscanf(Line, "DOMAIN_MIN %f %f %f", &Min.x, &Min.y, &Min.z) == 3)
+			Valid = (Min.x == 0.f && Min.y == 0.f && Min.z == 0.f);
+		else if (sscanf(Line, "DOMAIN_MAX %f %f %f", &Max.x, &Max.y, &Max.z) == 3)
+			Valid = (Max.x == 1.f && Max.y == 1.f && Max.z == 1.f);
+		else if (sscanf(Line, "%f %f %f", &Texel.x, &Texel.y, &Texel.z) == 3)
+		{
+			Texels.push_back(Texel);
+			Valid = (Texels.size() <= (size_t)CUBE_LUT_MAX_SIZE * CUBE_LUT_MAX_SIZE * CUBE_LUT_MAX_SIZE);
+		}
+	}
+	fclose(File);
+
+	if (!Valid || Size < 2 || Texels.size() != (size_t)Size * Size * Size)
+	{
+		fprintf(stderr, "Unsupported LUT '%s' (3D LUT with a [0, 1] domain expected)\n", Filename);
+		return false;
+	}
+
+	*SizeOut = Size;
+	*TexelsOut = std::move(Texels);
+	return true;
+}
+
+bool GL::SaveCubeLUT(const char* Filename, int Size, const std::vector<v3>& Texels, const char* Title)
+{
+	FILE* File = fopen(Filename, "w");
+	if (File == nullptr)
+		return false;
+
+	fprintf(File, "TITLE \"%s\"\n", Title);
+	fprintf(File, "LUT_3D_SIZE %d\n", Size);
+	for (const v3& Texel : Texels)
+		fprintf(File, "%.6f %.6f %.6f\n", Texel.x, Texel.y, Texel.z);
+	fclose(File);
+	return true;
+}
+
+GLuint GL::UploadLUTTexture(int Size, const std::vector<v3>& Texels, GLuint Texture)
+{
+	if (Texture == 0)
+	{
+		glGenTextures(1, &Texture);
+		glBindTexture(GL_TEXTURE_3D, Texture);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_3D, Texture);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, Size, Size, Size, 0, GL_RGB, GL_FLOAT, Texels.data());
+	glBindTexture(GL_TEXTURE_3D, 0);
+	return Texture;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "opengl_headers.h"
+#include "types.h"
+#include "maths.h"
+
+namespace GL
+{
+	// One step of a color grading chain, colors in display space ([0, 1] after gamma, like the uber post-process LUT)
+	struct color_operation
+	{
+		enum type
+		{
+			MATRIX, // rgb = (Matrix * vec4(rgb, 1)).rgb
+			HSL,    // Hue shift (degrees), saturation multiplier, lightness offset
+			CURVES, // Master curve then per channel curves, control points (x, y) in [0, 1] sorted by x
+		};
+
+		type Type = MATRIX;
+		mat4 Matrix = Mat4::Identity();
+		float HueShift = 0.f;
+		float Saturation = 1.f;
+		float Lightness = 0.f;
+		std::vector<v2> Curves[4]; // Master, red, green, blue (empty: identity)
+	};
+
+	v3 ApplyColorOperations(const std::vector<color_operation>& Chain, v3 Color);
+
+	// Evaluate the chain at every texel of a Size^3 LUT (red varies fastest, like .cube files), rows split between threads
+	void BakeColorLUT(const std::vector<color_operation>& Chain, int Size, std::vector<v3>* TexelsOut, int ThreadCount = 0);
+
+	// Adobe/Resolve .cube text files (3D LUTs with the default [0, 1] domain)
+	bool LoadCubeLUT(const char* Filename, int* SizeOut, std::vector<v3>* TexelsOut, std::string* TitleOut = nullptr);
+	bool SaveCubeLUT(const char* Filename, int Size, const std::vector<v3>& Texels, const char* Title);
+
+	// RGB16F GL_TEXTURE_3D, trilinear, clamped (reuses Texture if not 0)
+	GLuint UploadLUTTexture(int Size, const std::vector<v3>& Texels, GLuint Texture = 0);
+}
@@ -0,0 +1,206 @@
+#include <vector>
+
+#include "opengl_helpers_cache.h"
+
+#include "opengl_helpers_postprocess.h"
+
+using namespace GL;
+
+#pragma region uber_shaders
+// Fullscreen triangle
+static const char* gVertexShaderStr = R"GLSL(
+out vec2 vUV;
+
+void main()
+{
+    vUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+})GLSL";
+
+// Effects are enabled by defines (see BuildDefines)
+static const char* gFragmentShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uSource;
+
+#if defined(BLOOM)
+uniform sampler2D uBloom;
+uniform float uBloomIntensity;
+#endif
+
+#if defined(COLOR_MATRIX)
+uniform mat4 uColorMatrix;
+#endif
+
+#if defined(VIGNETTE)
+uniform float uVignetteIntensity;
+uniform float uVignetteRadius;
+#endif
+
+#if defined(GAMMA)
+uniform float uGamma;
+#endif
+
+#if defined(LUT)
+uniform sampler3D uLUT;
+uniform float uLUTSize;
+#endif
+
+#if defined(GRAIN)
+uniform float uGrainIntensity;
+uniform uint uGrainSeed;
+
+// Integer hash in [0, 1]
+float grain_hash(uvec3 v)
+{
+    v = v * 1664525u + 1013904223u;
+    v.x += v.y * v.z; v.y += v.z * v.x; v.z += v.x * v.y;
+    v ^= v >> 16u;
+    v.x += v.y * v.z; v.y += v.z * v.x; v.z += v.x * v.y;
+    return float(v.x) / 4294967295.0;
+}
+#endif
+
+out vec4 oColor;
+
+void main()
+{
+    vec3 color = texture(uSource, vUV).rgb;
+
+#if defined(BLOOM)
+    color += texture(uBloom, vUV).rgb * uBloomIntensity;
+#endif
+
+#if defined(COLOR_MATRIX)
+    color = max((uColorMatrix * vec4(color, 1.0)).rgb, vec3(0.0));
+#endif
+
+#if defined(VIGNETTE)
+    float dist = length(vUV - 0.5) * 1.4142136; // 1 in the corners
+    color *= 1.0 - uVignetteIntensity * smoothstep(uVignetteRadius, 1.0, dist);
+#endif
+
+#if defined(GAMMA)
+    color = pow(color, vec3(1.0 / uGamma));
+#endif
+
+#if defined(LUT)
+    // Texel centers of the first and last slices
+    color = texture(uLUT, clamp(color, 0.0, 1.0) * ((uLUTSize - 1.0) / uLUTSize) + 0.5 / uLUTSize).rgb;
+#endif
+
+#if defined(GRAIN)
+    color += (grain_hash(uvec3(gl_FragCoord.xy, uGrainSeed)) - 0.5) * uGrainIntensity;
+#endif
+
+    oColor = vec4(color, 1.0);
+})GLSL";
+#pragma endregion uber_shaders
+
+static const char* gEffectDefines[POSTPROCESS_EFFECT_COUNT] = { "BLOOM", "COLOR_MATRIX", "VIGNETTE", "GAMMA", "LUT", "GRAIN" };
+static const char* gEffectNames[POSTPROCESS_EFFECT_COUNT] = { "Bloom", "Color matrix", "Vignette", "Gamma", "LUT", "Grain" };
+
+uber_postprocess::uber_postprocess(cache& GLCache)
+	: GLCache(GLCache)
+{
+	glGenVertexArrays(1, &EmptyVAO);
+}
+
+uber_postprocess::~uber_postprocess()
+{
+	for (const auto& KeyValue : Variants)
+		GLCache.ReleaseProgram(KeyValue.second);
+	glDeleteVertexArrays(1, &EmptyVAO);
+}
+
+std::string uber_postprocess::BuildDefines(int Effects)
+{
+	std::string Defines;
+	for (int i = 0; i < POSTPROCESS_EFFECT_COUNT; ++i)
+	{
+		if (Effects & (1 << i))
+			Defines += std::string("#define ") + gEffectDefines[i] + "\n";
+	}
+	return Defines;
+}
+
+void uber_postprocess::Precompile(int EffectSetCount, const int* EffectSets)
+{
+	std::vector<std::string> Defines(EffectSetCount);
+	std::vector<const char*> DefinesStrs(EffectSetCount);
+	for (int i = 0; i < EffectSetCount; ++i)
+	{
+		Defines[i] = BuildDefines(EffectSets[i]);
+		DefinesStrs[i] = Defines[i].c_str();
+	}
+	GLCache.PrecompilePrograms(gVertexShaderStr, gFragmentShaderStr, EffectSetCount, DefinesStrs.data());
+}
+
+const char* uber_postprocess::GetEffectName(int Effect)
+{
+	for (int i = 0; i < POSTPROCESS_EFFECT_COUNT; ++i)
+	{
+		if (Effect == (1 << i))
+			return gEffectNames[i];
+	}
+	return "";
+}
+
+void uber_postprocess::Draw(GLuint Source, const postprocess_settings& Settings, float Time)
+{
+	int Effects = Settings.Effects;
+	if (Settings.LUTTexture == 0)
+		Effects &= ~POSTPROCESS_LUT;
+	if (Settings.BloomTexture == 0)
+		Effects &= ~POSTPROCESS_BLOOM;
+
+	program*& Variant = Variants[Effects];
+	if (Variant == nullptr)
+		Variant = GLCache.LoadProgram(gVertexShaderStr, gFragmentShaderStr, BuildDefines(Effects).c_str());
+
+	// Previous variant while the new one compiles
+	program* Program = Variant;
+	if (Program->IsReady())
+	{
+		DrawnEffects = Effects;
+	}
+	else
+	{
+		auto Found = Variants.find(DrawnEffects);
+		if (Found == Variants.end() || !Found->second->IsReady())
+			return;
+		Program = Found->second;
+	}
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	Program->Use();
+	Program->SetInt("uSource", 0);
+	Program->SetInt("uBloom", 2);
+	Program->SetFloat("uBloomIntensity", Settings.BloomIntensity);
+	Program->SetMat4("uColorMatrix", Settings.ColorMatrix);
+	Program->SetFloat("uVignetteIntensity", Settings.VignetteIntensity);
+	Program->SetFloat("uVignetteRadius", Settings.VignetteRadius);
+	Program->SetFloat("uGamma", Settings.Gamma);
+	Program->SetInt("uLUT", 1);
+	Program->SetFloat("uLUTSize", (float)Settings.LUTSize);
+	Program->SetFloat("uGrainIntensity", Settings.GrainIntensity);
+	Program->SetUint("uGrainSeed", (uint32_t)(Time * 60.0f));
+
+	if (DrawnEffects & POSTPROCESS_BLOOM)
+	{
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, Settings.BloomTexture);
+	}
+	if (DrawnEffects & POSTPROCESS_LUT)
+	{
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_3D, Settings.LUTTexture);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, Source);
+
+	glBindVertexArray(EmptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
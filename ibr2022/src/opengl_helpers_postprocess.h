@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "opengl_headers.h"
+#include "types.h"
+#include "maths.h"
+#include "opengl_helpers_program.h"
+
+namespace GL
+{
+	class cache;
+
+	// Per-pixel effects fused in one pass, in this order
+	enum postprocess_effect
+	{
+		POSTPROCESS_BLOOM        = 1 << 0, // rgb += BloomIntensity * bloom texture (GL::bloom)
+		POSTPROCESS_COLOR_MATRIX = 1 << 1, // rgb = (ColorMatrix * vec4(rgb, 1)).rgb, linear space
+		POSTPROCESS_VIGNETTE     = 1 << 2,
+		POSTPROCESS_GAMMA        = 1 << 3,
+		POSTPROCESS_LUT          = 1 << 4, // 3D LUT, display space (after gamma)
+		POSTPROCESS_GRAIN        = 1 << 5,
+		POSTPROCESS_EFFECT_COUNT = 6,
+	};
+
+	struct postprocess_settings
+	{
+		int Effects = POSTPROCESS_GAMMA;
+		GLuint BloomTexture = 0;
+		float BloomIntensity = 0.05f;
+		mat4 ColorMatrix = Mat4::Identity();
+		float VignetteIntensity = 0.5f;
+		float VignetteRadius = 0.75f; // Distance to the center (1 in the corners) where the darkening starts
+		float Gamma = 2.2f;
+		GLuint LUTTexture = 0;        // GL_TEXTURE_3D
+		int LUTSize = 0;
+		float GrainIntensity = 0.05f;
+	};
+
+	// Uber post-process: one fullscreen pass whose fragment shader is assembled from the enabled effects
+	// Each effect set is a program variant (GL::cache defines), compiled in background the first time it is used,
+	// the previous variant is drawn until it is ready
+	class uber_postprocess
+	{
+	public:
+		uber_postprocess(cache& GLCache);
+		~uber_postprocess();
+
+		// Compile the variants of the given effect sets in background (kept warm by GLCache)
+		void Precompile(int EffectSetCount, const int* EffectSets);
+
+		// Draw Source into the bound framebuffer (viewport set by the caller)
+		void Draw(GLuint Source, const postprocess_settings& Settings, float Time);
+
+		// "#define X\n" lines of an effect set
+		static std::string BuildDefines(int Effects);
+		static const char* GetEffectName(int Effect);
+
+		int GetVariantCount() const { return (int)Variants.size(); }
+		int DrawnEffects = -1; // Effects of the variant drawn last (can lag behind the requested ones while compiling)
+
+	private:
+		cache& GLCache;
+		std::map<int, program*> Variants; // By effect set
+		GLuint EmptyVAO = 0;
+	};
+}
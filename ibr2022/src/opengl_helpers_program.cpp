@@ -0,0 +1,244 @@
+#include <cstring>
+
+#include "platform.h"
+
+#include "opengl_helpers.h"
+
+#include "opengl_helpers_program.h"
+
+using namespace GL;
+
+// FNV-1a
+static uint32_t HashName(const char* Name)
+{
+	uint32_t Hash = 0x811c9dc5u;
+	for (const char* C = Name; *C; ++C)
+	{
+		Hash ^= (uint8_t)*C;
+		Hash *= 0x01000193u;
+	}
+	return Hash;
+}
+
+// Live programs by GL name (see program::Find)
+static std::unordered_map<GLuint, program*> gProgramsByID;
+
+program::~program()
+{
+	gProgramsByID.erase(ID);
+	GL::DeleteProgram(ID);
+}
+
+void program::Create(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading)
+{
+	gProgramsByID.erase(ID);
+	GL::DeleteProgram(ID);
+	ID = GL::CreateProgramAsync(VSStringsCount, VSStrings, FSStringsCount, FSStrings, InjectLightShading);
+	gProgramsByID[ID] = this;
+
+	Reflected = false;
+	Uniforms.clear();
+	UniformBlocks.clear();
+	UniformIndices.clear();
+}
+
+void program::Create(const char* VSString, const char* FSString, bool InjectLightShading)
+{
+	this->Create(1, &VSString, 1, &FSString, InjectLightShading);
+}
+
+program* program::Find(GLuint ID)
+{
+	auto Found = gProgramsByID.find(ID);
+	return Found != gProgramsByID.end() ? Found->second : nullptr;
+}
+
+bool program::IsReady()
+{
+	if (Reflected)
+		return true;
+
+	// Poll every pending program, not only this one (errors are reported and binaries cached as soon as possible)
+	GL::UpdatePendingPrograms();
+	if (!GL::IsProgramReady(ID))
+		return false;
+
+	this->Reflect();
+	return true;
+}
+
+void program::Reflect()
+{
+	// A pending program must be finished first (errors reported, binary cached), blocks if still compiling
+	GL::IsProgramReady(ID, true);
+
+	Reflected = true;
+	char Name[256];
+
+	// Default block uniforms (block members have no location)
+	GLint UniformCount = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &UniformCount);
+	for (int i = 0; i < UniformCount; ++i)
+	{
+		uniform Uniform = {};
+		glGetActiveUniform(ID, i, ARRAY_SIZE(Name), nullptr, &Uniform.Size, &Uniform.Type, Name);
+		Uniform.Location = glGetUniformLocation(ID, Name);
+		if (Uniform.Location < 0)
+			continue;
+
+		// Arrays are reported as "name[0]"
+		char* ArraySuffix = strstr(Name, "[0]");
+		if (ArraySuffix && ArraySuffix[3] == '\0')
+			*ArraySuffix = '\0';
+		Uniform.Name = Name;
+
+		UniformIndices.emplace(HashName(Name), (int)Uniforms.size());
+		Uniforms.push_back(Uniform);
+	}
+
+	// Uniform blocks
+	GLint BlockCount = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &BlockCount);
+	for (int i = 0; i < BlockCount; ++i)
+	{
+		uniform_block Block = {};
+		glGetActiveUniformBlockName(ID, i, ARRAY_SIZE(Name), nullptr, Name);
+		glGetActiveUniformBlockiv(ID, i, GL_UNIFORM_BLOCK_BINDING, &Block.Binding);
+		Block.Name = Name;
+		Block.Index = i;
+		UniformBlocks.push_back(Block);
+	}
+}
+
+program::uniform* program::FindUniform(const char* Name)
+{
+	if (!Reflected)
+		this->Reflect();
+
+	uint32_t Hash = HashName(Name);
+	auto Found = UniformIndices.find(Hash);
+	if (Found != UniformIndices.end() && Uniforms[Found->second].Name == Name)
+		return Uniforms[Found->second].Location >= 0 ? &Uniforms[Found->second] : nullptr;
+
+	// Hash collision
+	for (uniform& Uniform : Uniforms)
+	{
+		if (Uniform.Name == Name)
+			return Uniform.Location >= 0 ? &Uniform : nullptr;
+	}
+
+	// Not reflected (array element or inactive uniform), query once and remember the result
+	uniform Uniform = {};
+	Uniform.Name = Name;
+	Uniform.Location = glGetUniformLocation(ID, Name);
+	Uniform.Size = 1;
+	UniformIndices.emplace(Hash, (int)Uniforms.size());
+	Uniforms.push_back(Uniform);
+
+	return Uniform.Location >= 0 ? &Uniforms.back() : nullptr;
+}
+
+// Returns false if the value is already uploaded
+bool program::UpdateValue(uniform* Uniform, const void* Value, size_t Size)
+{
+	if (Uniform->Value.size() == Size && memcmp(Uniform->Value.data(), Value, Size) == 0)
+		return false;
+
+	Uniform->Value.assign((const uint8_t*)Value, (const uint8_t*)Value + Size);
+	return true;
+}
+
+GLint program::GetUniformLocation(const char* Name)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	return Uniform ? Uniform->Location : -1;
+}
+
+void program::BindUniformBlock(const char* Name, GLuint BindingPoint)
+{
+	if (!Reflected)
+		this->Reflect();
+
+	for (uniform_block& Block : UniformBlocks)
+	{
+		if (Block.Name != Name)
+			continue;
+
+		if (Block.Binding != (GLint)BindingPoint)
+		{
+			glUniformBlockBinding(ID, Block.Index, BindingPoint);
+			Block.Binding = BindingPoint;
+		}
+		return;
+	}
+}
+
+void program::SetInt(const char* Name, int Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, &Value, sizeof(Value)))
+		glUniform1i(Uniform->Location, Value);
+}
+
+void program::SetUint(const char* Name, uint32_t Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, &Value, sizeof(Value)))
+		glUniform1ui(Uniform->Location, Value);
+}
+
+void program::SetFloat(const char* Name, float Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, &Value, sizeof(Value)))
+		glUniform1f(Uniform->Location, Value);
+}
+
+void program::SetFloatArray(const char* Name, const float* Values, int Count)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, Values, Count * sizeof(float)))
+		glUniform1fv(Uniform->Location, Count, Values);
+}
+
+void program::SetVec2(const char* Name, const v2& Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, Value.e, sizeof(Value.e)))
+		glUniform2fv(Uniform->Location, 1, Value.e);
+}
+
+void program::SetVec3(const char* Name, const v3& Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, Value.e, sizeof(Value.e)))
+		glUniform3fv(Uniform->Location, 1, Value.e);
+}
+
+void program::SetVec3Array(const char* Name, const v3* Values, int Count)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, Values, Count * sizeof(v3)))
+		glUniform3fv(Uniform->Location, Count, Values[0].e);
+}
+
+void program::SetVec4(const char* Name, const v4& Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, Value.e, sizeof(Value.e)))
+		glUniform4fv(Uniform->Location, 1, Value.e);
+}
+
+void program::SetMat3(const char* Name, const mat3& Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, Value.e, sizeof(Value.e)))
+		glUniformMatrix3fv(Uniform->Location, 1, GL_FALSE, Value.e);
+}
+
+void program::SetMat4(const char* Name, const mat4& Value)
+{
+	uniform* Uniform = this->FindUniform(Name);
+	if (Uniform && this->UpdateValue(Uniform, Value.e, sizeof(Value.e)))
+		glUniformMatrix4fv(Uniform->Location, 1, GL_FALSE, Value.e);
+}
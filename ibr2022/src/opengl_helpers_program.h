@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "opengl_headers.h"
+#include "types.h"
+
+namespace GL
+{
+	// Owns a GL program and its reflection data
+	// Active uniforms and uniform blocks are queried once after link into a hashed name table,
+	// typed setters skip the upload when the value did not change (like glUniform*, the program must be in use)
+	class program
+	{
+	public:
+		program() = default;
+		~program();
+		program(const program&) = delete;
+		program& operator=(const program&) = delete;
+
+		// Submit compiles and link in background (see GL::CreateProgramAsync)
+		void Create(int VSStringsCount, const char** VSStrings, int FSStringsCount, const char** FSStrings, bool InjectLightShading = false);
+		void Create(const char* VSString, const char* FSString, bool InjectLightShading = false);
+
+		// Poll the background link, reflection is done the first time the program is ready
+		bool IsReady();
+		// Live program created with this GL name (nullptr if none), for code that can only store the GLuint
+		static program* Find(GLuint ID);
+		void Use() const { glUseProgram(ID); }
+
+		GLint GetUniformLocation(const char* Name); // -1 if not active
+		void BindUniformBlock(const char* Name, GLuint BindingPoint);
+
+		void SetInt(const char* Name, int Value);
+		void SetUint(const char* Name, uint32_t Value);
+		void SetFloat(const char* Name, float Value);
+		void SetFloatArray(const char* Name, const float* Values, int Count);
+		void SetVec2(const char* Name, const v2& Value);
+		void SetVec3(const char* Name, const v3& Value);
+		void SetVec3Array(const char* Name, const v3* Values, int Count);
+		void SetVec4(const char* Name, const v4& Value);
+		void SetMat3(const char* Name, const mat3& Value);
+		void SetMat4(const char* Name, const mat4& Value);
+
+		GLuint ID = 0;
+
+	private:
+		struct uniform
+		{
+			std::string Name; // Without "[0]" for arrays
+			GLint Location;
+			GLenum Type;
+			GLint Size;
+			std::vector<uint8_t> Value; // Last uploaded value (empty until the first upload)
+		};
+
+		struct uniform_block
+		{
+			std::string Name;
+			GLuint Index;
+			GLint Binding;
+		};
+
+		void Reflect();
+		uniform* FindUniform(const char* Name);
+		bool UpdateValue(uniform* Uniform, const void* Value, size_t Size);
+
+		bool Reflected = false;
+		std::vector<uniform> Uniforms;
+		std::vector<uniform_block> UniformBlocks;
+		std::unordered_map<uint32_t, int> UniformIndices; // Name hash -> index in Uniforms
+	};
+}
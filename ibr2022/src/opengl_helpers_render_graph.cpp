@@ -0,0 +1,359 @@
+#include <cassert>
+
+#include "opengl_helpers_render_graph.h"
+
+using namespace GL;
+
+static bool IsDepthFormat(GLenum InternalFormat)
+{
+	return InternalFormat == GL_DEPTH_COMPONENT16 || InternalFormat == GL_DEPTH_COMPONENT24 || InternalFormat == GL_DEPTH_COMPONENT32F
+		|| InternalFormat == GL_DEPTH_COMPONENT;
+}
+
+static int BytesPerPixel(GLenum InternalFormat)
+{
+	switch (InternalFormat)
+	{
+	case GL_R8:      return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16: return 2;
+	case GL_RGBA16F: return 8;
+	case GL_RG32F:   return 8;
+	case GL_RGBA32F: return 16;
+	default:         return 4; // RGBA8, R11F_G11F_B10F, R32F, depth 24/32 (RGB8 is padded by most drivers)
+	}
+}
+
+static bool SameDesc(const render_target_desc& A, const render_target_desc& B)
+{
+	return A.Width == B.Width && A.Height == B.Height && A.InternalFormat == B.InternalFormat;
+}
+
+render_target_pool::~render_target_pool()
+{
+	for (const framebuffer& Framebuffer : Framebuffers)
+		glDeleteFramebuffers(1, &Framebuffer.FBO);
+	for (const texture& Texture : Textures)
+		glDeleteTextures(1, &Texture.Texture);
+}
+
+GLuint render_target_pool::Acquire(const render_target_desc& Desc)
+{
+	for (texture& Texture : Textures)
+	{
+		if (!Texture.InUse && SameDesc(Texture.Desc, Desc))
+		{
+			Texture.InUse = true;
+			Texture.LastUsedFrame = Frame;
+			return Texture.Texture;
+		}
+	}
+
+	texture Texture = {};
+	Texture.Desc = Desc;
+	Texture.InUse = true;
+	Texture.LastUsedFrame = Frame;
+
+	glGenTextures(1, &Texture.Texture);
+	glBindTexture(GL_TEXTURE_2D, Texture.Texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (IsDepthFormat(Desc.InternalFormat))
+		glTexImage2D(GL_TEXTURE_2D, 0, Desc.InternalFormat, Desc.Width, Desc.Height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, Desc.InternalFormat, Desc.Width, Desc.Height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Textures.push_back(Texture);
+	TextureCount++;
+	AllocatedBytes += (size_t)Desc.Width * Desc.Height * BytesPerPixel(Desc.InternalFormat);
+	return Texture.Texture;
+}
+
+void render_target_pool::Release(GLuint Texture)
+{
+	for (texture& Pooled : Textures)
+	{
+		if (Pooled.Texture == Texture)
+		{
+			Pooled.InUse = false;
+			Pooled.LastUsedFrame = Frame;
+			return;
+		}
+	}
+	assert(false && "Texture not acquired from this pool");
+}
+
+GLuint render_target_pool::GetFramebuffer(GLuint ColorTexture, GLuint DepthTexture)
+{
+	for (const framebuffer& Framebuffer : Framebuffers)
+	{
+		if (Framebuffer.ColorTexture == ColorTexture && Framebuffer.DepthTexture == DepthTexture)
+			return Framebuffer.FBO;
+	}
+
+	framebuffer Framebuffer = { ColorTexture, DepthTexture, 0 };
+	glGenFramebuffers(1, &Framebuffer.FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer.FBO);
+	if (ColorTexture)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ColorTexture, 0);
+	}
+	else
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	if (DepthTexture)
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, DepthTexture, 0);
+
+	Framebuffers.push_back(Framebuffer);
+	FramebufferCount++;
+	return Framebuffer.FBO;
+}
+
+void render_target_pool::DeleteTexture(int Index)
+{
+	GLuint Texture = Textures[Index].Texture;
+
+	// Framebuffers using it
+	for (int i = (int)Framebuffers.size() - 1; i >= 0; --i)
+	{
+		if (Framebuffers[i].ColorTexture == Texture || Framebuffers[i].DepthTexture == Texture)
+		{
+			glDeleteFramebuffers(1, &Framebuffers[i].FBO);
+			Framebuffers[i] = Framebuffers.back();
+			Framebuffers.pop_back();
+			FramebufferCount--;
+		}
+	}
+
+	const render_target_desc& Desc = Textures[Index].Desc;
+	AllocatedBytes -= (size_t)Desc.Width * Desc.Height * BytesPerPixel(Desc.InternalFormat);
+	TextureCount--;
+
+	glDeleteTextures(1, &Texture);
+	Textures[Index] = Textures.back();
+	Textures.pop_back();
+}
+
+void render_target_pool::BeginFrame(double Time)
+{
+	if (Time == FrameTime)
+		return;
+
+	FrameTime = Time;
+	Frame++;
+}
+
+void render_target_pool::Collect()
+{
+	for (int i = (int)Textures.size() - 1; i >= 0; --i)
+	{
+		if (!Textures[i].InUse && Frame - Textures[i].LastUsedFrame > EvictionFrames)
+			this->DeleteTexture(i);
+	}
+}
+
+pass_timer::~pass_timer()
+{
+	if (Queries[0])
+		glDeleteQueries(2, Queries);
+}
+
+render_graph::render_graph(render_target_pool& Pool)
+	: Pool(Pool)
+{
+}
+
+render_graph::resource render_graph::Create(const char* Name, const render_target_desc& Desc)
+{
+	resource_node Resource = {};
+	Resource.Name = Name;
+	Resource.Desc = Desc;
+	Resources.push_back(Resource);
+	return (resource)Resources.size() - 1;
+}
+
+render_graph::resource render_graph::Import(const char* Name, GLuint Texture, int Width, int Height)
+{
+	resource_node Resource = {};
+	Resource.Name = Name;
+	Resource.Desc = { Width, Height, GL_NONE };
+	Resource.Texture = Texture;
+	Resource.Imported = true;
+	Resources.push_back(Resource);
+	return (resource)Resources.size() - 1;
+}
+
+render_graph::resource render_graph::ImportTarget(const char* Name, GLuint PoolTexture, const render_target_desc& Desc)
+{
+	resource_node Resource = {};
+	Resource.Name = Name;
+	Resource.Desc = Desc;
+	Resource.Texture = PoolTexture;
+	Resource.Imported = true;
+	Resource.Writable = true;
+	Resources.push_back(Resource);
+	return (resource)Resources.size() - 1;
+}
+
+int render_graph::AddPass(const char* Name, execute_function Execute)
+{
+	pass_node Pass = {};
+	Pass.Name = Name;
+	Pass.Execute = std::move(Execute);
+	Passes.push_back(std::move(Pass));
+	return (int)Passes.size() - 1;
+}
+
+void render_graph::Read(int Pass, resource Resource)
+{
+	Passes[Pass].Reads.push_back(Resource);
+}
+
+void render_graph::Write(int Pass, resource Resource)
+{
+	assert((!Resources[Resource].Imported || Resources[Resource].Writable) && "Imported resources are read only");
+	Passes[Pass].Writes.push_back(Resource);
+}
+
+void render_graph::BeginTimer(pass_timer& Timer)
+{
+	if (Timer.Queries[0] == 0)
+		glGenQueries(2, Timer.Queries);
+
+	if (Timer.Pending)
+	{
+		GLint Available = 0;
+		glGetQueryObjectiv(Timer.Queries[1], GL_QUERY_RESULT_AVAILABLE, &Available);
+		if (Available)
+		{
+			GLuint64 Start = 0;
+			GLuint64 End = 0;
+			glGetQueryObjectui64v(Timer.Queries[0], GL_QUERY_RESULT, &Start);
+			glGetQueryObjectui64v(Timer.Queries[1], GL_QUERY_RESULT, &End);
+			Timer.Time = (End - Start) / 1000000.0;
+			Timer.Pending = false;
+		}
+	}
+
+	// Root passes are never culled and keep the submission order
+	Timer.Measuring = !Timer.Pending;
+	if (Timer.Measuring)
+	{
+		GLuint Query = Timer.Queries[0];
+		this->AddPass("Timer start", [=](render_graph&) { glQueryCounter(Query, GL_TIMESTAMP); });
+	}
+}
+
+void render_graph::EndTimer(pass_timer& Timer)
+{
+	if (!Timer.Measuring)
+		return;
+
+	GLuint Query = Timer.Queries[1];
+	this->AddPass("Timer end", [=](render_graph&) { glQueryCounter(Query, GL_TIMESTAMP); });
+	Timer.Measuring = false;
+	Timer.Pending = true;
+}
+
+void render_graph::BindFramebuffer(resource Color, resource Depth)
+{
+	GLuint ColorTexture = (Color >= 0) ? Resources[Color].Texture : 0;
+	GLuint DepthTexture = (Depth >= 0) ? Resources[Depth].Texture : 0;
+	const render_target_desc& Desc = Resources[(Color >= 0) ? Color : Depth].Desc;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, Pool.GetFramebuffer(ColorTexture, DepthTexture));
+	glViewport(0, 0, Desc.Width, Desc.Height);
+}
+
+void render_graph::Execute(double Time)
+{
+	Pool.BeginFrame(Time);
+
+	// Cull: walk back from the root passes, a pass is alive if a later alive pass reads what it writes
+	for (int p = (int)Passes.size() - 1; p >= 0; --p)
+	{
+		pass_node& Pass = Passes[p];
+		Pass.Alive = Pass.Writes.empty();
+		for (resource Resource : Pass.Writes)
+			Pass.Alive |= Resources[Resource].Needed;
+
+		if (Pass.Alive)
+		{
+			for (resource Resource : Pass.Reads)
+				Resources[Resource].Needed = true;
+		}
+	}
+
+	// Lifetimes of the transient resources (first and last alive pass using them)
+	for (resource_node& Resource : Resources)
+	{
+		Resource.FirstPass = -1;
+		Resource.LastPass = -1;
+	}
+	for (int p = 0; p < (int)Passes.size(); ++p)
+	{
+		if (!Passes[p].Alive)
+			continue;
+
+		for (int Access = 0; Access < 2; ++Access)
+		{
+			for (resource Resource : (Access == 0) ? Passes[p].Reads : Passes[p].Writes)
+			{
+				resource_node& Node = Resources[Resource];
+				if (Node.FirstPass == -1)
+					Node.FirstPass = p;
+				Node.LastPass = p;
+			}
+		}
+	}
+
+	ExecutedPassCount = 0;
+	CulledPassCount = 0;
+	TransientCount = 0;
+	std::vector<GLuint> PhysicalTextures;
+	for (int p = 0; p < (int)Passes.size(); ++p)
+	{
+		if (!Passes[p].Alive)
+		{
+			CulledPassCount++;
+			continue;
+		}
+
+		for (resource_node& Resource : Resources)
+		{
+			if (Resource.Imported || Resource.FirstPass != p)
+				continue;
+
+			Resource.Texture = Pool.Acquire(Resource.Desc);
+			TransientCount++;
+			bool Found = false;
+			for (GLuint Texture : PhysicalTextures)
+				Found |= (Texture == Resource.Texture);
+			if (!Found)
+				PhysicalTextures.push_back(Resource.Texture);
+		}
+
+		Passes[p].Execute(*this);
+		ExecutedPassCount++;
+
+		// Released textures can be acquired by the next passes
+		for (resource_node& Resource : Resources)
+		{
+			if (!Resource.Imported && Resource.LastPass == p)
+				Pool.Release(Resource.Texture);
+		}
+	}
+	PhysicalTextureCount = (int)PhysicalTextures.size();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	Pool.Collect();
+
+	Resources.clear();
+	Passes.clear();
+}
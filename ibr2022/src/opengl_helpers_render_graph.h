@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "opengl_headers.h"
+
+namespace GL
+{
+	struct render_target_desc
+	{
+		int Width;
+		int Height;
+		GLenum InternalFormat; // Color (GL_RGBA8, GL_RGBA16F...) or depth (GL_DEPTH_COMPONENT24...) format
+	};
+
+	// Render target textures shared by every render graph (and every demo, the pool is owned by GL::cache)
+	// Released textures are reused by the next acquire with the same description, deleted after EvictionFrames frames unused
+	class render_target_pool
+	{
+	public:
+		~render_target_pool();
+
+		GLuint Acquire(const render_target_desc& Desc);
+		void Release(GLuint Texture);
+		// Framebuffer with these attachments (pool textures only), created once, deleted with its textures
+		GLuint GetFramebuffer(GLuint ColorTexture, GLuint DepthTexture);
+		// Deletes the textures unused for EvictionFrames frames (called by render_graph::Execute)
+		void Collect();
+		// Called by render_graph::Execute, the frame only advances once per application frame (Time: platform_io::Time),
+		// whatever the number of graphs executed
+		void BeginFrame(double Time);
+
+		int EvictionFrames = 60;
+
+		// Stats
+		int TextureCount = 0;
+		int FramebufferCount = 0;
+		size_t AllocatedBytes = 0;
+
+	private:
+		struct texture
+		{
+			GLuint Texture;
+			render_target_desc Desc;
+			bool InUse;
+			int LastUsedFrame;
+		};
+
+		struct framebuffer
+		{
+			GLuint ColorTexture;
+			GLuint DepthTexture;
+			GLuint FBO;
+		};
+
+		void DeleteTexture(int Index);
+
+		std::vector<texture> Textures;
+		std::vector<framebuffer> Framebuffers;
+		int Frame = 0;
+		double FrameTime = -1.0;
+	};
+
+	// GPU time of a range of passes (timestamps written by two root passes), read a few frames later without stalling
+	struct pass_timer
+	{
+		~pass_timer();
+
+		GLuint Queries[2] = {};
+		bool Pending = false; // Timestamps submitted, result not read yet
+		bool Measuring = false;
+		double Time = 0.0; // ms
+	};
+
+	// Frame graph, rebuilt every frame: passes declare the resources they read and write, then Execute
+	//  - culls the passes that do not contribute to a root pass (a pass writing no resource, e.g. drawing to the screen)
+	//  - acquires transient targets from the pool at their first use and releases them after their last one,
+	//    targets with disjoint lifetimes share the same texture
+	class render_graph
+	{
+	public:
+		typedef int resource;
+		typedef std::function<void(render_graph&)> execute_function;
+
+		render_graph(render_target_pool& Pool);
+		const render_target_pool& GetPool() const { return Pool; }
+
+		resource Create(const char* Name, const render_target_desc& Desc);
+		// External texture, read only (kept alive by its owner)
+		resource Import(const char* Name, GLuint Texture, int Width, int Height);
+		// Persistent target that passes can write (e.g. history), acquired from the pool and kept by its owner across frames
+		resource ImportTarget(const char* Name, GLuint PoolTexture, const render_target_desc& Desc);
+		render_target_desc GetDesc(resource Resource) const { return Resources[Resource].Desc; }
+
+		int AddPass(const char* Name, execute_function Execute);
+		void Read(int Pass, resource Resource);
+		void Write(int Pass, resource Resource);
+
+		// Passes added between BeginTimer and EndTimer are measured by Timer
+		void BeginTimer(pass_timer& Timer);
+		void EndTimer(pass_timer& Timer);
+
+		// Run the passes in submission order and clear the graph (Time: platform_io::Time of the current frame)
+		void Execute(double Time);
+
+		// During pass execution
+		GLuint GetTexture(resource Resource) const { return Resources[Resource].Texture; }
+		// Bind the framebuffer of written targets and set the viewport to their size
+		void BindFramebuffer(resource Color, resource Depth = -1);
+
+		// Stats of the last Execute
+		int ExecutedPassCount = 0;
+		int CulledPassCount = 0;
+		int TransientCount = 0;       // Transient resources used by the executed passes
+		int PhysicalTextureCount = 0; // Pool textures behind them
+
+	private:
+		struct resource_node
+		{
+			const char* Name;
+			render_target_desc Desc;
+			GLuint Texture;
+			bool Imported;
+			bool Writable;
+			bool Needed;
+			int FirstPass;
+			int LastPass;
+		};
+
+		struct pass_node
+		{
+			const char* Name;
+			execute_function Execute;
+			std::vector<resource> Reads;
+			std::vector<resource> Writes;
+			bool Alive;
+		};
+
+		render_target_pool& Pool;
+		std::vector<resource_node> Resources;
+		std::vector<pass_node> Passes;
+	};
+}
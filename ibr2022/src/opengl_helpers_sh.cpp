@@ -0,0 +1,157 @@
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "maths.h"
+
+#include "opengl_helpers_program.h"
+#include "opengl_helpers_sh.h"
+
+using namespace GL;
+
+// Real SH basis constants (bands 0, 1, 2)
+static const float SH_Y0  = 0.282095f;
+static const float SH_Y1  = 0.488603f;
+static const float SH_Y2  = 1.092548f;
+static const float SH_Y20 = 0.315392f;
+static const float SH_Y22 = 0.546274f;
+
+static void EvaluateBasis(v3 N, float* Basis)
+{
+	Basis[0] = SH_Y0;
+	Basis[1] = SH_Y1 * N.y;
+	Basis[2] = SH_Y1 * N.z;
+	Basis[3] = SH_Y1 * N.x;
+	Basis[4] = SH_Y2 * N.x * N.y;
+	Basis[5] = SH_Y2 * N.y * N.z;
+	Basis[6] = SH_Y20 * (3.f * N.z * N.z - 1.f);
+	Basis[7] = SH_Y2 * N.x * N.z;
+	Basis[8] = SH_Y22 * (N.x * N.x - N.y * N.y);
+}
+
+// Direction of a cubemap texel, (S, T) in [-1, 1] (GL cube map face orientations)
+static v3 CubemapDirection(int Face, float S, float T)
+{
+	switch (Face)
+	{
+	case 0:  return {  1.f,  -T,  -S };
+	case 1:  return { -1.f,  -T,   S };
+	case 2:  return {    S, 1.f,   T };
+	case 3:  return {    S,-1.f,  -T };
+	case 4:  return {    S,  -T, 1.f };
+	default: return {   -S,  -T,-1.f };
+	}
+}
+
+// Weighted sums of a range of rows (over the 6 faces)
+struct sh_accumulator
+{
+	double Coefs[9][3];
+	double Weight;
+};
+
+static void AccumulateRows(const uint8_t* const Faces[6], int Width, int Height, int Channels, int FirstRow, int EndRow, sh_accumulator* Result)
+{
+	*Result = {};
+	float Basis[9];
+	for (int Row = FirstRow; Row < EndRow; ++Row)
+	{
+		int Face = Row / Height;
+		int Y = Row % Height;
+		float T = 2.f * (Y + 0.5f) / Height - 1.f;
+		const uint8_t* Texel = Faces[Face] + (size_t)Y * Width * Channels;
+
+		// Accumulate the row in float, the total in double
+		float RowCoefs[9][3] = {};
+		float RowWeight = 0.f;
+		for (int X = 0; X < Width; ++X, Texel += Channels)
+		{
+			float S = 2.f * (X + 0.5f) / Width - 1.f;
+			float Length2 = 1.f + S * S + T * T;
+			float SolidAngle = 1.f / (Length2 * sqrtf(Length2));
+
+			v3 Color;
+			Color.x = Texel[0] / 255.f;
+			Color.y = (Channels >= 3) ? Texel[1] / 255.f : Color.x;
+			Color.z = (Channels >= 3) ? Texel[2] / 255.f : Color.x;
+
+			EvaluateBasis(Vec3::Normalize(CubemapDirection(Face, S, T)), Basis);
+			for (int i = 0; i < 9; ++i)
+			{
+				float Weight = Basis[i] * SolidAngle;
+				RowCoefs[i][0] += Color.x * Weight;
+				RowCoefs[i][1] += Color.y * Weight;
+				RowCoefs[i][2] += Color.z * Weight;
+			}
+			RowWeight += SolidAngle;
+		}
+
+		for (int i = 0; i < 9; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+				Result->Coefs[i][c] += RowCoefs[i][c];
+		}
+		Result->Weight += RowWeight;
+	}
+}
+
+sh9 GL::ProjectCubemapSH(const uint8_t* const Faces[6], int Width, int Height, int Channels, int ThreadCount)
+{
+	if (ThreadCount <= 0)
+		ThreadCount = Math::Max((int)std::thread::hardware_concurrency(), 1);
+
+	int RowCount = 6 * Height;
+	ThreadCount = Math::Min(ThreadCount, RowCount);
+
+	// Split rows between threads, the calling thread takes the first range
+	std::vector<sh_accumulator> Accumulators(ThreadCount);
+	std::vector<std::thread> Threads;
+	for (int i = 1; i < ThreadCount; ++i)
+	{
+		int FirstRow = RowCount * i / ThreadCount;
+		int EndRow = RowCount * (i + 1) / ThreadCount;
+		Threads.emplace_back(AccumulateRows, Faces, Width, Height, Channels, FirstRow, EndRow, &Accumulators[i]);
+	}
+	AccumulateRows(Faces, Width, Height, Channels, 0, RowCount / ThreadCount, &Accumulators[0]);
+	for (std::thread& Thread : Threads)
+		Thread.join();
+
+	sh_accumulator Total = {};
+	for (const sh_accumulator& Accumulator : Accumulators)
+	{
+		for (int i = 0; i < 9; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+				Total.Coefs[i][c] += Accumulator.Coefs[i][c];
+		}
+		Total.Weight += Accumulator.Weight;
+	}
+
+	// Normalize the weights to the sphere area (4 pi), then apply the cosine lobe convolution / pi per band
+	static const double BandFactors[9] = { 1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25 };
+	double Scale = (Total.Weight > 0.0) ? 4.0 * Math::Pi() / Total.Weight : 0.0;
+
+	sh9 Result;
+	for (int i = 0; i < 9; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			Result.Coefs[i].e[c] = (float)(Total.Coefs[i][c] * Scale * BandFactors[i]);
+	}
+	return Result;
+}
+
+v3 GL::EvaluateSH(const sh9& SH, v3 Normal)
+{
+	float Basis[9];
+	EvaluateBasis(Normal, Basis);
+
+	v3 Result = {};
+	for (int i = 0; i < 9; ++i)
+		Result += SH.Coefs[i] * Basis[i];
+	return Result;
+}
+
+void GL::UniformSH(program& Program, const char* Name, const sh9& SH)
+{
+	Program.SetVec3Array(Name, SH.Coefs, 9);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include "opengl_headers.h"
+#include "types.h"
+
+namespace GL
+{
+    class program;
+
+    // Order 2 spherical harmonics (9 RGB coefficients)
+    // Coefficients produced by ProjectCubemapSH are already convolved with the clamped cosine lobe (and divided by pi),
+    // so the shader gets the diffuse ambient color of a normal with sh_irradiance(uSH, n) (injected with the light shading)
+    struct sh9
+    {
+        v3 Coefs[9];
+    };
+
+    // Project 6 cubemap faces (+X, -X, +Y, -Y, +Z, -Z, 8 bits per channel, 1 to 4 channels, rows as uploaded to GL)
+    // Texels are weighted by their solid angle, faces rows are split between ThreadCount threads (0: hardware concurrency)
+    sh9 ProjectCubemapSH(const uint8_t* const Faces[6], int Width, int Height, int Channels, int ThreadCount = 0);
+
+    // Evaluate in C++ (same result as sh_irradiance in glsl)
+    v3 EvaluateSH(const sh9& SH, v3 Normal);
+
+    // Upload to a 'uniform vec3 Name[9]' (the program must be in use)
+    void UniformSH(program& Program, const char* Name, const sh9& SH);
+}
@@ -0,0 +1,23 @@
+#include <cstdio>
+
+#include "opengl_helpers_std140.h"
+
+using namespace GL;
+
+std::string Std140::GenerateStruct(const char* Name, const member* Members, size_t Count)
+{
+	std::string Result = std::string("struct ") + Name + "\n{\n";
+
+	char Line[256];
+	for (size_t i = 0; i < Count; ++i)
+	{
+		const member& Member = Members[i];
+		snprintf(Line, sizeof(Line), "    %s %s; // offset %d%s%s\n", Member.Type, Member.Name, (int)Offset(Members, i),
+			Member.Comment[0] ? ", " : "", Member.Comment);
+		Result += Line;
+	}
+
+	snprintf(Line, sizeof(Line), "}; // size %d\n", (int)Size(Members, Count));
+	Result += Line;
+	return Result;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+namespace GL
+{
+    // Describe a struct once (C++ member + glsl name), offsets are computed with the std140 rules
+    // so the C++ layout can be checked at compile time and the glsl declaration generated from it
+    namespace Std140
+    {
+        // glsl type, size and base alignment of a C++ member type
+        template<typename T> struct glsl_type;
+        template<> struct glsl_type<float>    { static constexpr const char* Name = "float"; static constexpr size_t Size = 4;  static constexpr size_t Alignment = 4;  };
+        template<> struct glsl_type<int32_t>  { static constexpr const char* Name = "int";   static constexpr size_t Size = 4;  static constexpr size_t Alignment = 4;  };
+        template<> struct glsl_type<uint32_t> { static constexpr const char* Name = "uint";  static constexpr size_t Size = 4;  static constexpr size_t Alignment = 4;  };
+        template<> struct glsl_type<v2>       { static constexpr const char* Name = "vec2";  static constexpr size_t Size = 8;  static constexpr size_t Alignment = 8;  };
+        template<> struct glsl_type<v3>       { static constexpr const char* Name = "vec3";  static constexpr size_t Size = 12; static constexpr size_t Alignment = 16; };
+        template<> struct glsl_type<v4>       { static constexpr const char* Name = "vec4";  static constexpr size_t Size = 16; static constexpr size_t Alignment = 16; };
+        template<> struct glsl_type<mat4>     { static constexpr const char* Name = "mat4";  static constexpr size_t Size = 64; static constexpr size_t Alignment = 16; };
+
+        struct member
+        {
+            const char* Type;
+            const char* Name;
+            size_t Size;
+            size_t Alignment;
+            size_t CppOffset;
+            const char* Comment;
+        };
+
+        constexpr size_t AlignUp(size_t Value, size_t Alignment)
+        {
+            return (Value + Alignment - 1) / Alignment * Alignment;
+        }
+
+        // std140 offset of Members[Index] (each member goes right after the previous one, at its base alignment)
+        constexpr size_t Offset(const member* Members, size_t Index)
+        {
+            size_t Result = 0;
+            for (size_t i = 0; i < Index; ++i)
+                Result = AlignUp(Result, Members[i].Alignment) + Members[i].Size;
+            return AlignUp(Result, Members[Index].Alignment);
+        }
+
+        // Struct size (rounded to a vec4, which is also the stride in arrays)
+        constexpr size_t Size(const member* Members, size_t Count)
+        {
+            return AlignUp(Offset(Members, Count - 1) + Members[Count - 1].Size, 16);
+        }
+
+        // True if the C++ struct matches the std140 layout
+        constexpr bool Matches(const member* Members, size_t Count, size_t CppSize)
+        {
+            for (size_t i = 0; i < Count; ++i)
+            {
+                if (Members[i].CppOffset != Offset(Members, i))
+                    return false;
+            }
+            return Size(Members, Count) == CppSize;
+        }
+
+        template<size_t N>
+        constexpr bool Matches(const member (&Members)[N], size_t CppSize)
+        {
+            return Matches(Members, N, CppSize);
+        }
+
+        // "struct <Name> { ... };" glsl declaration
+        std::string GenerateStruct(const char* Name, const member* Members, size_t Count);
+
+        template<size_t N>
+        std::string GenerateStruct(const char* Name, const member (&Members)[N])
+        {
+            return GenerateStruct(Name, Members, N);
+        }
+    }
+}
+
+#define STD140_MEMBER(Struct, Member, GLSLName, Comment) \
+    { GL::Std140::glsl_type<decltype(Struct::Member)>::Name, GLSLName, \
+      GL::Std140::glsl_type<decltype(Struct::Member)>::Size, GL::Std140::glsl_type<decltype(Struct::Member)>::Alignment, \
+      offsetof(Struct, Member), Comment }
@@ -0,0 +1,309 @@
+#include "opengl_helpers_taa.h"
+
+using namespace GL;
+
+#pragma region taa_shaders
+// Fullscreen triangle
+static const char* gVertexShaderStr = R"GLSL(
+out vec2 vUV;
+
+void main()
+{
+    vUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+})GLSL";
+
+// Velocity (unjittered current UV - previous UV) of the surface seen by each pixel, static scene so camera motion only
+static const char* gFragmentVelocityShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uDepth;
+uniform mat4 uReprojection; // Previous view projection * inverse(jittered view projection)
+uniform vec2 uJitter;       // UV
+
+out vec2 oVelocity;
+
+void main()
+{
+    float depth = texelFetch(uDepth, ivec2(gl_FragCoord.xy), 0).r;
+    vec4 previous = uReprojection * vec4(vec3(vUV, depth) * 2.0 - 1.0, 1.0);
+    vec2 previousUV = previous.xy / previous.w * 0.5 + 0.5;
+    oVelocity = (vUV - uJitter) - previousUV;
+})GLSL";
+
+// Drawn at output resolution, input samples are at their jittered positions
+static const char* gFragmentResolveShaderStr = R"GLSL(
+in vec2 vUV;
+
+uniform sampler2D uColor;    // Input resolution
+uniform sampler2D uDepth;    // Input resolution
+uniform sampler2D uVelocity; // Input resolution
+uniform sampler2D uHistory;  // Output resolution
+uniform vec2 uJitter;        // UV
+uniform float uBlend;
+uniform int uHistoryValid;
+
+out vec4 oColor;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 rgb_to_ycocg(vec3 c)
+{
+    return vec3(dot(c, vec3(0.25, 0.5, 0.25)), dot(c, vec3(0.5, 0.0, -0.5)), dot(c, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 ycocg_to_rgb(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// Bicubic Catmull-Rom with 9 bilinear fetches (sharper than bilinear, history does not blur over frames)
+vec3 sample_catmull_rom(sampler2D tex, vec2 uv)
+{
+    vec2 size = vec2(textureSize(tex, 0));
+    vec2 samplePos = uv * size;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    // Middle taps merged into one bilinear fetch
+    vec2 w12 = w1 + w2;
+    vec2 texPos0 = (texPos1 - 1.0) / size;
+    vec2 texPos3 = (texPos1 + 2.0) / size;
+    vec2 texPos12 = (texPos1 + w2 / w12) / size;
+
+    vec3 result = texture(tex, vec2(texPos0.x,  texPos0.y)).rgb  * w0.x  * w0.y
+                + texture(tex, vec2(texPos12.x, texPos0.y)).rgb  * w12.x * w0.y
+                + texture(tex, vec2(texPos3.x,  texPos0.y)).rgb  * w3.x  * w0.y
+                + texture(tex, vec2(texPos0.x,  texPos12.y)).rgb * w0.x  * w12.y
+                + texture(tex, vec2(texPos12.x, texPos12.y)).rgb * w12.x * w12.y
+                + texture(tex, vec2(texPos3.x,  texPos12.y)).rgb * w3.x  * w12.y
+                + texture(tex, vec2(texPos0.x,  texPos3.y)).rgb  * w0.x  * w3.y
+                + texture(tex, vec2(texPos12.x, texPos3.y)).rgb  * w12.x * w3.y
+                + texture(tex, vec2(texPos3.x,  texPos3.y)).rgb  * w3.x  * w3.y;
+    return max(result, vec3(0.0));
+}
+
+// Moves the history towards the box center until it is inside (keeps its hue, unlike a clamp)
+vec3 clip_aabb(vec3 boxMin, vec3 boxMax, vec3 history)
+{
+    vec3 center = 0.5 * (boxMax + boxMin);
+    vec3 extents = 0.5 * (boxMax - boxMin) + 1e-5;
+    vec3 offset = history - center;
+    vec3 unit = abs(offset / extents);
+    float maxUnit = max(unit.x, max(unit.y, unit.z));
+    return (maxUnit > 1.0) ? center + offset / maxUnit : history;
+}
+
+void main()
+{
+    vec2 inputSize = vec2(textureSize(uColor, 0));
+    vec2 outputSize = vec2(textureSize(uHistory, 0));
+
+    // Input pixel whose jittered sample is the closest to this output pixel
+    ivec2 center = ivec2(floor((vUV + uJitter) * inputSize));
+    ivec2 maxPixel = ivec2(inputSize) - 1;
+
+    // 3x3 input samples: reconstruction (gaussian of the distance in output pixels), neighbourhood moments, closest depth
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+    float closestWeight = 0.0;
+    vec3 m1 = vec3(0.0);
+    vec3 m2 = vec3(0.0);
+    float closestDepth = 1.0;
+    ivec2 closestPixel = center;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            ivec2 pixel = clamp(center + ivec2(x, y), ivec2(0), maxPixel);
+            vec3 color = texelFetch(uColor, pixel, 0).rgb;
+
+            vec2 d = ((vec2(pixel) + 0.5) / inputSize - uJitter - vUV) * outputSize;
+            float weight = exp(-2.29 * dot(d, d));
+            sum += color * weight;
+            weightSum += weight;
+            closestWeight = max(closestWeight, weight);
+
+            vec3 ycocg = rgb_to_ycocg(color);
+            m1 += ycocg;
+            m2 += ycocg * ycocg;
+
+            float depth = texelFetch(uDepth, pixel, 0).r;
+            if (depth < closestDepth)
+            {
+                closestDepth = depth;
+                closestPixel = pixel;
+            }
+        }
+    }
+    vec3 current = sum / max(weightSum, 1e-5);
+
+    // Velocity of the front-most neighbour, edges of moving objects are reprojected with them
+    vec2 historyUV = vUV - texelFetch(uVelocity, closestPixel, 0).rg;
+    if (uHistoryValid == 0 || any(lessThan(historyUV, vec2(0.0))) || any(greaterThan(historyUV, vec2(1.0))))
+    {
+        oColor = vec4(texture(uColor, vUV + uJitter).rgb, 1.0);
+        return;
+    }
+
+    // Variance clipping
+    vec3 mean = m1 / 9.0;
+    vec3 sigma = sqrt(max(m2 / 9.0 - mean * mean, vec3(0.0)));
+    vec3 history = sample_catmull_rom(uHistory, historyUV);
+    history = ycocg_to_rgb(clip_aabb(mean - sigma, mean + sigma, rgb_to_ycocg(history)));
+
+    // Less weight to the current frame when no input sample is near this output pixel (upsampling)
+    // Blend in 1 / (1 + luma) space, bright samples do not flicker
+    float alpha = uBlend * closestWeight;
+    float currentWeight = alpha / (1.0 + luma(current));
+    float historyWeight = (1.0 - alpha) / (1.0 + luma(history));
+    oColor = vec4((current * currentWeight + history * historyWeight) / (currentWeight + historyWeight), 1.0);
+})GLSL";
+#pragma endregion taa_shaders
+
+static float Halton(int Index, int Base)
+{
+	float Fraction = 1.f;
+	float Result = 0.f;
+	while (Index > 0)
+	{
+		Fraction /= Base;
+		Result += Fraction * (Index % Base);
+		Index /= Base;
+	}
+	return Result;
+}
+
+taa::taa(render_target_pool& Pool)
+	: Pool(Pool)
+{
+	VelocityProgram.Create(gVertexShaderStr, gFragmentVelocityShaderStr);
+	ResolveProgram.Create(gVertexShaderStr, gFragmentResolveShaderStr);
+	glGenVertexArrays(1, &EmptyVAO);
+}
+
+taa::~taa()
+{
+	if (History[0])
+	{
+		Pool.Release(History[0]);
+		Pool.Release(History[1]);
+	}
+	glDeleteVertexArrays(1, &EmptyVAO);
+}
+
+void taa::NextJitter(int InputWidth, int OutputWidth)
+{
+	float Ratio = (float)OutputWidth / Math::Max(InputWidth, 1);
+	PhaseCount = Math::Clamp((int)ceilf(8.f * Ratio * Ratio), 8, 64);
+
+	JitterIndex = JitterIndex % PhaseCount + 1;
+	Jitter = { Halton(JitterIndex, 2) - 0.5f, Halton(JitterIndex, 3) - 0.5f };
+}
+
+mat4 taa::JitterProjection(const mat4& Projection, int InputWidth, int InputHeight) const
+{
+	return Mat4::Jitter(Projection, { 2.f * Jitter.x / InputWidth, 2.f * Jitter.y / InputHeight });
+}
+
+render_graph::resource taa::AddPasses(render_graph& Graph, render_graph::resource Color, render_graph::resource Depth,
+	const mat4& ViewProjection, int OutputWidth, int OutputHeight)
+{
+	if (!VelocityProgram.IsReady() || !ResolveProgram.IsReady())
+	{
+		HistoryValid = false;
+		return -1;
+	}
+
+	// History at output size, kept while the size does not change
+	render_target_desc Desc = { OutputWidth, OutputHeight, GL_RGBA16F };
+	if (History[0] == 0 || HistoryDesc.Width != Desc.Width || HistoryDesc.Height != Desc.Height)
+	{
+		if (History[0])
+		{
+			Pool.Release(History[0]);
+			Pool.Release(History[1]);
+		}
+		History[0] = Pool.Acquire(Desc);
+		History[1] = Pool.Acquire(Desc);
+		HistoryDesc = Desc;
+		HistoryValid = false;
+	}
+
+	render_target_desc InputDesc = Graph.GetDesc(Color);
+	v2 JitterUV = { Jitter.x / InputDesc.Width, Jitter.y / InputDesc.Height };
+	mat4 JitteredViewProjection = this->JitterProjection(ViewProjection, InputDesc.Width, InputDesc.Height);
+	mat4 Reprojection = (HistoryValid ? PreviousViewProjection : ViewProjection) * Mat4::Inverse(JitteredViewProjection);
+
+	GLuint VAO = EmptyVAO;
+	program* Velocity = &VelocityProgram;
+	program* Resolve = &ResolveProgram;
+	float PassBlend = Blend;
+	int PassHistoryValid = HistoryValid ? 1 : 0;
+
+	// Velocity
+	render_graph::resource VelocityTarget = Graph.Create("TAA velocity", { InputDesc.Width, InputDesc.Height, GL_RG16F });
+	int VelocityPass = Graph.AddPass("TAA velocity", [=](render_graph& PassGraph)
+	{
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		Velocity->Use();
+		Velocity->SetInt("uDepth", 0);
+		Velocity->SetMat4("uReprojection", Reprojection);
+		Velocity->SetVec2("uJitter", JitterUV);
+		PassGraph.BindFramebuffer(VelocityTarget);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Depth));
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	});
+	Graph.Read(VelocityPass, Depth);
+	Graph.Write(VelocityPass, VelocityTarget);
+
+	// Resolve into the current history
+	render_graph::resource Previous = Graph.Import("TAA previous history", History[1 - HistoryIndex], OutputWidth, OutputHeight);
+	render_graph::resource Output = Graph.ImportTarget("TAA history", History[HistoryIndex], Desc);
+	int ResolvePass = Graph.AddPass("TAA resolve", [=](render_graph& PassGraph)
+	{
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		Resolve->Use();
+		Resolve->SetInt("uColor", 0);
+		Resolve->SetInt("uDepth", 1);
+		Resolve->SetInt("uVelocity", 2);
+		Resolve->SetInt("uHistory", 3);
+		Resolve->SetVec2("uJitter", JitterUV);
+		Resolve->SetFloat("uBlend", PassBlend);
+		Resolve->SetInt("uHistoryValid", PassHistoryValid);
+		PassGraph.BindFramebuffer(Output);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Previous));
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(VelocityTarget));
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Depth));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Color));
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	});
+	Graph.Read(ResolvePass, Color);
+	Graph.Read(ResolvePass, Depth);
+	Graph.Read(ResolvePass, VelocityTarget);
+	Graph.Read(ResolvePass, Previous);
+	Graph.Write(ResolvePass, Output);
+
+	// This frame becomes the previous one
+	PreviousViewProjection = ViewProjection;
+	HistoryIndex = 1 - HistoryIndex;
+	HistoryValid = true;
+	return Output;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "maths.h"
+
+#include "opengl_headers.h"
+#include "opengl_helpers_program.h"
+#include "opengl_helpers_render_graph.h"
+
+namespace GL
+{
+	// Temporal anti-aliasing, also used as a temporal upsampler (input smaller than the output):
+	//  - the scene is rendered with a sub-pixel jitter (Halton 2,3) added to the projection (JitterProjection)
+	//  - velocity pass: camera motion from the depth and the current/previous view projections (RG16F, input resolution)
+	//  - resolve pass: jittered samples reconstructed at output resolution, blended with the reprojected history
+	//    (Catmull-Rom fetch, clipped to the YCoCg neighbourhood, 1 / (1 + luma) weights)
+	// History textures are acquired from the pool and kept across frames
+	class taa
+	{
+	public:
+		taa(render_target_pool& Pool);
+		~taa();
+
+		// Next jitter, call once per frame before rendering the scene
+		// More phases when upsampling so each output pixel gets enough samples
+		void NextJitter(int InputWidth, int OutputWidth);
+		mat4 JitterProjection(const mat4& Projection, int InputWidth, int InputHeight) const;
+
+		// Returns the resolved color (RGBA16F, output size), -1 while the programs compile
+		// ViewProjection is not jittered
+		render_graph::resource AddPasses(render_graph& Graph, render_graph::resource Color, render_graph::resource Depth,
+			const mat4& ViewProjection, int OutputWidth, int OutputHeight);
+
+		// Next AddPasses ignores the history (camera cut, disabled TAA)
+		void InvalidateHistory() { HistoryValid = false; }
+
+		float Blend = 0.1f; // Current frame weight
+
+		// Stats
+		v2 Jitter = {};     // Input pixels, in [-0.5, 0.5]
+		int PhaseCount = 8;
+
+	private:
+		render_target_pool& Pool;
+
+		program VelocityProgram;
+		program ResolveProgram;
+		GLuint EmptyVAO = 0;
+
+		int JitterIndex = 0;
+
+		GLuint History[2] = {};
+		render_target_desc HistoryDesc = {};
+		int HistoryIndex = 0; // Texture written this frame, the other one is the previous frame
+		bool HistoryValid = false;
+		mat4 PreviousViewProjection = {};
+	};
+}
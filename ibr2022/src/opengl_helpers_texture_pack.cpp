@@ -0,0 +1,291 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <stb_image.h>
+
+#include "maths.h"
+
+#include "opengl_helpers.h"
+
+#include "opengl_helpers_texture_pack.h"
+
+using namespace GL;
+
+static const int EMISSIVE_TINT_DOWNSCALE = 16;     // Tint map is 16x smaller than the emissive map
+static const int EMISSIVE_TINT_MAX_ERROR = 12;     // Max error (out of 255) allowed to use a constant tint
+static const int EMISSIVE_INTENSITY_THRESHOLD = 2; // Texels below are considered black
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
+static const int MAX_PACKED_SIZE = 16384;
+
+// Packed textures as stored on disk
+struct packed_texels
+{
+	uint64_t SourceKey; // See ComputeSourceKey
+	int ImageFlags;
+	int Width;
+	int Height;
+	int TintWidth;  // 0 if constant tint
+	int TintHeight;
+	v3 Tint;
+	int BytesSaved;
+	std::vector<uint8_t> DiffuseTexels; // RGBA
+	std::vector<uint8_t> TintTexels;    // RGB
+};
+
+static int GetTextureBytes(int Width, int Height, int Channels, int ImageFlags)
+{
+	int Bytes = Width * Height * Channels;
+	return (ImageFlags & IMG_GEN_MIPMAPS) ? Bytes * 4 / 3 : Bytes;
+}
+
+static void HashBytes(uint64_t& Hash, const void* Data, size_t Size)
+{
+	for (size_t i = 0; i < Size; ++i)
+	{
+		Hash ^= ((const uint8_t*)Data)[i];
+		Hash *= FNV_PRIME;
+	}
+}
+
+// Both source files (name, size and modification time) and the image flags, the cache is rebuilt when one of them changes
+static uint64_t ComputeSourceKey(const char* DiffuseFilename, const char* EmissiveFilename, int ImageFlags)
+{
+	uint64_t Hash = FNV_OFFSET_BASIS;
+	HashBytes(Hash, &ImageFlags, sizeof(ImageFlags));
+	const char* Filenames[2] = { DiffuseFilename, EmissiveFilename };
+	for (const char* Filename : Filenames)
+	{
+		HashBytes(Hash, Filename, strlen(Filename) + 1);
+
+		struct stat FileStat;
+		if (stat(Filename, &FileStat) != 0)
+			continue;
+		int64_t Size = (int64_t)FileStat.st_size;
+		int64_t ModificationTime = (int64_t)FileStat.st_mtime;
+		HashBytes(Hash, &Size, sizeof(Size));
+		HashBytes(Hash, &ModificationTime, sizeof(ModificationTime));
+	}
+	return Hash;
+}
+
+static bool LoadPackedTexelsFromCache(packed_texels& Packed, const char* Filename, uint64_t SourceKey)
+{
+	std::string CachedFile = Filename;
+	CachedFile += ".packed.cache";
+
+	FILE* File = fopen(CachedFile.c_str(), "rb");
+	if (File == nullptr)
+		return false;
+
+	bool Valid =
+		   fread(&Packed.SourceKey,  sizeof(uint64_t), 1, File) == 1
+		&& fread(&Packed.ImageFlags, sizeof(int), 1, File) == 1
+		&& fread(&Packed.Width,      sizeof(int), 1, File) == 1
+		&& fread(&Packed.Height,     sizeof(int), 1, File) == 1
+		&& fread(&Packed.TintWidth,  sizeof(int), 1, File) == 1
+		&& fread(&Packed.TintHeight, sizeof(int), 1, File) == 1
+		&& fread(&Packed.Tint,       sizeof(v3),  1, File) == 1
+		&& fread(&Packed.BytesSaved, sizeof(int), 1, File) == 1;
+
+	// Stale (sources changed) or corrupted header
+	Valid = Valid
+		&& Packed.SourceKey == SourceKey
+		&& Packed.Width > 0 && Packed.Width <= MAX_PACKED_SIZE
+		&& Packed.Height > 0 && Packed.Height <= MAX_PACKED_SIZE
+		&& Packed.TintWidth >= 0 && Packed.TintWidth <= Packed.Width
+		&& Packed.TintHeight >= 0 && Packed.TintHeight <= Packed.Height
+		&& (Packed.TintWidth == 0) == (Packed.TintHeight == 0);
+
+	if (Valid)
+	{
+		Packed.DiffuseTexels.resize((size_t)Packed.Width * Packed.Height * 4);
+		Packed.TintTexels.resize((size_t)Packed.TintWidth * Packed.TintHeight * 3);
+		Valid = fread(Packed.DiffuseTexels.data(), 1, Packed.DiffuseTexels.size(), File) == Packed.DiffuseTexels.size()
+			&& fread(Packed.TintTexels.data(), 1, Packed.TintTexels.size(), File) == Packed.TintTexels.size();
+	}
+	fclose(File);
+
+	if (!Valid)
+		return false;
+
+	printf("Loaded from cache: %s (packed material)\n", Filename);
+
+	return true;
+}
+
+static void SavePackedTexelsToCache(const packed_texels& Packed, const char* Filename)
+{
+	std::string CachedFile = Filename;
+	CachedFile += ".packed.cache";
+
+	FILE* File = fopen(CachedFile.c_str(), "wb");
+	if (File == nullptr)
+		return;
+
+	fwrite(&Packed.SourceKey,  sizeof(uint64_t), 1, File);
+	fwrite(&Packed.ImageFlags, sizeof(int), 1, File);
+	fwrite(&Packed.Width,      sizeof(int), 1, File);
+	fwrite(&Packed.Height,     sizeof(int), 1, File);
+	fwrite(&Packed.TintWidth,  sizeof(int), 1, File);
+	fwrite(&Packed.TintHeight, sizeof(int), 1, File);
+	fwrite(&Packed.Tint,       sizeof(v3),  1, File);
+	fwrite(&Packed.BytesSaved, sizeof(int), 1, File);
+	fwrite(Packed.DiffuseTexels.data(), 1, Packed.DiffuseTexels.size(), File);
+	fwrite(Packed.TintTexels.data(), 1, Packed.TintTexels.size(), File);
+	fclose(File);
+
+	printf("Saved to cache: %s (packed material)\n", Filename);
+}
+
+static bool PackTexels(packed_texels& Packed, const char* DiffuseFilename, const char* EmissiveFilename, int ImageFlags)
+{
+	stbi_set_flip_vertically_on_load((ImageFlags & IMG_FLIP) ? 1 : 0);
+
+	int Width, Height, DiffuseChannels, EmissiveWidth, EmissiveHeight, EmissiveChannels;
+	uint8_t* Diffuse = stbi_load(DiffuseFilename, &Width, &Height, &DiffuseChannels, STBI_rgb_alpha);
+	uint8_t* Emissive = stbi_load(EmissiveFilename, &EmissiveWidth, &EmissiveHeight, &EmissiveChannels, STBI_rgb);
+	stbi_set_flip_vertically_on_load(0); // Always reset to default value
+
+	bool Packable = (Diffuse != nullptr && Emissive != nullptr && Width == EmissiveWidth && Height == EmissiveHeight);
+
+	// Diffuse alpha must be unused to store the emissive intensity
+	int TexelCount = Width * Height;
+	for (int i = 0; Packable && DiffuseChannels == 4 && i < TexelCount; ++i)
+		Packable = (Diffuse[i * 4 + 3] == 255);
+
+	if (!Packable)
+	{
+		stbi_image_free(Diffuse);
+		stbi_image_free(Emissive);
+		return false;
+	}
+
+	// Intensity = max channel, weighted average of the tint
+	Packed.ImageFlags = ImageFlags;
+	Packed.Width = Width;
+	Packed.Height = Height;
+	Packed.DiffuseTexels.assign(Diffuse, Diffuse + TexelCount * 4);
+
+	double ColorSum[3] = {};
+	double IntensitySum = 0.0;
+	int LitTexelCount = 0;
+	for (int i = 0; i < TexelCount; ++i)
+	{
+		const uint8_t* Texel = &Emissive[i * 3];
+		uint8_t Intensity = Math::Max(Texel[0], Math::Max(Texel[1], Texel[2]));
+		Packed.DiffuseTexels[i * 4 + 3] = Intensity;
+
+		ColorSum[0] += Texel[0];
+		ColorSum[1] += Texel[1];
+		ColorSum[2] += Texel[2];
+		IntensitySum += Intensity;
+		LitTexelCount += (Intensity > EMISSIVE_INTENSITY_THRESHOLD) ? 1 : 0;
+	}
+
+	v3 Tint = { 1.f, 1.f, 1.f };
+	if (IntensitySum > 0.0)
+		Tint = { (float)(ColorSum[0] / IntensitySum), (float)(ColorSum[1] / IntensitySum), (float)(ColorSum[2] / IntensitySum) };
+	Packed.Tint = Tint;
+
+	// Can the emissive map be rebuilt with a constant tint?
+	int MaxError = 0;
+	for (int i = 0; i < TexelCount; ++i)
+	{
+		const uint8_t* Texel = &Emissive[i * 3];
+		float Intensity = Packed.DiffuseTexels[i * 4 + 3];
+		for (int c = 0; c < 3; ++c)
+			MaxError = Math::Max(MaxError, (int)fabsf(Texel[c] - Intensity * Tint.e[c]));
+	}
+
+	Packed.TintWidth = 0;
+	Packed.TintHeight = 0;
+	if (MaxError > EMISSIVE_TINT_MAX_ERROR)
+	{
+		// Several hues, store a tiny tint map (color / intensity, averaged per block)
+		Packed.TintWidth = Math::Max(1, Width / EMISSIVE_TINT_DOWNSCALE);
+		Packed.TintHeight = Math::Max(1, Height / EMISSIVE_TINT_DOWNSCALE);
+		Packed.TintTexels.resize(Packed.TintWidth * Packed.TintHeight * 3);
+		for (int ty = 0; ty < Packed.TintHeight; ++ty)
+		{
+			for (int tx = 0; tx < Packed.TintWidth; ++tx)
+			{
+				double BlockColor[3] = {};
+				double BlockIntensity = 0.0;
+				for (int y = ty * Height / Packed.TintHeight; y < (ty + 1) * Height / Packed.TintHeight; ++y)
+				{
+					for (int x = tx * Width / Packed.TintWidth; x < (tx + 1) * Width / Packed.TintWidth; ++x)
+					{
+						int i = x + y * Width;
+						BlockColor[0] += Emissive[i * 3 + 0];
+						BlockColor[1] += Emissive[i * 3 + 1];
+						BlockColor[2] += Emissive[i * 3 + 2];
+						BlockIntensity += Packed.DiffuseTexels[i * 4 + 3];
+					}
+				}
+
+				uint8_t* TintTexel = &Packed.TintTexels[(tx + ty * Packed.TintWidth) * 3];
+				for (int c = 0; c < 3; ++c)
+					TintTexel[c] = (BlockIntensity > 0.0) ? (uint8_t)Math::Min(255.0, 255.0 * BlockColor[c] / BlockIntensity) : 255;
+			}
+		}
+	}
+
+	int OriginalBytes = GetTextureBytes(Width, Height, DiffuseChannels, ImageFlags) + GetTextureBytes(Width, Height, EmissiveChannels, ImageFlags);
+	int PackedBytes = GetTextureBytes(Width, Height, 4, ImageFlags) + Packed.TintWidth * Packed.TintHeight * 3;
+	Packed.BytesSaved = OriginalBytes - PackedBytes;
+
+	printf("Packed '%s' into '%s' alpha (%.1f%% lit texels, %s tint, %d bytes saved)\n",
+		EmissiveFilename, DiffuseFilename, 100.f * LitTexelCount / TexelCount,
+		Packed.TintWidth ? "map" : "constant", Packed.BytesSaved);
+
+	stbi_image_free(Diffuse);
+	stbi_image_free(Emissive);
+	return true;
+}
+
+bool GL::PackMaterialTextures(const char* DiffuseFilename, const char* EmissiveFilename, int ImageFlags, packed_material* PackedOut)
+{
+	packed_texels Packed;
+	uint64_t SourceKey = ComputeSourceKey(DiffuseFilename, EmissiveFilename, ImageFlags);
+	if (!LoadPackedTexelsFromCache(Packed, EmissiveFilename, SourceKey))
+	{
+		if (!PackTexels(Packed, DiffuseFilename, EmissiveFilename, ImageFlags))
+			return false;
+		Packed.SourceKey = SourceKey;
+		SavePackedTexelsToCache(Packed, EmissiveFilename);
+	}
+
+	// Diffuse + emissive intensity
+	glGenTextures(1, &PackedOut->DiffuseTexture);
+	glBindTexture(GL_TEXTURE_2D, PackedOut->DiffuseTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Packed.Width, Packed.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, Packed.DiffuseTexels.data());
+	if (ImageFlags & IMG_GEN_MIPMAPS)
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+	PackedOut->ShaderDefines = "#define PACKED_EMISSIVE\n";
+	PackedOut->EmissiveTint = Packed.Tint;
+	PackedOut->EmissiveTexture = 0;
+	PackedOut->BytesSaved = Packed.BytesSaved;
+
+	// Emissive tint map
+	if (Packed.TintWidth > 0)
+	{
+		glGenTextures(1, &PackedOut->EmissiveTexture);
+		glBindTexture(GL_TEXTURE_2D, PackedOut->EmissiveTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, Packed.TintWidth, Packed.TintHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, Packed.TintTexels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		PackedOut->ShaderDefines += "#define PACKED_EMISSIVE_TINT_TEXTURE\n";
+	}
+
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "opengl_headers.h"
+#include "types.h"
+
+namespace GL
+{
+	// Diffuse + emissive maps merged into fewer textures
+	struct packed_material
+	{
+		GLuint DiffuseTexture = 0;      // RGB: diffuse, A: emissive intensity (when packed)
+		GLuint EmissiveTexture = 0;     // Low resolution emissive tint (when packed), 0 if a constant tint is enough
+		v3 EmissiveTint = { 1.f, 1.f, 1.f };
+		int BytesSaved = 0;
+		std::string ShaderDefines;      // Defines to prepend to the fragment shader ("#define PACKED_EMISSIVE\n"...)
+	};
+
+	// Analyse the channel usage of a diffuse/emissive pair and merge them:
+	// - Emissive intensity is stored in the diffuse alpha channel (if unused)
+	// - Emissive color is stored as a constant tint, or as a tiny tint map when the emissive map has several hues
+	// Result is cached on disk next to the emissive map, returns false if the maps cannot be merged
+	bool PackMaterialTextures(const char* DiffuseFilename, const char* EmissiveFilename, int ImageFlags, packed_material* PackedOut);
+}
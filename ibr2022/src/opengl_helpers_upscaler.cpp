@@ -0,0 +1,233 @@
+#include <cmath>
+
+#include "opengl_helpers_upscaler.h"
+
+using namespace GL;
+
+#pragma region upscaler_shaders
+// Fullscreen triangle
+static const char* gVertexShaderStr = R"GLSL(
+out vec2 vUV;
+
+void main()
+{
+    vUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+})GLSL";
+
+// Edge adaptive spatial upsampling, taps around the input position (f is the top-left of the 2x2 quad):
+//     b c
+//   e f g h
+//   i j k l
+//     n o
+static const char* gFragmentEASUShaderStr = R"GLSL(
+uniform sampler2D uSource;
+uniform vec2 uScale; // Input size / output size
+
+out vec4 oColor;
+
+ivec2 gMaxTexel;
+ivec2 gOrigin;
+
+vec3 tap(int x, int y)
+{
+    return texelFetch(uSource, clamp(gOrigin + ivec2(x, y), ivec2(0), gMaxTexel), 0).rgb;
+}
+
+float luma(vec3 c)
+{
+    return c.b * 0.5 + (c.r * 0.5 + c.g);
+}
+
+// Direction and length of the edge seen from one texel of the quad (a up, b left, c center, d right, e down), bilinear weighted
+void accumulate_direction(inout vec2 dir, inout float len, float w, float a, float b, float c, float d, float e)
+{
+    float lenX = max(abs(d - c), abs(c - b));
+    float dirX = d - b;
+    lenX = clamp(abs(dirX) / max(lenX, 1e-5), 0.0, 1.0);
+    dir.x += dirX * w;
+    len += lenX * lenX * w;
+
+    float lenY = max(abs(e - c), abs(c - a));
+    float dirY = e - a;
+    lenY = clamp(abs(dirY) / max(lenY, 1e-5), 0.0, 1.0);
+    dir.y += dirY * w;
+    len += lenY * lenY * w;
+}
+
+// Approximated lanczos2 kernel, rotated along the edge and stretched by len
+void accumulate_tap(inout vec3 color, inout float weight, vec2 offset, vec2 dir, vec2 len, float lob, float clp, vec3 c)
+{
+    vec2 v = vec2(dot(offset, dir), dot(offset, vec2(-dir.y, dir.x))) * len;
+    float d2 = min(dot(v, v), clp);
+
+    // (25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)) * (lob * x^2 - 1)^2
+    float wB = 0.4 * d2 - 1.0;
+    float wA = lob * d2 - 1.0;
+    float w = (1.5625 * wB * wB - 0.5625) * (wA * wA);
+    color += c * w;
+    weight += w;
+}
+
+void main()
+{
+    gMaxTexel = textureSize(uSource, 0) - 1;
+
+    // Output pixel center in input texels
+    vec2 pp = gl_FragCoord.xy * uScale - 0.5;
+    vec2 fp = floor(pp);
+    pp -= fp;
+    gOrigin = ivec2(fp);
+
+    vec3 b = tap(0, -1); vec3 c = tap(1, -1);
+    vec3 e = tap(-1, 0); vec3 f = tap(0, 0); vec3 g = tap(1, 0); vec3 h = tap(2, 0);
+    vec3 i = tap(-1, 1); vec3 j = tap(0, 1); vec3 k = tap(1, 1); vec3 l = tap(2, 1);
+    vec3 n = tap(0, 2); vec3 o = tap(1, 2);
+
+    float bL = luma(b); float cL = luma(c);
+    float eL = luma(e); float fL = luma(f); float gL = luma(g); float hL = luma(h);
+    float iL = luma(i); float jL = luma(j); float kL = luma(k); float lL = luma(l);
+    float nL = luma(n); float oL = luma(o);
+
+    // Edge direction and length from the 4 texels of the quad
+    vec2 dir = vec2(0.0);
+    float len = 0.0;
+    accumulate_direction(dir, len, (1.0 - pp.x) * (1.0 - pp.y), bL, eL, fL, gL, jL);
+    accumulate_direction(dir, len, pp.x * (1.0 - pp.y),         cL, fL, gL, hL, kL);
+    accumulate_direction(dir, len, (1.0 - pp.x) * pp.y,         fL, iL, jL, kL, nL);
+    accumulate_direction(dir, len, pp.x * pp.y,                 gL, jL, kL, lL, oL);
+
+    float dirLength2 = dot(dir, dir);
+    dir = (dirLength2 < 1.0 / 32768.0) ? vec2(1.0, 0.0) : dir * inversesqrt(dirLength2);
+
+    // Kernel stretched along the edge (up to sqrt(2) on diagonals), negative lobe stronger on edges
+    len = len * 0.5;
+    len *= len;
+    float stretch = dot(dir, dir) / max(abs(dir.x), abs(dir.y));
+    vec2 len2 = vec2(1.0 + (stretch - 1.0) * len, 1.0 - 0.5 * len);
+    float lob = 0.5 + ((1.0 / 4.0 - 0.04) - 0.5) * len;
+    float clp = 1.0 / lob;
+
+    vec3 color = vec3(0.0);
+    float weight = 0.0;
+    accumulate_tap(color, weight, vec2( 0.0, -1.0) - pp, dir, len2, lob, clp, b);
+    accumulate_tap(color, weight, vec2( 1.0, -1.0) - pp, dir, len2, lob, clp, c);
+    accumulate_tap(color, weight, vec2(-1.0,  1.0) - pp, dir, len2, lob, clp, i);
+    accumulate_tap(color, weight, vec2( 0.0,  1.0) - pp, dir, len2, lob, clp, j);
+    accumulate_tap(color, weight, vec2( 0.0,  0.0) - pp, dir, len2, lob, clp, f);
+    accumulate_tap(color, weight, vec2(-1.0,  0.0) - pp, dir, len2, lob, clp, e);
+    accumulate_tap(color, weight, vec2( 1.0,  1.0) - pp, dir, len2, lob, clp, k);
+    accumulate_tap(color, weight, vec2( 2.0,  1.0) - pp, dir, len2, lob, clp, l);
+    accumulate_tap(color, weight, vec2( 2.0,  0.0) - pp, dir, len2, lob, clp, h);
+    accumulate_tap(color, weight, vec2( 1.0,  0.0) - pp, dir, len2, lob, clp, g);
+    accumulate_tap(color, weight, vec2( 1.0,  2.0) - pp, dir, len2, lob, clp, o);
+    accumulate_tap(color, weight, vec2( 0.0,  2.0) - pp, dir, len2, lob, clp, n);
+
+    // Deringing
+    vec3 minColor = min(min(f, g), min(j, k));
+    vec3 maxColor = max(max(f, g), max(j, k));
+    oColor = vec4(clamp(color / weight, minColor, maxColor), 1.0);
+})GLSL";
+
+// Contrast adaptive sharpening on a cross (b up, d left, e center, f right, h down)
+static const char* gFragmentRCASShaderStr = R"GLSL(
+uniform sampler2D uSource;
+uniform float uSharpness; // exp2(-stops)
+uniform int uDenoise;
+
+out vec4 oColor;
+
+float luma(vec3 c)
+{
+    return c.b * 0.5 + (c.r * 0.5 + c.g);
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 maxTexel = textureSize(uSource, 0) - 1;
+    vec3 b = texelFetch(uSource, clamp(p + ivec2( 0,  1), ivec2(0), maxTexel), 0).rgb;
+    vec3 d = texelFetch(uSource, clamp(p + ivec2(-1,  0), ivec2(0), maxTexel), 0).rgb;
+    vec3 e = texelFetch(uSource, p, 0).rgb;
+    vec3 f = texelFetch(uSource, clamp(p + ivec2( 1,  0), ivec2(0), maxTexel), 0).rgb;
+    vec3 h = texelFetch(uSource, clamp(p + ivec2( 0, -1), ivec2(0), maxTexel), 0).rgb;
+
+    // Largest negative lobe that keeps the result in [0, 1] for the neighbourhood range
+    vec3 mn4 = min(min(b, d), min(f, h));
+    vec3 mx4 = max(max(b, d), max(f, h));
+    vec3 hitMin = min(mn4, e) / (4.0 * mx4 + 1e-5);
+    vec3 hitMax = (1.0 - max(mx4, e)) / (4.0 * mn4 - 4.0 - 1e-5);
+    vec3 lobeRGB = max(-hitMin, hitMax);
+    float lobe = max(-(0.25 - 1.0 / 16.0), min(max(lobeRGB.r, max(lobeRGB.g, lobeRGB.b)), 0.0)) * uSharpness;
+
+    if (uDenoise != 0)
+    {
+        float bL = luma(b); float dL = luma(d); float eL = luma(e); float fL = luma(f); float hL = luma(h);
+        float range = max(max(max(bL, dL), max(eL, fL)), hL) - min(min(min(bL, dL), min(eL, fL)), hL);
+        float noise = clamp(abs(0.25 * (bL + dL + fL + hL) - eL) / max(range, 1e-5), 0.0, 1.0);
+        lobe *= 1.0 - 0.5 * noise;
+    }
+
+    oColor = vec4((lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0), 1.0);
+})GLSL";
+#pragma endregion upscaler_shaders
+
+spatial_upscaler::spatial_upscaler()
+{
+	EASUProgram.Create(gVertexShaderStr, gFragmentEASUShaderStr);
+	RCASProgram.Create(gVertexShaderStr, gFragmentRCASShaderStr);
+	glGenVertexArrays(1, &EmptyVAO);
+}
+
+spatial_upscaler::~spatial_upscaler()
+{
+	glDeleteVertexArrays(1, &EmptyVAO);
+}
+
+void spatial_upscaler::AddPasses(render_graph& Graph, render_graph::resource Source, int ScreenWidth, int ScreenHeight)
+{
+	render_target_desc SourceDesc = Graph.GetDesc(Source);
+	float ScaleX = (float)SourceDesc.Width / ScreenWidth;
+	float ScaleY = (float)SourceDesc.Height / ScreenHeight;
+	float PassSharpness = exp2f(-Sharpness);
+	int PassDenoise = Denoise ? 1 : 0;
+	GLuint VAO = EmptyVAO;
+	program* EASU = &EASUProgram;
+	program* RCAS = &RCASProgram;
+
+	// EASU
+	render_graph::resource Upsampled = Graph.Create("EASU", { ScreenWidth, ScreenHeight, GL_RGBA8 });
+	int EASUPass = Graph.AddPass("EASU", [=](render_graph& PassGraph)
+	{
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		EASU->Use();
+		EASU->SetInt("uSource", 0);
+		EASU->SetVec2("uScale", { ScaleX, ScaleY });
+		PassGraph.BindFramebuffer(Upsampled);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Source));
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	});
+	Graph.Read(EASUPass, Source);
+	Graph.Write(EASUPass, Upsampled);
+
+	// RCAS to the screen (root pass)
+	int RCASPass = Graph.AddPass("RCAS", [=](render_graph& PassGraph)
+	{
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		RCAS->Use();
+		RCAS->SetInt("uSource", 0);
+		RCAS->SetFloat("uSharpness", PassSharpness);
+		RCAS->SetInt("uDenoise", PassDenoise);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, ScreenWidth, ScreenHeight);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, PassGraph.GetTexture(Upsampled));
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	});
+	Graph.Read(RCASPass, Upsampled);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "opengl_headers.h"
+#include "opengl_helpers_program.h"
+#include "opengl_helpers_render_graph.h"
+
+namespace GL
+{
+	// Spatial upscaler in two passes (FSR 1 style), no history so it works with any input:
+	//  - EASU: edge adaptive upsample, 12 taps lanczos-like kernel stretched along the local edge direction, clamped to the 2x2 nearest texels (no ringing)
+	//  - RCAS: contrast adaptive sharpening at output resolution, the sharpening lobe is limited so it does not clip
+	// Input should be in perceptual space (after tone mapping/gamma), in [0, 1]
+	class spatial_upscaler
+	{
+	public:
+		spatial_upscaler();
+		~spatial_upscaler();
+
+		bool IsReady() { return EASUProgram.IsReady() && RCASProgram.IsReady(); }
+
+		// Upsamples Source to the default framebuffer (any input and output sizes)
+		void AddPasses(render_graph& Graph, render_graph::resource Source, int ScreenWidth, int ScreenHeight);
+
+		float Sharpness = 0.2f; // Stops of sharpening reduction, 0 is the sharpest
+		bool Denoise = false;   // Less sharpening on noisy pixels (grain)
+
+	private:
+		program EASUProgram;
+		program RCASProgram;
+		GLuint EmptyVAO = 0;
+	};
+}
@@ -39,7 +39,7 @@ void main()
 
 wireframe_renderer::wireframe_renderer()
 {
-	Program = GL::CreateProgram(gWireframeVertexShaderStr, gWireframeFragmentShaderStr);
+	Program.Create(gWireframeVertexShaderStr, gWireframeFragmentShaderStr);
 	glGenBuffers(1, &BaryBuffer);
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
@@ -49,7 +49,6 @@ wireframe_renderer::wireframe_renderer()
 
 wireframe_renderer::~wireframe_renderer()
 {
-	glDeleteProgram(Program);
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &BaryBuffer);
 }
@@ -84,7 +83,7 @@ void wireframe_renderer::SendDrawArray(const wireframe_renderer::cmd_draw_array&
 {
 	//glUniform1f(glGetUniformLocation(Data->WireframeShader, "uLineWidth"), LineWidth);
 	//glUniform4fv(glGetUniformLocation(Data->WireframeShader, "uLineColor"), 1, LineColor.e);
-	glUniformMatrix4fv(glGetUniformLocation(Program, "uModelViewProj"), 1, GL_FALSE, Cmd.MVP.e);
+	Program.SetMat4("uModelViewProj", Cmd.MVP);
 	glDrawArrays(GL_TRIANGLES, Cmd.First, Cmd.Count);
 }
 
@@ -106,7 +105,7 @@ void wireframe_renderer::Flush()
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	
 	// Use program
-	glUseProgram(Program);
+	Program.Use();
 
 	// Bind VAO
 	glBindVertexArray(VAO);
@@ -5,6 +5,7 @@
 #include "maths.h"
 
 #include "opengl_headers.h"
+#include "opengl_helpers_program.h"
 
 namespace GL
 {
@@ -53,7 +54,7 @@ namespace GL
 		void SendBindBuffer(const cmd_bind_buffer& Cmd);
 		void SendDrawArray(const cmd_draw_array& Cmd);
 
-		GLuint Program = 0;
+		program Program;
 		GLuint VAO = 0;
 		std::vector<v3> BaryBufferData;
 		GLuint BaryBuffer = 0;
@@ -0,0 +1,307 @@
+#include "platform.h"
+
+#include "maths.h"
+
+#include "tavern_renderer.h"
+
+const int LIGHT_BLOCK_BINDING_POINT = 0;
+const int CHUNK_GRID = 4;
+
+static const char* gVertexShaderStr = R"GLSL(
+// Attributes
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec2 aUV;
+layout(location = 2) in vec3 aNormal;
+#if defined(LIGHTMAP)
+layout(location = 3) in vec2 aLightmapUV;
+#endif
+
+// Uniforms (view/projection from uFrame)
+uniform mat4 uModel;
+uniform mat4 uModelNormalMatrix;
+
+// Varyings
+out vec2 vUV;
+out vec3 vPos;    // Vertex position in view-space
+out vec3 vNormal; // Vertex normal in view-space
+#if defined(LIGHTMAP)
+out vec2 vLightmapUV;
+#endif
+
+void main()
+{
+    vUV = aUV;
+#if defined(LIGHTMAP)
+    vLightmapUV = aLightmapUV;
+#endif
+    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vPos = pos4.xyz / pos4.w;
+    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    gl_Position = uFrame.viewProj * pos4;
+})GLSL";
+
+static const char* gFragmentShaderStr = R"GLSL(
+// Varyings
+in vec2 vUV;
+in vec3 vPos;
+in vec3 vNormal;
+#if defined(LIGHTMAP)
+in vec2 vLightmapUV;
+#endif
+
+// Uniforms
+uniform sampler2D uDiffuseTexture;  // Alpha: emissive intensity (PACKED_EMISSIVE)
+uniform sampler2D uEmissiveTexture; // Emissive tint map (PACKED_EMISSIVE_TINT_TEXTURE)
+uniform vec3 uEmissiveTint;
+uniform int uLightCount;            // Lights reaching the mesh (see tavern_renderer::CullLights)
+#if defined(LIGHTMAP)
+uniform sampler2D uLightmap;        // Baked lights (see lightmap_baker), rgb: diffuse, a: ambient
+#endif
+
+// Uniform blocks
+layout(std140) uniform uLightBlock
+{
+	light uLight[LIGHT_COUNT];
+};
+
+// Shader outputs
+out vec4 oColor;
+
+light_shade_result get_lights_shading()
+{
+    light_shade_result lightResult = light_shade_result(vec3(0.0), vec3(0.0), vec3(0.0));
+	for (int i = 0; i < uLightCount; ++i)
+    {
+        light_shade_result light = light_shade(uLight[i], gDefaultMaterial.shininess, uFrame.viewPosition.xyz, vPos, normalize(vNormal));
+        lightResult.ambient  += light.ambient;
+        lightResult.diffuse  += light.diffuse;
+        lightResult.specular += light.specular;
+    }
+    return lightResult;
+}
+
+vec3 get_emissive(vec4 diffuseTexel)
+{
+#if defined(PACKED_EMISSIVE_TINT_TEXTURE)
+    return diffuseTexel.a * texture(uEmissiveTexture, vUV).rgb;
+#elif defined(PACKED_EMISSIVE)
+    return diffuseTexel.a * uEmissiveTint;
+#else
+    return texture(uEmissiveTexture, vUV).rgb;
+#endif
+}
+
+void main()
+{
+    // Compute phong shading
+    light_shade_result lightResult = get_lights_shading();
+#if defined(LIGHTMAP)
+    vec4 bakedLight = texture(uLightmap, vLightmapUV);
+    lightResult.diffuse += bakedLight.rgb;
+    lightResult.ambient += vec3(bakedLight.a);
+#endif
+    vec4 diffuseTexel = texture(uDiffuseTexture, vUV);
+    
+    vec3 diffuseColor  = gDefaultMaterial.diffuse * lightResult.diffuse * diffuseTexel.rgb;
+    vec3 ambientColor  = gDefaultMaterial.ambient * lightResult.ambient;
+    vec3 specularColor = gDefaultMaterial.specular * lightResult.specular;
+    vec3 emissiveColor = gDefaultMaterial.emission + get_emissive(diffuseTexel);
+    
+    // Apply light color
+    oColor = vec4((ambientColor + diffuseColor + specularColor + emissiveColor), 1.0);
+})GLSL";
+
+tavern_renderer::tavern_renderer(GL::cache& GLCache, tavern_scene& TavernScene)
+    : GLCache(GLCache), TavernScene(TavernScene)
+{
+    // Bounds (read back once, vertices are only kept on GPU)
+    {
+        std::vector<vertex_full> Vertices(TavernScene.MeshVertexCount);
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, TavernScene.MeshVertexCount * sizeof(vertex_full), Vertices.data());
+        MeshMin = { INFINITY, INFINITY, INFINITY };
+        MeshMax = { -INFINITY, -INFINITY, -INFINITY };
+        for (const vertex_full& Vertex : Vertices)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                MeshMin.e[i] = Math::Min(MeshMin.e[i], Vertex.Position.e[i]);
+                MeshMax.e[i] = Math::Max(MeshMax.e[i], Vertex.Position.e[i]);
+            }
+        }
+
+        // Chunks: triangles go to the grid cell of their centroid, the cell bounds are then fitted to its triangles
+        std::vector<chunk> Cells(CHUNK_GRID * CHUNK_GRID * CHUNK_GRID, { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } });
+        v3 CellScale = {};
+        for (int i = 0; i < 3; ++i)
+            CellScale.e[i] = MeshMax.e[i] > MeshMin.e[i] ? CHUNK_GRID / (MeshMax.e[i] - MeshMin.e[i]) : 0.f;
+        for (int Triangle = 0; Triangle + 2 < TavernScene.MeshVertexCount; Triangle += 3)
+        {
+            v3 Centroid = (Vertices[Triangle].Position + Vertices[Triangle + 1].Position + Vertices[Triangle + 2].Position) / 3.f;
+            int Cell = 0;
+            for (int i = 2; i >= 0; --i)
+                Cell = Cell * CHUNK_GRID + Math::Clamp((int)((Centroid.e[i] - MeshMin.e[i]) * CellScale.e[i]), 0, CHUNK_GRID - 1);
+
+            for (int Vertex = Triangle; Vertex < Triangle + 3; ++Vertex)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    Cells[Cell].Min.e[i] = Math::Min(Cells[Cell].Min.e[i], Vertices[Vertex].Position.e[i]);
+                    Cells[Cell].Max.e[i] = Math::Max(Cells[Cell].Max.e[i], Vertices[Vertex].Position.e[i]);
+                }
+            }
+        }
+        for (const chunk& Cell : Cells)
+        {
+            if (Cell.Min.x <= Cell.Max.x)
+                Chunks.push_back(Cell);
+        }
+    }
+
+    // Material (cache hit, loaded by tavern_scene)
+    {
+        const GL::packed_material& Material = tavern_scene::LoadMaterial(GLCache);
+        EmissiveTint          = Material.EmissiveTint;
+        MaterialShaderDefines = Material.ShaderDefines;
+        MaterialBytesSaved    = Material.BytesSaved;
+    }
+
+    // Shared program (same sources and defines for every demo using the tavern)
+    {
+        char LightCountDefine[64];
+        snprintf(LightCountDefine, ARRAY_SIZE(LightCountDefine), "#define LIGHT_COUNT %d\n", TavernScene.LightCount);
+        ProgramDefines = std::string(LightCountDefine) + MaterialShaderDefines;
+        Program = GLCache.LoadProgram(gVertexShaderStr, gFragmentShaderStr, ProgramDefines.c_str(), true);
+    }
+
+    // Culled lights buffer
+    {
+        glGenBuffers(1, &CulledLightsUniformBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, CulledLightsUniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, TavernScene.LightCount * sizeof(GL::light_data), nullptr, GL_DYNAMIC_DRAW);
+    }
+}
+
+tavern_renderer::~tavern_renderer()
+{
+    glDeleteBuffers(1, &CulledLightsUniformBuffer);
+    GLCache.ReleaseProgram(Program);
+}
+
+int tavern_renderer::CullLights(const mat4& ViewProjectionMatrix, const mat4& ModelMatrix, uint32_t ExcludedLights)
+{
+    // World space frustum planes (xyz: inward normal, w: distance), from the rows of the view projection matrix
+    v4 Planes[6];
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            float Row3 = ViewProjectionMatrix.c[j].e[3];
+            float Row = ViewProjectionMatrix.c[j].e[i];
+            Planes[2 * i + 0].e[j] = Row3 + Row;
+            Planes[2 * i + 1].e[j] = Row3 - Row;
+        }
+    }
+
+    // World space boxes of the chunks inside the view frustum
+    VisibleChunks.clear();
+    for (const chunk& Chunk : Chunks)
+    {
+        chunk World = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+        for (int Corner = 0; Corner < 8; ++Corner)
+        {
+            v3 Position = { (Corner & 1) ? Chunk.Max.x : Chunk.Min.x, (Corner & 2) ? Chunk.Max.y : Chunk.Min.y, (Corner & 4) ? Chunk.Max.z : Chunk.Min.z };
+            v4 WorldPosition = ModelMatrix * Vec4::vec4(Position, 1.f);
+            for (int i = 0; i < 3; ++i)
+            {
+                World.Min.e[i] = Math::Min(World.Min.e[i], WorldPosition.e[i]);
+                World.Max.e[i] = Math::Max(World.Max.e[i], WorldPosition.e[i]);
+            }
+        }
+
+        // Box against view frustum (corner furthest along each plane normal)
+        bool Visible = true;
+        for (const v4& Plane : Planes)
+        {
+            v3 Corner = {
+                Plane.x >= 0.f ? World.Max.x : World.Min.x,
+                Plane.y >= 0.f ? World.Max.y : World.Min.y,
+                Plane.z >= 0.f ? World.Max.z : World.Min.z,
+            };
+            Visible = Visible && Vec3::Dot(Plane.xyz, Corner) + Plane.w >= 0.f;
+        }
+        if (Visible)
+            VisibleChunks.push_back(World);
+    }
+
+    CulledLightsData.clear();
+    for (int i = 0; i < TavernScene.LightCount; ++i)
+    {
+        const GL::light& Light = TavernScene.GetLight(i);
+        if (!Light.Enabled || (ExcludedLights & (1u << i)))
+            continue;
+
+        float Radius = GL::GetLightRadius(Light);
+        if (Radius <= 0.f || VisibleChunks.empty())
+            continue;
+
+        if (Radius < INFINITY)
+        {
+            v3 Center = Light.Position.xyz / Light.Position.w;
+
+            // Sphere against visible chunk boxes
+            bool Reached = false;
+            for (size_t c = 0; c < VisibleChunks.size() && !Reached; ++c)
+            {
+                const chunk& Chunk = VisibleChunks[c];
+                v3 Delta = {
+                    Math::Max(Math::Max(Chunk.Min.x - Center.x, 0.f), Center.x - Chunk.Max.x),
+                    Math::Max(Math::Max(Chunk.Min.y - Center.y, 0.f), Center.y - Chunk.Max.y),
+                    Math::Max(Math::Max(Chunk.Min.z - Center.z, 0.f), Center.z - Chunk.Max.z),
+                };
+                Reached = Vec3::Dot(Delta, Delta) <= Radius * Radius;
+            }
+            if (!Reached)
+                continue;
+        }
+
+        CulledLightsData.push_back(GL::PackLight(Light));
+    }
+
+    CulledLightCount = (int)CulledLightsData.size();
+    if (CulledLightCount > 0)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, CulledLightsUniformBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, CulledLightCount * sizeof(GL::light_data), CulledLightsData.data());
+    }
+    return CulledLightCount;
+}
+
+bool tavern_renderer::IsProgramReady()
+{
+    if (ProgramReady)
+        return true;
+
+    if (!Program->IsReady())
+        return false;
+
+    Program->Use();
+    SetProgramConstants(*Program);
+    ProgramReady = true;
+
+    return true;
+}
+
+GL::program* tavern_renderer::LoadProgramVariant(const char* Defines)
+{
+    return GLCache.LoadProgram(gVertexShaderStr, gFragmentShaderStr, (ProgramDefines + Defines).c_str(), true);
+}
+
+void tavern_renderer::SetProgramConstants(GL::program& Variant)
+{
+    // Uniforms that won't change (the program may be shared, values are the same for all users)
+    Variant.SetInt("uDiffuseTexture", 0);
+    Variant.SetInt("uEmissiveTexture", 1);
+    Variant.SetVec3("uEmissiveTint", EmissiveTint);
+    Variant.BindUniformBlock("uLightBlock", LIGHT_BLOCK_BINDING_POINT);
+}
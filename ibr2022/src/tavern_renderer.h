@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "opengl_helpers.h"
+
+#include "tavern_scene.h"
+
+// Tavern shading shared by the demos: phong program (through GLCache), packed material and per-view light culling
+// (kept outside tavern_scene, whose layout is frozen)
+class tavern_renderer
+{
+public:
+    tavern_renderer(GL::cache& GLCache, tavern_scene& TavernScene);
+    ~tavern_renderer();
+
+    // Object space bounds of the mesh
+    v3 MeshMin = {};
+    v3 MeshMax = {};
+
+    // Lights reaching a visible chunk of the mesh (uLightBlock with uLightCount lights for Program)
+    GLuint CulledLightsUniformBuffer = 0;
+    int CulledLightCount = 0;
+    // Lights whose bit is set in ExcludedLights are skipped (e.g. already baked)
+    int CullLights(const mat4& ViewProjectionMatrix, const mat4& ModelMatrix, uint32_t ExcludedLights = 0);
+
+    // Packed material (see tavern_scene::LoadMaterial)
+    v3 EmissiveTint = {};
+    std::string MaterialShaderDefines;
+    int MaterialBytesSaved = 0;
+
+    // Phong program shared through GLCache (compiled in background)
+    // ProgramDefines (LIGHT_COUNT + material defines) can be reused by demos with their own tavern shader
+    GL::program* Program = nullptr;
+    std::string ProgramDefines;
+    bool IsProgramReady(); // Sets the constant uniforms the first time the program is ready
+    // Program with extra defines (e.g. LIGHTMAP), release with GLCache.ReleaseProgram
+    GL::program* LoadProgramVariant(const char* Defines);
+    void SetProgramConstants(GL::program& Variant); // Program must be in use
+
+private:
+    GL::cache& GLCache;
+    tavern_scene& TavernScene;
+    bool ProgramReady = false;
+
+    // Object space bounds of the triangles grouped by cell of a CHUNK_GRID^3 grid over the mesh (empty cells dropped)
+    struct chunk
+    {
+        v3 Min;
+        v3 Max;
+    };
+    std::vector<chunk> Chunks;
+    std::vector<chunk> VisibleChunks; // World space, rebuilt by CullLights
+
+    std::vector<GL::light_data> CulledLightsData;
+};
@@ -7,6 +7,20 @@
 
 #include "tavern_scene.h"
 
+// Baseline layout, embedded in demo_base (see the note in tavern_scene.h)
+struct tavern_scene_layout
+{
+    GLuint MeshBuffer;
+    int MeshVertexCount;
+    vertex_descriptor MeshDesc;
+    GLuint LightsUniformBuffer;
+    int LightCount;
+    GLuint DiffuseTexture;
+    GLuint EmissiveTexture;
+    std::vector<GL::light> Lights;
+};
+static_assert(sizeof(tavern_scene) == sizeof(tavern_scene_layout) && alignof(tavern_scene) == alignof(tavern_scene_layout), "tavern_scene layout is frozen");
+
 tavern_scene::tavern_scene(GL::cache& GLCache)
 {
     // Init lights
@@ -60,15 +74,20 @@ tavern_scene::tavern_scene(GL::cache& GLCache)
 
     // Gen texture
     {
-        DiffuseTexture  = GLCache.LoadTexture("media/fantasy_game_inn_diffuse.png", IMG_FLIP | IMG_GEN_MIPMAPS);
-        EmissiveTexture = GLCache.LoadTexture("media/fantasy_game_inn_emissive.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+        const GL::packed_material& Material = LoadMaterial(GLCache);
+        DiffuseTexture  = Material.DiffuseTexture;
+        EmissiveTexture = Material.EmissiveTexture;
     }
     
     // Gen light uniform buffer
     {
+        std::vector<GL::light_data> LightsData(LightCount);
+        for (int i = 0; i < LightCount; ++i)
+            LightsData[i] = GL::PackLight(Lights[i]);
+
         glGenBuffers(1, &LightsUniformBuffer);
         glBindBuffer(GL_UNIFORM_BUFFER, LightsUniformBuffer);
-        glBufferData(GL_UNIFORM_BUFFER, LightCount * sizeof(GL::light), Lights.data(), GL_DYNAMIC_DRAW);
+        glBufferData(GL_UNIFORM_BUFFER, LightCount * sizeof(GL::light_data), LightsData.data(), GL_DYNAMIC_DRAW);
     }
 }
 
@@ -79,6 +98,11 @@ tavern_scene::~tavern_scene()
     //glDeleteBuffers(1, &MeshBuffer); // From cache
 }
 
+const GL::packed_material& tavern_scene::LoadMaterial(GL::cache& GLCache)
+{
+    return GLCache.LoadPackedMaterial("media/fantasy_game_inn_diffuse.png", "media/fantasy_game_inn_emissive.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+}
+
 static bool EditLight(GL::light* Light)
 {
     bool Result =
@@ -104,8 +128,11 @@ void tavern_scene::InspectLights()
                 GL::light& Light = Lights[i];
                 if (EditLight(&Light))
                 {
-                    glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(GL::light), sizeof(GL::light), &Light);
+                    GL::light_data LightData = GL::PackLight(Light);
+                    glBindBuffer(GL_UNIFORM_BUFFER, LightsUniformBuffer);
+                    glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(GL::light_data), sizeof(GL::light_data), &LightData);
                 }
+                ImGui::Text("Radius: %.2f", GL::GetLightRadius(Light));
 
                 // Calculate attenuation based on the light values
                 if (ImGui::TreeNode("Attenuation calculator"))
@@ -5,6 +5,8 @@
 #include "opengl_helpers.h"
 
 // Tavern scene data (mapped on GPU)
+// The data layout is frozen: demo_base embeds a tavern_scene and is itself embedded by value in the demos of the
+// prebuilt ibr-pg.lib, new per-scene state goes in tavern_renderer
 class tavern_scene
 {
 public:
@@ -20,13 +22,17 @@ public:
     GLuint LightsUniformBuffer = 0;
     int LightCount = 8;
 
-    // Textures
+    // Textures (emissive is packed into diffuse alpha + tint when possible, see LoadMaterial)
     GLuint DiffuseTexture = 0;
     GLuint EmissiveTexture = 0;
 
+    // Tavern material from GLCache (cached, same textures than DiffuseTexture/EmissiveTexture)
+    static const GL::packed_material& LoadMaterial(GL::cache& GLCache);
+
     // ImGui debug function to edit lights
     void    InspectLights();
     v3      GetLightPositionFromIndex(const unsigned int index);
+    const GL::light& GetLight(int Index) const { return Lights[Index]; }
 
 private:
     // Lights data